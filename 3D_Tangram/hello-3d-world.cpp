@@ -41,6 +41,52 @@ class MyApp : public mgl::App {
   mgl::SceneGraph* SceneGraph = nullptr;
 
   mgl::NearestSampler* BaseSampler = nullptr;
+  mgl::LinearAnisotropicSampler* AtlasSampler = nullptr;
+
+  // Volumes still being refined from their preview, and the time per frame spent uploading them
+  std::vector<mgl::Texture3D*> RefiningTextures;
+  double RefineBudget = 0.004;
+  // Times the tileable volumes repeat over an object, 1 generates a non periodic 256^3 volume
+  unsigned int TextureRepeat = 2;
+  // How each material gets its wood or marble, indexed by mgl::Texture3D::Type: sampled from a
+  // generated volume, stored as R8 or BC4 (half the memory), only the bricks around its mesh,
+  // evaluated in the fragment shader, which generates and stores no volume at all, or baked
+  // over the surface of its mesh in a 2D atlas of AtlasSize^2 texels (filtered, with mipmaps)
+  enum class VolumeMode { BAKED, COMPRESSED, BRICKED, PROCEDURAL, ATLAS };
+  VolumeMode MaterialModes[2] = { VolumeMode::COMPRESSED, VolumeMode::COMPRESSED };
+  // Noise each generated volume is made of, also indexed by type. Simplex generates faster
+  // but does not tile, with TextureRepeat > 1 it falls back to Perlin (PROCEDURAL is always Perlin)
+  mgl::NoiseGenerator::Backend MaterialNoise[2] = { mgl::NoiseGenerator::PERLIN, mgl::NoiseGenerator::PERLIN };
+  // Recipes of the generated volumes, by material name ("wood", "marble"), read from materials.json
+  // with UseMaterialGraphs. A material missing from the file uses the built-in recipe, PROCEDURAL
+  // always does. The graphs of the file give the same volumes at about the same cost, they are
+  // there to change the materials without C++ edits
+  bool UseMaterialGraphs = false;
+  std::map<std::string, std::shared_ptr<const mgl::TextureGraph>> MaterialGraphs;
+  // Bump maps the grain of a BAKED built-in material with the gradient stored next to each texel,
+  // an RGBA8 volume of four times the memory (see mgl::Texture3D::setGradient)
+  bool MaterialGradient[2] = { false, false };
+  // Generates wood and marble into the red and green channels of one RG8 volume shared by both,
+  // so drawing them binds no other texture. Only when both are BAKED without gradient, the
+  // volume is made with the noise of wood (see mgl::Texture3D::addChannel)
+  bool PackMaterials = false;
+  mgl::Texture3D* PackedTexture = nullptr;
+  // Side of the atlas an ATLAS material is baked in, R8 so 512 is 341 KB with its mipmaps
+  unsigned int AtlasSize = 512;
+  // BRICKED volumes and ATLAS textures are generated once the scene is loaded, around the
+  // meshes of the nodes sampling them with their texture transforms
+  struct PendingBricked {
+      std::string name;
+      mgl::Texture3D::Type type;
+      mgl::BrickedTexture3D* texture;
+  };
+  std::vector<PendingBricked> PendingBrickedTextures;
+  struct PendingAtlas {
+      std::string name;
+      mgl::Texture3D::Type type;
+      mgl::AtlasTexture* texture;
+  };
+  std::vector<PendingAtlas> PendingAtlasTextures;
 
   static constexpr std::uint8_t backgroundIndex = 0xFF;
   std::uint8_t hoveredIndex = backgroundIndex;
@@ -51,11 +97,18 @@ class MyApp : public mgl::App {
 
   void activateStencilBuffer();
   void createMeshes();
-  void createMesh(std::string name, std::string meshFile);
+  mgl::Task<void> loadMeshes(std::string cubeFile, std::string baseFile, std::string floatingFile);
+  mgl::Task<void> createMaterialMesh(std::string name, std::string meshFile, mgl::Texture3D::Type type);
+  // Meshes only store the attributes of Format, those their shaders read
+  template <typename Format>
+  mgl::Task<void> createMesh(std::string name, std::string meshFile, bool atlas = false);
   void createTextures();
   void createTexture3D(std::string name, mgl::Texture3D::Type type);
+  void generateSceneTextures();
   void createShaderPrograms();
-  void createShaderProgram(std::string shaderName, std::string vsFile, std::string fsFile, bool sillouette);
+  bool hasGradient(mgl::Texture3D::Type type);
+  bool packsMaterials();
+  void createShaderProgram(std::string shaderName, std::string vsFile, std::string fsFile, bool sillouette, VolumeMode mode = VolumeMode::BAKED, bool gradient = false, int channel = -1);
   void createCallBacks();
   void createSillouetteInfos();
   void createSillouetteInfo(std::string name, glm::vec3 scale);
@@ -64,6 +117,7 @@ class MyApp : public mgl::App {
   mgl::SceneNode* createNode(int nodeId, std::string mesh, glm::vec3 position, glm::quat rotation, glm::vec3 scale, mgl::SceneNode* parent, std::string shader);
   void drawScene(double elapsed);
   void processAnimation(double elapsed);
+  void refineTextures();
   void handleObjectMovement(double xpos, double ypos);
   void handleObjectRotation();
   void handleAxisObjectMovement(mgl::SceneNode* node, int key, glm::vec3 nodeDirection, glm::vec3 direction, float xMoved, float yMoved);
@@ -255,52 +309,260 @@ void MyApp::createMeshes() {
     std::string base_mesh_fullname = mesh_dir + base_mesh_file /*"../04-assets/models/cube-vtn.obj"*/;
     std::string floating_obj_mesh_fullname = mesh_dir + floating_obj_mesh_file;
 
-    createMesh("cubeMesh", cube_mesh_fullname);
-    createMesh("baseMesh", base_mesh_fullname);
-    createMesh("floatingMesh", floating_obj_mesh_fullname);
+    // imported meshes are kept here and mapped instead of imported on the next start
+    mgl::MeshCache::getInstance().setDirectory("mesh-cache");
+
+    // the meshes are imported at the same time on the loader workers, this thread only creates their buffers
+    try {
+        mgl::Loader::getInstance().wait(loadMeshes(cube_mesh_fullname, base_mesh_fullname, floating_obj_mesh_fullname));
+    }
+    catch (const std::runtime_error& error) {
+        std::cerr << "ERROR: " << error.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+mgl::Task<void> MyApp::loadMeshes(std::string cubeFile, std::string baseFile, std::string floatingFile) {
+    // the light cube only goes through light-vs.glsl
+    mgl::Task<void> cube = createMesh<mgl::VertexFormat<mgl::PositionAttribute>>("cubeMesh", cubeFile);
+    mgl::Task<void> base = createMaterialMesh("baseMesh", baseFile, mgl::Texture3D::WOOD);
+    mgl::Task<void> floating = createMaterialMesh("floatingMesh", floatingFile, mgl::Texture3D::MARBLE);
+    // none is left running when another throws
+    co_await mgl::whenAll(cube, base, floating);
+    co_await cube;
+    co_await base;
+    co_await floating;
+}
+
+// The meshes of ATLAS materials are laid out in an atlas when loaded and keep its texcoords,
+// the volumes of the others are sampled at the positions
+mgl::Task<void> MyApp::createMaterialMesh(std::string name, std::string meshFile, mgl::Texture3D::Type type) {
+    if (MaterialModes[type] == VolumeMode::ATLAS) {
+        co_await createMesh<mgl::VertexFormat<mgl::PositionAttribute, mgl::NormalAttribute, mgl::TexcoordAttribute>>(name, meshFile, true);
+    }
+    else {
+        co_await createMesh<mgl::VertexFormat<mgl::PositionAttribute, mgl::NormalAttribute>>(name, meshFile);
+    }
 }
 
-void MyApp::createMesh(std::string name, std::string meshFile) {
+template <typename Format>
+mgl::Task<void> MyApp::createMesh(std::string name, std::string meshFile, bool atlas) {
     mgl::Mesh* mesh = new mgl::Mesh();
     mesh->joinIdenticalVertices();
-    mesh->create(meshFile);
+    mesh->optimizeVertexOrder();
+    mesh->generateLevels(4);
+    mesh->setVertexFormat<Format>();
+    mesh->quantizeAttributes();
+    if (atlas) {
+        mesh->generateAtlas(AtlasSize);
+    }
+    co_await mgl::loadMesh(mesh, meshFile);
 
+    // back on this thread
     mgl::MeshManager::getInstance().add(name, mesh);
 }
 
 void MyApp::createTextures() {
     BaseSampler = new mgl::NearestSampler();
     BaseSampler->create();
+    AtlasSampler = new mgl::LinearAnisotropicSampler();
+    AtlasSampler->create();
+
+    // generated volumes are kept here and loaded instead of regenerated on the next start
+    mgl::VolumeCache::getInstance().setDirectory("texture-cache");
+    if (UseMaterialGraphs) {
+        MaterialGraphs = mgl::TextureGraph::load("materials.json");
+    }
 
     createTexture3D("baseTexture3D", mgl::Texture3D::WOOD);
     createTexture3D("floatingTexture3D", mgl::Texture3D::MARBLE);
 }
 
+// Texture coordinates of a model space position, as wood-vs.glsl and marble-vs.glsl compute them
+static glm::vec3 volumeTexcoord(const glm::vec3& position) {
+    return glm::vec3(position.x, position.z, position.y) * 0.99f * 0.5f + 0.5f;
+}
+
+// Only uncompressed volumes of the built-in recipes store a gradient
+bool MyApp::hasGradient(mgl::Texture3D::Type type) {
+    return MaterialGradient[type] && MaterialModes[type] == VolumeMode::BAKED &&
+        MaterialGraphs.find(type == mgl::Texture3D::WOOD ? "wood" : "marble") == MaterialGraphs.end();
+}
+
+bool MyApp::packsMaterials() {
+    return PackMaterials && MaterialModes[mgl::Texture3D::WOOD] == VolumeMode::BAKED && MaterialModes[mgl::Texture3D::MARBLE] == VolumeMode::BAKED &&
+        !hasGradient(mgl::Texture3D::WOOD) && !hasGradient(mgl::Texture3D::MARBLE);
+}
+
+// The graph of a material, null for the built-in recipe
+static std::shared_ptr<const mgl::TextureGraph> materialGraph(const std::map<std::string, std::shared_ptr<const mgl::TextureGraph>>& graphs, mgl::Texture3D::Type type) {
+    auto graph = graphs.find(type == mgl::Texture3D::WOOD ? "wood" : "marble");
+    return graph != graphs.end() ? graph->second : nullptr;
+}
+
 void MyApp::createTexture3D(std::string name, mgl::Texture3D::Type type) {
+    std::shared_ptr<const mgl::TextureGraph> Graph = materialGraph(MaterialGraphs, type);
+
+    if (MaterialModes[type] == VolumeMode::PROCEDURAL) {
+        // the shader only needs the permutation table of the noise
+        mgl::PermutationTexture* Permutations = new mgl::PermutationTexture();
+        Permutations->generate(0);
+        mgl::TextureInfo* TextureInfo = new mgl::TextureInfo(GL_TEXTURE0, GL_TEXTURE0, mgl::TEXTURE, Permutations, BaseSampler);
+        mgl::TextureInfoManager::getInstance().add(name, TextureInfo);
+        return;
+    }
+
+    if (MaterialModes[type] == VolumeMode::BRICKED) {
+        // a non repeating 256^3 volume, generated by generateBrickedTextures
+        mgl::BrickedTexture3D* Bricked = new mgl::BrickedTexture3D();
+        Bricked->setNoise(MaterialNoise[type]);
+        Bricked->setGraph(Graph);
+        PendingBrickedTextures.push_back({ name, type, Bricked });
+        mgl::TextureInfo* TextureInfo = new mgl::TextureInfo(GL_TEXTURE0, GL_TEXTURE0, mgl::TEXTURE, Bricked, BaseSampler);
+        mgl::TextureInfoManager::getInstance().add(name, TextureInfo);
+        return;
+    }
+
+    if (MaterialModes[type] == VolumeMode::ATLAS) {
+        // the texels of the volume BAKED would sample, baked by generateSceneTextures
+        mgl::AtlasTexture* Atlas = new mgl::AtlasTexture();
+        Atlas->setNoise(MaterialNoise[type]);
+        Atlas->setGraph(Graph);
+        PendingAtlasTextures.push_back({ name, type, Atlas });
+        mgl::TextureInfo* TextureInfo = new mgl::TextureInfo(GL_TEXTURE0, GL_TEXTURE0, mgl::TEXTURE, Atlas, AtlasSampler);
+        TextureInfo->texcoordScale = (float)TextureRepeat;
+        mgl::TextureInfoManager::getInstance().add(name, TextureInfo);
+        return;
+    }
+
+    if (packsMaterials() && type == mgl::Texture3D::MARBLE) {
+        // already in the green channel of the volume of wood
+        mgl::TextureInfo* TextureInfo = new mgl::TextureInfo(GL_TEXTURE0, GL_TEXTURE0, mgl::TEXTURE, PackedTexture, BaseSampler);
+        TextureInfo->texcoordScale = (float)TextureRepeat;
+        mgl::TextureInfoManager::getInstance().add(name, TextureInfo);
+        return;
+    }
+
     mgl::Texture3D* Texture3D = new mgl::Texture3D();
+    if (MaterialModes[type] == VolumeMode::COMPRESSED) {
+        Texture3D->setCompression(mgl::Texture3D::BC4);
+    }
+    Texture3D->setNoise(MaterialNoise[type]);
+    Texture3D->setGraph(Graph);
+    Texture3D->setGradient(hasGradient(type));
+    if (packsMaterials()) {
+        Texture3D->addChannel(mgl::Texture3D::MARBLE, materialGraph(MaterialGraphs, mgl::Texture3D::MARBLE));
+        PackedTexture = Texture3D;
+    }
 
     // If the app is failing to load due to memory or its taking too long to start, reduce the texture resolution
-    Texture3D->generatePerlinNoiseTexture(256, 256, 256, type);
-    //Texture3D->generatePerlinNoiseTexture(32, 32, 32, type);
+    // (Benchmarks/noise-benchmark times the generation of each resolution on this machine)
+    // A 32x32x32 preview is shown until the full volume is ready, use generatePerlinNoiseTexture to wait for it instead
+    // The volume is a seamless tile repeated TextureRepeat times, same texel density as a 256^3 volume
+    const unsigned int size = 256 / TextureRepeat;
+    Texture3D->generateProgressive(size, size, size, type, 0, TextureRepeat);
+    RefiningTextures.push_back(Texture3D);
 
     mgl::TextureInfo* TextureInfo = new mgl::TextureInfo(GL_TEXTURE0, GL_TEXTURE0, mgl::TEXTURE, Texture3D, BaseSampler);
+    TextureInfo->texcoordScale = (float)TextureRepeat;
     mgl::TextureInfoManager::getInstance().add(name, TextureInfo);
 }
 
+// Nodes under node drawing a mesh with the texture
+static void collectNodes(mgl::SceneNode* node, const std::string& texture, std::vector<mgl::SceneNode*>& nodes) {
+    if (node->getMesh() && node->getTextureInfoName() == texture) {
+        nodes.push_back(node);
+    }
+    for (mgl::SceneNode* child : node->getChildren()) {
+        collectNodes(child, texture, nodes);
+    }
+}
+
+// Texture coordinates of every triangle of the mesh of the node
+static std::vector<glm::vec3> volumeTriangles(mgl::SceneNode* node, float texcoordScale) {
+    std::vector<glm::vec3> triangles;
+    const glm::mat4 textureMatrix = node->getTextureMatrix();
+    for (const glm::vec3& vertex : node->getMesh()->getTrianglePositions()) {
+        triangles.push_back(texcoordScale * glm::vec3(textureMatrix * glm::vec4(volumeTexcoord(vertex), 1.0f)));
+    }
+    return triangles;
+}
+
+void MyApp::generateSceneTextures() {
+    for (PendingBricked& pending : PendingBrickedTextures) {
+        std::vector<mgl::SceneNode*> nodes;
+        collectNodes(SceneGraph->getRoot(), pending.name, nodes);
+        float texcoordScale = mgl::TextureInfoManager::getInstance().get(pending.name)->texcoordScale;
+        std::vector<glm::vec3> footprint;
+        for (mgl::SceneNode* node : nodes) {
+            std::vector<glm::vec3> triangles = volumeTriangles(node, texcoordScale);
+            footprint.insert(footprint.end(), triangles.begin(), triangles.end());
+        }
+        // a volume no node samples has an empty footprint, which generates every brick
+        pending.texture->setFootprint(footprint);
+        pending.texture->generatePerlinNoiseTexture(256, 256, 256, pending.type, 0);
+    }
+    PendingBrickedTextures.clear();
+
+    for (PendingAtlas& pending : PendingAtlasTextures) {
+        std::vector<mgl::SceneNode*> nodes;
+        collectNodes(SceneGraph->getRoot(), pending.name, nodes);
+        float texcoordScale = mgl::TextureInfoManager::getInstance().get(pending.name)->texcoordScale;
+        // an atlas holds the surface of one node, others only match if they draw the same
+        // mesh with the same texture transform
+        for (mgl::SceneNode* node : nodes) {
+            if (node->getMesh() != nodes[0]->getMesh() || node->getTextureMatrix() != nodes[0]->getTextureMatrix()) {
+                std::cerr << "WARNING: Atlas " << pending.name << " is baked for a node drawing " << nodes[0]->getMeshName()
+                    << ", another node samples it with a different mesh or texture transform" << std::endl;
+                break;
+            }
+        }
+        if (!nodes.empty()) {
+            pending.texture->setSurface(volumeTriangles(nodes[0], texcoordScale), nodes[0]->getMesh()->getTriangleTexcoords());
+        }
+        const unsigned int size = 256 / TextureRepeat;
+        pending.texture->generatePerlinNoiseTexture(AtlasSize, size, size, size, pending.type, 0, TextureRepeat);
+    }
+    PendingAtlasTextures.clear();
+}
+
 ///////////////////////////////////////////////////////////////////////// SHADER
 
 void MyApp::createShaderPrograms() {
-    createShaderProgram("woodShader", "wood-vs.glsl", "wood-fs.glsl", false);
-    createShaderProgram("marbleShader", "marble-vs.glsl", "marble-fs.glsl", false);
+    createShaderProgram("woodShader", "wood-vs.glsl", "wood-fs.glsl", false, MaterialModes[mgl::Texture3D::WOOD], hasGradient(mgl::Texture3D::WOOD),
+        packsMaterials() ? mgl::Texture3D::WOOD : -1);
+    createShaderProgram("marbleShader", "marble-vs.glsl", "marble-fs.glsl", false, MaterialModes[mgl::Texture3D::MARBLE], hasGradient(mgl::Texture3D::MARBLE),
+        packsMaterials() ? mgl::Texture3D::MARBLE : -1);
     createShaderProgram("sillouetteShader", "color-vs.glsl", "color-fs.glsl", true);
     createShaderProgram("lightShader", "light-vs.glsl", "light-fs.glsl", true);
 }
 
-void MyApp::createShaderProgram(std::string shaderName, std::string vsFile, std::string fsFile, bool sillouette) {
+void MyApp::createShaderProgram(std::string shaderName, std::string vsFile, std::string fsFile, bool sillouette, VolumeMode mode, bool gradient, int channel) {
     mgl::Mesh* BaseMesh = mgl::MeshManager::getInstance().get("baseMesh");
     mgl::Mesh* FloatingMesh = mgl::MeshManager::getInstance().get("floatingMesh");
 
     mgl::ShaderProgram* Shader = new mgl::ShaderProgram();
+    if (mode == VolumeMode::COMPRESSED) {
+        Shader->addDefine(mgl::COMPRESSED_VOLUME_DEFINE);
+    }
+    else if (mode == VolumeMode::BRICKED) {
+        Shader->addDefine(mgl::BRICKED_VOLUME_DEFINE);
+        Shader->addDefine(mgl::BRICK_SIZE_DEFINE, std::to_string(mgl::BrickedTexture3D::BRICK_SIZE));
+    }
+    else if (mode == VolumeMode::PROCEDURAL) {
+        Shader->addDefine(mgl::PROCEDURAL_VOLUME_DEFINE);
+        Shader->addInclude(GL_FRAGMENT_SHADER, "noise.glsl");
+    }
+    else if (mode == VolumeMode::ATLAS) {
+        Shader->addDefine(mgl::ATLAS_TEXTURE_DEFINE);
+    }
+    if (gradient) {
+        Shader->addDefine(mgl::GRADIENT_VOLUME_DEFINE);
+        Shader->addDefine(mgl::GRADIENT_SCALE_DEFINE, std::to_string(mgl::Texture3D::GRADIENT_SCALE));
+    }
+    if (channel >= 0) {
+        Shader->addDefine(mgl::VOLUME_CHANNEL_DEFINE, std::to_string(channel));
+    }
     Shader->addShader(GL_VERTEX_SHADER, vsFile);
     Shader->addShader(GL_FRAGMENT_SHADER, fsFile);
 
@@ -310,7 +572,8 @@ void MyApp::createShaderProgram(std::string shaderName, std::string vsFile, std:
         if (BaseMesh->hasNormals() && FloatingMesh->hasNormals()) {
             Shader->addAttribute(mgl::NORMAL_ATTRIBUTE, mgl::Mesh::NORMAL);
         }
-        if (BaseMesh->hasTexcoords() && FloatingMesh->hasTexcoords()) {
+        // the atlas texcoords of ATLAS materials
+        if (mode == VolumeMode::ATLAS || (BaseMesh->hasTexcoords() && FloatingMesh->hasTexcoords())) {
             Shader->addAttribute(mgl::TEXCOORD_ATTRIBUTE, mgl::Mesh::TEXCOORD);
         }
         if (BaseMesh->hasTangentsAndBitangents() && FloatingMesh->hasTangentsAndBitangents()) {
@@ -319,9 +582,15 @@ void MyApp::createShaderProgram(std::string shaderName, std::string vsFile, std:
 
         //Shader->addUniform(mgl::NORMAL_MATRIX);
         Shader->addUniform(mgl::TEXTURE);
+        Shader->addUniform(mgl::TEXCOORD_SCALE);
+        Shader->addUniform(mgl::TEXTURE_MATRIX);
+        if (mode == VolumeMode::BRICKED) {
+            Shader->addUniform(mgl::PAGE_TABLE);
+        }
     }
 
     Shader->addUniform(mgl::MODEL_MATRIX);
+    Shader->addUniform(mgl::DEQUANTIZATION_MATRIX);
     Shader->addUniformBlock(mgl::CAMERA_BLOCK, UBO_BP);
     Shader->addUniformBlock(mgl::LIGHT_BLOCK, UBO_BP_LIGHT);
     Shader->create();
@@ -445,6 +714,7 @@ void MyApp::initCallback(GLFWwindow* win) {
     createCallBacks();
     createSillouetteInfos();
     createScene();
+    generateSceneTextures();  // after scene
     createCameras();
 }
 
@@ -454,6 +724,7 @@ void MyApp::windowSizeCallback(GLFWwindow *win, int winx, int winy) {
 }
 
 void MyApp::displayCallback(GLFWwindow *win, double elapsed) { 
+    refineTextures();
     processAnimation(elapsed);
     drawScene(elapsed); 
 }
@@ -471,6 +742,15 @@ void MyApp::processAnimation(double elapsed) {
     // empty for now
 }
 
+void MyApp::refineTextures() {
+    if (RefiningTextures.empty()) return;
+
+    // one texture at a time, in the order they were created
+    if (RefiningTextures.front()->refine(RefineBudget)) {
+        RefiningTextures.erase(RefiningTextures.begin());
+    }
+}
+
 /////////////////////////////////////////////////////////////////////////// MAIN
 
 int main(int argc, char *argv[]) {
@@ -3,6 +3,8 @@
 in vec3 inPosition;
 
 uniform mat4 ModelMatrix;
+// takes inPosition to model space, see Mesh::quantizeAttributes
+uniform mat4 DequantizationMatrix;
 
 uniform Camera {
    mat4 ViewMatrix;
@@ -10,5 +12,5 @@ uniform Camera {
 };
 
 void main(void) {
-  gl_Position = ProjectionMatrix * ViewMatrix * ModelMatrix * vec4(inPosition, 1.0);
+  gl_Position = ProjectionMatrix * ViewMatrix * ModelMatrix * DequantizationMatrix * vec4(inPosition, 1.0);
 }
@@ -1,11 +1,78 @@
 #version 330 core
 
+// compressed volumes are stored as a 2D array with one layer per slice, bricked
+// ones only where the mesh is, procedural ones are evaluated here with the noise
+// of noise.glsl, atlas ones are baked in a 2D texture over the surface of the mesh
+#ifdef PROCEDURAL_VOLUME
+// Texture3D::generateMarbleSublevel at the texture coordinate
+float sampleVolume(vec3 texcoord) {
+	float normalizedN = (fractalNoise(vec3(2.0 * texcoord.xy, texcoord.z), 8, 2.0, 0.6) + 1.0) / 2.0;
+	float xyValue = 0.5 * texcoord.x + 1.0 * texcoord.y + 5.0 * normalizedN;
+	float sineValue = abs(sin(xyValue * 3.14159));
+
+	if (sineValue >= -0.001 && sineValue < 0.1) sineValue += 0.05 * (1.0 - sineValue);
+	float value = sineValue > 0.0 && sineValue < 1.0 ? sineValue + sineValue * (1.0 - sineValue) : sineValue;
+	// in float the values just below 1 round up to 1 and would wrap to 0
+	return volumeTexel(min(value, 255.0 / 256.0));
+}
+#elif defined(BRICKED_VOLUME)
+// brick atlas and page table of a mgl::BrickedTexture3D, w is 0 for bricks never generated
+uniform sampler3D Texture;
+uniform usampler3D PageTable;
+
+float sampleVolume(vec3 texcoord) {
+	ivec3 size = textureSize(PageTable, 0) * BRICK_SIZE;
+	ivec3 texel = min(ivec3(fract(texcoord) * vec3(size)), size - 1);
+	uvec4 page = texelFetch(PageTable, texel / BRICK_SIZE, 0);
+	return texelFetch(Texture, ivec3(page.xyz) * BRICK_SIZE + texel % BRICK_SIZE, 0).x;
+}
+#elif defined(ATLAS_TEXTURE)
+// the volume baked over the atlas of the mesh by mgl::AtlasTexture
+uniform sampler2D Texture;
+in vec2 exAtlasTexcoord;
+
+float sampleVolume(vec3 texcoord) {
+	return texture(Texture, exAtlasTexcoord).x;
+}
+#elif defined(COMPRESSED_VOLUME)
+uniform sampler2DArray Texture;
+
+float sampleVolume(vec3 texcoord) {
+	float layers = float(textureSize(Texture, 0).z);
+	return texture(Texture, vec3(texcoord.xy, floor(fract(texcoord.z) * layers))).x;
+}
+#else
 uniform sampler3D Texture;
 
+float sampleVolume(vec3 texcoord) {
+#ifdef VOLUME_CHANNEL
+	// the channel of this material in a volume packing several (Texture3D::addChannel)
+	return texture(Texture, texcoord)[VOLUME_CHANNEL];
+#else
+	return texture(Texture, texcoord).x;
+#endif
+}
+
+#ifdef GRADIENT_VOLUME
+// gradient along the texture coordinates stored in gba by Texture3D::setGradient,
+// each component g as g / (|g| + GRADIENT_SCALE) * 127 + 128
+vec3 sampleGradient(vec3 texcoord) {
+	vec3 e = (texture(Texture, texcoord).yzw * 255.0 - 128.0) / 127.0;
+	return GRADIENT_SCALE * e / (1.0 - min(length(e), 0.99));
+}
+#endif
+#endif
+
 in vec3 exPosition;
 in vec3 exTexcoord;
 in vec3 exNormal;
 in vec3 exFragPositionVC;
+#ifdef GRADIENT_VOLUME
+in mat3 exGradientMatrix;
+
+// how far the grain bends the normal per unit of gradient
+float BumpDepth = 0.003f;
+#endif
 
 vec3 PrimaryColor1 = vec3(1.0f, 1.0f, 1.0f);
 vec3 SecondaryColor1 = vec3(0.2f, 0.2f, 0.2f);
@@ -31,6 +98,10 @@ out vec4 FragmentColor;
 void main(void)
 {
 	vec3 N = normalize(exNormal);
+#ifdef GRADIENT_VOLUME
+	vec3 G = exGradientMatrix * sampleGradient(exTexcoord);
+	N = normalize(N - BumpDepth * (G - dot(G, N) * N));
+#endif
 	vec4 lightPositionVC = ViewMatrix * vec4(LightPosition, 1.0);
 	vec3 lightDirectionVC = normalize(lightPositionVC.xyz - exFragPositionVC);
 
@@ -51,7 +122,7 @@ void main(void)
 	float attenuation = 1 / (1.0f + (0.09f * lightDistance) + (0.032 * (lightDistance * lightDistance)));
 	vec3 resultingLight = ambient + (attenuation * (diffuse + specular));
 
-	float k = texture(Texture, exTexcoord).x;
+	float k = sampleVolume(exTexcoord);
 	vec3 resultingColor = resultingLight * mix(SecondaryColor1, PrimaryColor1, k);
 	FragmentColor = vec4(resultingColor, 1.0f);
 }
@@ -0,0 +1,58 @@
+// GLSL port of mgl::PerlinNoiseGenerator and mgl::FractalNoise, pasted before the
+// fragment shaders of the procedural materials. The permutation table (the 256
+// entries twice) is the usampler1D bound to Texture, see mgl::PermutationTexture.
+
+uniform usampler1D Texture;
+
+int permutation(int i) {
+	return int(texelFetch(Texture, i, 0).r);
+}
+
+float fade(float t) {
+	return t * t * t * (t * (t * 6.0 - 15.0) + 10.0);
+}
+
+// the 16 gradients of PerlinNoiseGenerator::grad
+float grad(int hash, vec3 p) {
+	int h = hash & 15;
+	float u = h < 8 ? p.x : p.y;
+	float v = h < 4 ? p.y : (h == 12 || h == 14 ? p.x : p.z);
+	return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+}
+
+float perlinNoise(vec3 p) {
+	vec3 cell = floor(p);
+	ivec3 i = ivec3(cell) & 255;
+	vec3 f = p - cell;
+	vec3 w = vec3(fade(f.x), fade(f.y), fade(f.z));
+
+	int A = permutation(i.x) + i.y, B = permutation(i.x + 1) + i.y;
+	int AA = permutation(A) + i.z, AB = permutation(A + 1) + i.z;
+	int BA = permutation(B) + i.z, BB = permutation(B + 1) + i.z;
+
+	float x11 = mix(grad(permutation(AA), f), grad(permutation(BA), f - vec3(1.0, 0.0, 0.0)), w.x);
+	float x12 = mix(grad(permutation(AB), f - vec3(0.0, 1.0, 0.0)), grad(permutation(BB), f - vec3(1.0, 1.0, 0.0)), w.x);
+	float x21 = mix(grad(permutation(AA + 1), f - vec3(0.0, 0.0, 1.0)), grad(permutation(BA + 1), f - vec3(1.0, 0.0, 1.0)), w.x);
+	float x22 = mix(grad(permutation(AB + 1), f - vec3(0.0, 1.0, 1.0)), grad(permutation(BB + 1), f - vec3(1.0, 1.0, 1.0)), w.x);
+
+	return mix(mix(x11, x12, w.y), mix(x21, x22, w.y), w.z);
+}
+
+// octave i samples (lacunarity^i * p.xy, p.z) and is weighted by gain^i / sum(gain^k)
+float fractalNoise(vec3 p, int octaves, float lacunarity, float gain) {
+	float sum = 0.0, totalAmplitude = 0.0;
+	float frequency = 1.0, amplitude = 1.0;
+	for (int i = 0; i < octaves; i++) {
+		sum += amplitude * perlinNoise(vec3(frequency * p.xy, p.z));
+		totalAmplitude += amplitude;
+		frequency *= lacunarity;
+		amplitude *= gain;
+	}
+	return sum / totalAmplitude;
+}
+
+// The baked volumes store floor(value * 256) in a byte, values outside [0, 1)
+// wrap around and that is part of the look
+float volumeTexel(float value) {
+	return mod(floor(value * 256.0), 256.0) / 255.0;
+}
@@ -8,8 +8,21 @@ out vec3 exPosition;
 out vec3 exTexcoord;
 out vec3 exNormal;
 out vec3 exFragPositionVC;
+#ifdef ATLAS_TEXTURE
+// where the vertex is in the atlas of the mesh (Mesh::generateAtlas)
+out vec2 exAtlasTexcoord;
+#endif
+#ifdef GRADIENT_VOLUME
+// takes the gradient of the volume along the texture coordinates to view space
+out mat3 exGradientMatrix;
+#endif
 
 uniform mat4 ModelMatrix;
+// takes inPosition to model space, see Mesh::quantizeAttributes
+uniform mat4 DequantizationMatrix;
+uniform float TexcoordScale;
+// per node, see SceneNode::setTextureOffset
+uniform mat4 TextureMatrix;
 //uniform mat3 NormalMatrix;
 
 uniform Camera {
@@ -19,11 +32,20 @@ uniform Camera {
 
 void main(void)
 {
-	exPosition = inPosition;
-	exTexcoord = vec3(inPosition.x * 0.99 * 0.5 + 0.5, (inPosition.z) * 0.99 * 0.5 + 0.5, inPosition.y * 0.99 * 0.5 + 0.5);
-	exNormal = mat3(transpose(inverse(ViewMatrix * ModelMatrix))) * inNormal;
+	vec3 position = (DequantizationMatrix * vec4(inPosition, 1.0)).xyz;
+	exPosition = position;
+	vec3 texcoord = vec3(position.x * 0.99 * 0.5 + 0.5, (position.z) * 0.99 * 0.5 + 0.5, position.y * 0.99 * 0.5 + 0.5);
+	exTexcoord = TexcoordScale * (TextureMatrix * vec4(texcoord, 1.0)).xyz;
+#ifdef ATLAS_TEXTURE
+	exAtlasTexcoord = inTexcoord.xy;
+#endif
+	mat3 normalMatrix = mat3(transpose(inverse(ViewMatrix * ModelMatrix)));
+	exNormal = normalMatrix * inNormal;
+#ifdef GRADIENT_VOLUME
+	exGradientMatrix = normalMatrix * (TexcoordScale * 0.99 * 0.5 * mat3(vec3(1.0, 0.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 0.0)) * transpose(mat3(TextureMatrix)));
+#endif
 
-	vec4 MCPosition = vec4(inPosition, 1.0);
+	vec4 MCPosition = vec4(position, 1.0);
 	exFragPositionVC = vec3(ViewMatrix * ModelMatrix * MCPosition);
 	gl_Position = ProjectionMatrix * ViewMatrix * ModelMatrix * MCPosition;
 }
@@ -0,0 +1,674 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Noise and procedural texture benchmark suite
+//
+// Headless, no GL context is created: only the CPU side of the generation is
+// timed. Every case reports ns/sample and samples/s, best of a few runs:
+//
+//   noise      PerlinNoiseGenerator::noise, double and batched, and the
+//              batched simplex noise over one 256x256 slice
+//   gradient   noiseWithGradient on both backends against the four batched
+//              noise calls of a forward difference gradient
+//   harmonic   per texel double harmonicNoise against the row oriented
+//              FractalNoise on both backends, marble parameters (8 octaves,
+//              lacunarity 2, gain 0.6)
+//   bc4        BC4 encoding of that slice, and of the wood and marble volumes
+//              as Texture3D compresses them, and the PSNR each keeps
+//   volume     wood and marble volumes through Texture3D::generatePlanes and
+//              generateSlices (the Sublevel generators) at every size and
+//              thread count, the slices split over a ThreadPool of that size,
+//              then the same through the TextureGraph of each material in the
+//              materials file and the speedup of the graph over the recipe,
+//              and the recipes with their gradient (setGradient) and its cost
+//   packed     both recipes packed in one RG8 volume (addChannel), its overhead
+//              over the two volumes
+//   mipmaps    the mip chain of those volumes through Texture3D::downsampleLevel,
+//              the first three levels in the slice jobs and the rest after them
+//   atlas      marble baked over the surface of a cube in a 512x512 atlas
+//              (AtlasTexture::bakeSurface, on the shared pool) per texel of
+//              the surface, and its memory over that of the volume
+//
+// Options:
+//   --json FILE       also write the results as JSON, - for stdout
+//   --sizes 64,128    volume sides (default 64,128,256)
+//   --threads 1,4     worker counts (default 1 and every hardware thread)
+//   --noise perlin    backends of the volumes, perlin and/or simplex
+//   --materials FILE  graphs of the volume case (default
+//                     ../3D_Tangram/materials.json), none if it is missing
+//   --check           only the cases with bounds (harmonic, bc4), once each
+//
+// The harmonic case also writes noise-perlin.pgm and noise-simplex.pgm, the
+// same slice with either backend for a visual comparison.
+//
+// Checks with bounds fail when out of them: MaxDifference above the
+// BATCH_TOLERANCE of the backend, PSNR below Texture3D::MIN_PSNR for volumes
+// of at least Texture3D::MIN_PSNR_SIZE (smaller ones are only reported). The suite
+// then exits with EXIT_FAILURE, so that make check fails.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fractalNoise.hpp"
+#include "json.hpp"
+#include "mglAtlas.hpp"
+#include "mglCompression.hpp"
+#include "mglTexture.hpp"
+#include "mglTextureGraph.hpp"
+#include "mglThreadPool.hpp"
+#include "perlinNoise.hpp"
+#include "simplexNoise.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+
+const unsigned int SIZE = 256;
+const int REPEATS = 5;
+// a case stops repeating once its runs add up to this many seconds
+const double MIN_SECONDS = 1.0;
+
+struct Marble {
+  static constexpr float lacunarity = 2.0f, gain = 0.6f;
+};
+
+struct Options {
+  std::string jsonFile;
+  std::vector<unsigned int> sizes = {64, 128, 256};
+  std::vector<unsigned int> threads;
+  std::vector<mgl::NoiseGenerator::Backend> noise = {
+      mgl::NoiseGenerator::PERLIN};
+  std::string materialsFile = "../3D_Tangram/materials.json";
+  bool checkOnly = false;
+};
+
+json Results = json::array();
+bool Failed = false;
+// set by --check, every case runs once
+bool Once = false;
+
+const char *backendName(mgl::NoiseGenerator::Backend backend) {
+  return backend == mgl::NoiseGenerator::SIMPLEX ? "simplex" : "perlin";
+}
+
+// best of up to REPEATS runs, in ns per sample
+template <typename F> double time(double samples, F &&run) {
+  double best = 1e300, total = 0;
+  const int repeats = Once ? 1 : REPEATS;
+  for (int r = 0; r < repeats && (r == 0 || total < MIN_SECONDS); r++) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    best = std::fmin(best, seconds * 1e9 / samples);
+    total += seconds;
+  }
+  return best;
+}
+
+// prints the case and keeps it for the JSON, params describe the variant
+void report(const std::string &name, json params, double samples,
+            double ns) {
+  std::ostringstream label, line;
+  label << name;
+  for (auto &param : params.items()) {
+    label << " " << param.key() << "="
+          << (param.value().is_string() ? param.value().get<std::string>()
+                                        : param.value().dump());
+  }
+  line << std::left << std::setw(44) << label.str() << std::right
+       << std::fixed << std::setprecision(2) << std::setw(10) << ns
+       << " ns/sample" << std::setprecision(0) << std::setw(14) << 1e9 / ns
+       << " samples/s";
+  std::cout << line.str() << std::endl;
+
+  json result;
+  result["Name"] = name;
+  result["Params"] = params;
+  result["Samples"] = samples;
+  result["NsPerSample"] = ns;
+  result["SamplesPerSecond"] = 1e9 / ns;
+  Results.push_back(result);
+}
+
+void check(const std::string &name, double value) {
+  std::cout << "  " << name << " " << value << std::endl;
+  Results.back()[name] = value;
+}
+
+// As check, failing the suite when value is not within [min, max]
+void check(const std::string &name, double value, double min, double max) {
+  bool passed = value >= min && value <= max;
+  std::cout << "  " << name << " " << value;
+  if (!passed) std::cout << "  FAILED, not in [" << min << ", " << max << "]";
+  std::cout << std::endl;
+  Results.back()[name] = value;
+  Results.back()[name + "Passed"] = passed;
+  Failed = Failed || !passed;
+}
+
+// the coordinates of row i of the slice, as the marble veins sample them
+void sliceRow(unsigned int i, std::vector<float> &xs, std::vector<float> &ys) {
+  for (unsigned int j = 0; j < SIZE; j++) {
+    xs[j] = 2.0f * (float(j) / SIZE);
+    ys[j] = 2.0f * (float(i) / SIZE);
+  }
+}
+
+// the slice with FractalNoise over the given backend
+double fractalSlice(mgl::NoiseGenerator *generator, float z,
+                    std::vector<float> &slice) {
+  return time(SIZE * SIZE, [&] {
+    std::vector<float> xs(SIZE), ys(SIZE), zs(SIZE, z);
+    for (unsigned int i = 0; i < SIZE; i++) {
+      sliceRow(i, xs, ys);
+      mgl::FractalNoise<8, Marble>::evaluate(generator, xs.data(), ys.data(),
+                                             zs.data(), &slice[i * SIZE],
+                                             SIZE);
+    }
+  });
+}
+
+// the slice with double harmonicNoise, as FractalNoise samples it
+void harmonicSlice(mgl::NoiseGenerator *generator, float z,
+                   std::vector<double> &slice) {
+  for (unsigned int i = 0; i < SIZE; i++) {
+    for (unsigned int j = 0; j < SIZE; j++) {
+      double x = double(j) / SIZE, y = double(i) / SIZE;
+      slice[i * SIZE + j] =
+          mgl::harmonicNoise(generator, 8, 2, 0.6, 2 * x, 2 * y, z);
+    }
+  }
+}
+
+double maxDifference(const std::vector<double> &a,
+                     const std::vector<float> &b) {
+  double maxDiff = 0;
+  for (std::size_t k = 0; k < a.size(); k++) {
+    maxDiff = std::fmax(maxDiff, std::fabs(a[k] - b[k]));
+  }
+  return maxDiff;
+}
+
+// noise in [-1, 1] to bytes, as the textures normalize it
+std::vector<GLubyte> toBytes(const std::vector<float> &noise) {
+  std::vector<GLubyte> bytes(noise.size());
+  for (std::size_t k = 0; k < noise.size(); k++) {
+    bytes[k] = GLubyte(std::lround((noise[k] + 1.0f) / 2.0f * 255.0f));
+  }
+  return bytes;
+}
+
+void writePGM(const std::string &filename, const std::vector<GLubyte> &image) {
+  std::ofstream out(filename, std::ios::binary);
+  out << "P5\n" << SIZE << " " << SIZE << "\n255\n";
+  out.write(reinterpret_cast<const char *>(image.data()), image.size());
+}
+
+void statistics(const std::vector<float> &noise) {
+  double sum = 0, squares = 0;
+  for (float value : noise) {
+    sum += value;
+    squares += double(value) * value;
+  }
+  double mean = sum / noise.size();
+  check("Mean", mean);
+  check("Deviation", std::sqrt(squares / noise.size() - mean * mean));
+}
+
+////////////////////////////////////////////////////////////////////// CASES
+
+void benchmarkNoise() {
+  mgl::PerlinNoiseGenerator perlinNoise;
+  mgl::SimplexNoiseGenerator simplexNoise;
+  const float z = 0.5f;
+  std::vector<float> xs(SIZE), ys(SIZE), zs(SIZE, z), out(SIZE);
+  double sink = 0;
+
+  double ns = time(SIZE * SIZE, [&] {
+    for (unsigned int i = 0; i < SIZE; i++) {
+      for (unsigned int j = 0; j < SIZE; j++) {
+        sink += perlinNoise.noise(8.0 * j / SIZE, 8.0 * i / SIZE, z);
+      }
+    }
+  });
+  report("noise", {{"backend", "perlin"}, {"precision", "double"}},
+         SIZE * SIZE, ns);
+
+  mgl::NoiseGenerator *generators[] = {&perlinNoise, &simplexNoise};
+  for (mgl::NoiseGenerator *generator : generators) {
+    ns = time(SIZE * SIZE, [&] {
+      for (unsigned int i = 0; i < SIZE; i++) {
+        sliceRow(i, xs, ys);
+        for (unsigned int j = 0; j < SIZE; j++) {
+          xs[j] *= 4.0f;
+          ys[j] *= 4.0f;
+        }
+        generator->noise(xs.data(), ys.data(), zs.data(), out.data(), SIZE);
+        sink += out[0];
+      }
+    });
+    report("noise",
+           {{"backend", backendName(generator->getBackend())},
+            {"precision", "float"}},
+           SIZE * SIZE, ns);
+  }
+  // keeps the double loop from being optimized away
+  if (sink == 12345.0) std::cout << sink << std::endl;
+}
+
+void benchmarkGradient() {
+  mgl::PerlinNoiseGenerator perlinNoise;
+  mgl::SimplexNoiseGenerator simplexNoise;
+  const float z = 0.5f, h = 1.0f / 1024;
+  std::vector<float> xs(SIZE), ys(SIZE), zs(SIZE, z), out(SIZE), dxs(SIZE),
+      dys(SIZE), dzs(SIZE), shifted(SIZE);
+  double sink = 0;
+
+  mgl::NoiseGenerator *generators[] = {&perlinNoise, &simplexNoise};
+  for (mgl::NoiseGenerator *generator : generators) {
+    auto row = [&](unsigned int i) {
+      sliceRow(i, xs, ys);
+      for (unsigned int j = 0; j < SIZE; j++) {
+        xs[j] *= 4.0f;
+        ys[j] *= 4.0f;
+      }
+    };
+    double ns = time(SIZE * SIZE, [&] {
+      for (unsigned int i = 0; i < SIZE; i++) {
+        row(i);
+        generator->noiseWithGradient(xs.data(), ys.data(), zs.data(),
+                                     out.data(), dxs.data(), dys.data(),
+                                     dzs.data(), SIZE);
+        sink += out[0] + dxs[0];
+      }
+    });
+    // the value and a forward difference along each axis
+    double differencesNs = time(SIZE * SIZE, [&] {
+      for (unsigned int i = 0; i < SIZE; i++) {
+        row(i);
+        generator->noise(xs.data(), ys.data(), zs.data(), out.data(), SIZE);
+        for (std::vector<float> *axis : {&xs, &ys, &zs}) {
+          for (float &v : *axis) v += h;
+          generator->noise(xs.data(), ys.data(), zs.data(), shifted.data(),
+                           SIZE);
+          for (float &v : *axis) v -= h;
+          sink += shifted[0];
+        }
+      }
+    });
+    report("noiseWithGradient",
+           {{"backend", backendName(generator->getBackend())}}, SIZE * SIZE,
+           ns);
+    check("Speedup", differencesNs / ns);
+  }
+  if (sink == 12345.0) std::cout << sink << std::endl;
+}
+
+void benchmarkHarmonic() {
+  mgl::PerlinNoiseGenerator perlinNoise;
+  mgl::SimplexNoiseGenerator simplexNoise;
+  const float z = 0.5f;
+  std::vector<double> reference(SIZE * SIZE);
+  std::vector<float> batched(SIZE * SIZE), simplex(SIZE * SIZE);
+
+  double ns = time(SIZE * SIZE, [&] {
+    harmonicSlice(&perlinNoise, z, reference);
+  });
+  report("harmonicNoise", {{"backend", "perlin"}}, SIZE * SIZE, ns);
+
+  double fractalNs = fractalSlice(&perlinNoise, z, batched);
+  report("FractalNoise", {{"backend", "perlin"}}, SIZE * SIZE, fractalNs);
+  check("Speedup", ns / fractalNs);
+  check("MaxDifference", maxDifference(reference, batched), 0.0,
+        mgl::PerlinNoiseGenerator::BATCH_TOLERANCE);
+  statistics(batched);
+
+  double simplexNs = fractalSlice(&simplexNoise, z, simplex);
+  report("FractalNoise", {{"backend", "simplex"}}, SIZE * SIZE, simplexNs);
+  check("Speedup", fractalNs / simplexNs);
+  harmonicSlice(&simplexNoise, z, reference);
+  check("MaxDifference", maxDifference(reference, simplex), 0.0,
+        mgl::SimplexNoiseGenerator::BATCH_TOLERANCE);
+  statistics(simplex);
+
+  std::vector<GLubyte> slice = toBytes(batched), decoded(SIZE * SIZE);
+  std::vector<GLubyte> blocks(mgl::bc4Size(SIZE, SIZE));
+  ns = time(SIZE * SIZE, [&] {
+    mgl::encodeBC4(slice.data(), SIZE, SIZE, blocks.data());
+  });
+  mgl::decodeBC4(blocks.data(), SIZE, SIZE, decoded.data());
+  report("BC4 encode", json::object(), SIZE * SIZE, ns);
+  check("PSNR", mgl::psnr(slice.data(), decoded.data(), SIZE * SIZE),
+        mgl::Texture3D::MIN_PSNR, INFINITY);
+
+  writePGM("noise-perlin.pgm", slice);
+  writePGM("noise-simplex.pgm", toBytes(simplex));
+}
+
+// What Texture3D does on its workers, without the uploads: the planes, then
+// the slices in jobs of SLICES_PER_JOB. Made of the graph when there is one.
+double benchmarkVolume(mgl::Texture3D::Type type,
+                       mgl::NoiseGenerator::Backend backend, unsigned int size,
+                       mgl::ThreadPool &pool,
+                       const mgl::TextureGraph *graph = nullptr,
+                       bool gradient = false) {
+  const unsigned int jobs = (size + mgl::Texture3D::SLICES_PER_JOB - 1) /
+                            mgl::Texture3D::SLICES_PER_JOB;
+  std::unique_ptr<mgl::NoiseGenerator> generator =
+      mgl::NoiseGenerator::create(backend, 0);
+  std::vector<GLubyte> volume(size_t(size) * size * size * (gradient ? 4 : 1));
+  const double samples = double(size) * size * size;
+
+  double ns = time(samples, [&] {
+    mgl::Texture3D::SlicePlanes planes;
+    mgl::Texture3D::generatePlanes(type, generator.get(), size, size, 1,
+                                   planes, graph, gradient);
+    pool.parallelFor(jobs, [&](unsigned int job) {
+      unsigned int first = job * mgl::Texture3D::SLICES_PER_JOB;
+      unsigned int last =
+          std::min(first + mgl::Texture3D::SLICES_PER_JOB, size);
+      mgl::Texture3D::generateSlices(type, generator.get(), planes, size,
+                                     first, last, volume.data());
+    });
+  });
+  report(type == mgl::Texture3D::WOOD ? "wood" : "marble",
+         {{"backend", backendName(backend)},
+          {"size", size},
+          {"threads", pool.getThreadCount()},
+          {"recipe", graph ? "graph" : "built-in"},
+          {"gradient", gradient}},
+         samples, ns);
+  return ns;
+}
+
+// BC4 encoding of a volume as the compressed Texture3D uploads it, slice by
+// slice, and the PSNR of level 0 decoded back
+void benchmarkCompression(mgl::Texture3D::Type type,
+                          mgl::NoiseGenerator::Backend backend,
+                          unsigned int size, mgl::ThreadPool &pool) {
+  const unsigned int jobs = (size + mgl::Texture3D::SLICES_PER_JOB - 1) /
+                            mgl::Texture3D::SLICES_PER_JOB;
+  const std::size_t sliceSize = std::size_t(size) * size;
+  const std::size_t layerSize = mgl::bc4Size(size, size);
+  std::unique_ptr<mgl::NoiseGenerator> generator =
+      mgl::NoiseGenerator::create(backend, 0);
+  std::vector<GLubyte> volume(sliceSize * size), decoded(sliceSize * size);
+  mgl::Texture3D::SlicePlanes planes;
+  mgl::Texture3D::generatePlanes(type, generator.get(), size, size, 1, planes);
+  pool.parallelFor(jobs, [&](unsigned int job) {
+    unsigned int first = job * mgl::Texture3D::SLICES_PER_JOB;
+    unsigned int last = std::min(first + mgl::Texture3D::SLICES_PER_JOB, size);
+    mgl::Texture3D::generateSlices(type, generator.get(), planes, size, first,
+                                   last, volume.data());
+  });
+  std::vector<std::vector<GLubyte>> levels(
+      1, std::vector<GLubyte>(layerSize * size));
+
+  double ns = time(double(sliceSize) * size, [&] {
+    pool.parallelFor(size, [&](unsigned int d) {
+      mgl::Texture3D::compressSlice(&volume[sliceSize * d], size, size, d,
+                                    levels);
+    });
+  });
+  report("bc4",
+         {{"material", type == mgl::Texture3D::WOOD ? "wood" : "marble"},
+          {"backend", backendName(backend)},
+          {"size", size},
+          {"threads", pool.getThreadCount()}},
+         double(sliceSize) * size, ns);
+  for (unsigned int d = 0; d < size; d++) {
+    mgl::decodeBC4(&levels[0][layerSize * d], size, size,
+                   &decoded[sliceSize * d]);
+  }
+  double quality = mgl::psnr(volume.data(), decoded.data(), volume.size());
+  if (size >= mgl::Texture3D::MIN_PSNR_SIZE) {
+    check("PSNR", quality, mgl::Texture3D::MIN_PSNR, INFINITY);
+  } else {
+    check("PSNR", quality);
+  }
+}
+
+// As benchmarkVolume for wood and marble in the channels of one volume
+double benchmarkPackedVolume(mgl::NoiseGenerator::Backend backend,
+                             unsigned int size, mgl::ThreadPool &pool) {
+  const unsigned int jobs = (size + mgl::Texture3D::SLICES_PER_JOB - 1) /
+                            mgl::Texture3D::SLICES_PER_JOB;
+  const std::vector<mgl::Texture3D::Type> types = {mgl::Texture3D::WOOD,
+                                                   mgl::Texture3D::MARBLE};
+  std::unique_ptr<mgl::NoiseGenerator> generator =
+      mgl::NoiseGenerator::create(backend, 0);
+  std::vector<GLubyte> volume(size_t(size) * size * size * types.size());
+  const double samples = double(size) * size * size;
+
+  double ns = time(samples, [&] {
+    std::vector<mgl::Texture3D::SlicePlanes> planes(types.size());
+    for (std::size_t c = 0; c < types.size(); c++) {
+      mgl::Texture3D::generatePlanes(types[c], generator.get(), size, size, 1,
+                                     planes[c]);
+    }
+    pool.parallelFor(jobs, [&](unsigned int job) {
+      unsigned int first = job * mgl::Texture3D::SLICES_PER_JOB;
+      unsigned int last =
+          std::min(first + mgl::Texture3D::SLICES_PER_JOB, size);
+      mgl::Texture3D::generatePackedSlices(types, generator.get(), planes,
+                                           size, first, last, volume.data());
+    });
+  });
+  report("packed",
+         {{"backend", backendName(backend)},
+          {"size", size},
+          {"threads", pool.getThreadCount()}},
+         samples, ns);
+  return ns;
+}
+
+// What the slice jobs of an uncompressed volume and the mipmaps job after them
+// do, per texel of level 0. The content does not change the cost of the filter.
+void benchmarkMipmaps(unsigned int size, mgl::ThreadPool &pool) {
+  const unsigned int slices = mgl::Texture3D::SLICES_PER_JOB;
+  const unsigned int jobs = (size + slices - 1) / slices;
+  std::vector<std::vector<GLubyte>> levels;
+  for (unsigned int side = size;; side = std::max(1u, side / 2)) {
+    levels.emplace_back(size_t(side) * side * side);
+    if (side == 1) break;
+  }
+  for (std::size_t i = 0; i < levels[0].size(); i++) {
+    levels[0][i] = GLubyte(i * 2654435761u >> 24);
+  }
+  const unsigned int chunkLevels =
+      size % slices ? 0 : std::min(3u, unsigned(levels.size()) - 1);
+  auto side = [size](unsigned int l) { return std::max(1u, size >> l); };
+
+  double ns = time(double(levels[0].size()), [&] {
+    pool.parallelFor(jobs, [&](unsigned int job) {
+      for (unsigned int l = 1; l <= chunkLevels; l++) {
+        mgl::Texture3D::downsampleLevel(
+            levels[l - 1].data(), side(l - 1), side(l - 1), side(l - 1),
+            (job * slices) >> l, ((job + 1) * slices) >> l, levels[l].data());
+      }
+    });
+    for (unsigned int l = chunkLevels + 1; l < levels.size(); l++) {
+      mgl::Texture3D::downsampleLevel(levels[l - 1].data(), side(l - 1),
+                                      side(l - 1), side(l - 1), 0, side(l),
+                                      levels[l].data());
+    }
+  });
+  report("mipmaps", {{"size", size}, {"threads", pool.getThreadCount()}},
+         double(levels[0].size()), ns);
+}
+
+// The cube fills the volume, its faces are its charts
+void benchmarkAtlas(mgl::NoiseGenerator::Backend backend, unsigned int size) {
+  const unsigned int atlasSize = 512;
+  const glm::vec3 corners[8] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0},
+                                {0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1}};
+  const unsigned int faces[12][3] = {{0, 2, 1}, {1, 2, 3}, {4, 5, 6},
+                                     {5, 7, 6}, {0, 1, 4}, {1, 5, 4},
+                                     {2, 6, 3}, {3, 6, 7}, {0, 4, 2},
+                                     {2, 4, 6}, {1, 3, 5}, {3, 7, 5}};
+  std::vector<glm::vec3> triangles;
+  for (auto &face : faces) {
+    for (unsigned int corner : face) triangles.push_back(corners[corner]);
+  }
+  const std::vector<glm::vec2> texcoords =
+      mgl::Atlas::generate(triangles, atlasSize);
+  std::unique_ptr<mgl::NoiseGenerator> generator =
+      mgl::NoiseGenerator::create(backend, 0);
+  std::vector<GLubyte> image, covered;
+  mgl::Texture3D::SlicePlanes planes;
+  mgl::Texture3D::generatePlanes(mgl::Texture3D::MARBLE, generator.get(), size,
+                                 size, 1, planes);
+  mgl::AtlasTexture::bakeSurface(triangles, texcoords, atlasSize,
+                                 mgl::Texture3D::MARBLE, generator.get(),
+                                 planes, size, image, covered);
+  const double samples = double(
+      std::count_if(covered.begin(), covered.end(), [](GLubyte c) { return c; }));
+
+  double ns = time(samples, [&] {
+    mgl::Texture3D::generatePlanes(mgl::Texture3D::MARBLE, generator.get(),
+                                   size, size, 1, planes);
+    mgl::AtlasTexture::bakeSurface(triangles, texcoords, atlasSize,
+                                   mgl::Texture3D::MARBLE, generator.get(),
+                                   planes, size, image, covered);
+  });
+  report("atlas",
+         {{"backend", backendName(backend)},
+          {"size", size},
+          {"atlas", atlasSize},
+          {"threads", mgl::ThreadPool::getInstance().getThreadCount()}},
+         samples, ns);
+  // both with their mipmaps
+  check("Memory", (double(image.size()) * 4 / 3) /
+                      (double(size) * size * size * 8 / 7));
+}
+
+std::vector<unsigned int> parseList(const char *list) {
+  std::vector<unsigned int> values;
+  std::stringstream stream(list);
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    values.push_back(static_cast<unsigned int>(std::stoul(value)));
+  }
+  return values;
+}
+
+Options parseOptions(int argc, char **argv) {
+  Options options;
+  unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+  options.threads = {1};
+  if (hardware > 1) options.threads.push_back(hardware);
+
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (!std::strcmp(argv[i], "--json") && hasValue) {
+      options.jsonFile = argv[++i];
+    } else if (!std::strcmp(argv[i], "--sizes") && hasValue) {
+      options.sizes = parseList(argv[++i]);
+    } else if (!std::strcmp(argv[i], "--threads") && hasValue) {
+      options.threads = parseList(argv[++i]);
+    } else if (!std::strcmp(argv[i], "--materials") && hasValue) {
+      options.materialsFile = argv[++i];
+    } else if (!std::strcmp(argv[i], "--check")) {
+      options.checkOnly = true;
+    } else if (!std::strcmp(argv[i], "--noise") && hasValue) {
+      std::string list = argv[++i];
+      options.noise.clear();
+      if (list.find("perlin") != std::string::npos)
+        options.noise.push_back(mgl::NoiseGenerator::PERLIN);
+      if (list.find("simplex") != std::string::npos)
+        options.noise.push_back(mgl::NoiseGenerator::SIMPLEX);
+    } else {
+      std::cerr << "usage: " << argv[0]
+                << " [--json FILE] [--sizes 64,128,256] [--threads 1,4]"
+                   " [--noise perlin,simplex] [--materials FILE] [--check]"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options options = parseOptions(argc, argv);
+  std::map<std::string, std::shared_ptr<const mgl::TextureGraph>> materials =
+      mgl::TextureGraph::load(options.materialsFile);
+
+  Once = options.checkOnly;
+  if (!options.checkOnly) {
+    benchmarkNoise();
+    benchmarkGradient();
+  }
+  benchmarkHarmonic();
+  for (unsigned int threads : options.threads) {
+    mgl::ThreadPool pool(threads);
+    for (unsigned int size : options.sizes) {
+      for (mgl::NoiseGenerator::Backend backend : options.noise) {
+        for (mgl::Texture3D::Type type :
+             {mgl::Texture3D::WOOD, mgl::Texture3D::MARBLE}) {
+          benchmarkCompression(type, backend, size, pool);
+        }
+      }
+      if (options.checkOnly) continue;
+      for (mgl::NoiseGenerator::Backend backend : options.noise) {
+        double separateNs = 0;
+        for (mgl::Texture3D::Type type :
+             {mgl::Texture3D::WOOD, mgl::Texture3D::MARBLE}) {
+          double ns = benchmarkVolume(type, backend, size, pool);
+          separateNs += ns;
+          check("Cost", benchmarkVolume(type, backend, size, pool, nullptr,
+                                        true) /
+                            ns);
+          auto graph =
+              materials.find(type == mgl::Texture3D::WOOD ? "wood" : "marble");
+          if (graph != materials.end()) {
+            check("Speedup", ns / benchmarkVolume(type, backend, size, pool,
+                                                  graph->second.get()));
+          }
+        }
+        check("Overhead",
+              benchmarkPackedVolume(backend, size, pool) / separateNs);
+      }
+      benchmarkMipmaps(size, pool);
+    }
+  }
+  for (unsigned int size : options.sizes) {
+    for (mgl::NoiseGenerator::Backend backend : options.noise) {
+      if (!options.checkOnly) benchmarkAtlas(backend, size);
+    }
+  }
+
+  if (!options.jsonFile.empty()) {
+    json output;
+    output["HardwareThreads"] = std::thread::hardware_concurrency();
+    output["SimdLevel"] = mgl::NoiseGenerator::detectSimdLevel();
+    output["Results"] = Results;
+    if (options.jsonFile == "-") {
+      std::cout << std::setw(4) << output << std::endl;
+    } else {
+      std::ofstream out(options.jsonFile);
+      out << std::setw(4) << output << std::endl;
+    }
+  }
+  if (Failed) {
+    std::cerr << "Some checks failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return 0;
+}
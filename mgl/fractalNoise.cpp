@@ -0,0 +1,97 @@
+#include "fractalNoise.hpp"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+namespace mgl {
+
+	double harmonicNoise(NoiseGenerator* generator, int numberOctaves, float b, float a, double x, double y, double z) {
+		double endNoise = 0;
+		float totalAmplitude = 0.0;
+
+		for (int i = 0; i < numberOctaves; ++i) {
+			float amplitude = glm::pow((float)a, (float)i);// 1 / 2 * i;
+			totalAmplitude += amplitude;
+		}
+
+		for (int i = 0; i < numberOctaves; ++i) {
+			float frequency = glm::pow((float)b, (float)i); //2 * i;
+			float amplitude = glm::pow((float)a, (float)i);// 1 / 2 * i; //0.7
+
+			endNoise += generator->noise(frequency * x, frequency * y, z) * amplitude / totalAmplitude;
+		}
+
+		return endNoise;
+	}
+
+	// The octave sum of fractalNoise with the octave count fixed, so that like FractalNoise
+	// its octave loop is unrolled, over the tables computed at run time
+	template <unsigned int... I>
+	static void fractalOctaves(NoiseGenerator* generator, const float* frequencies, const float* weights, const float* xs, const float* ys, const float* zs, float* out, std::size_t n, const NoiseGenerator::Period* period, std::integer_sequence<unsigned int, I...>) {
+		const std::size_t BLOCK = 64;
+		float octaveXs[BLOCK], octaveYs[BLOCK], value[BLOCK], sum[BLOCK];
+		auto octave = [&](unsigned int i, std::size_t first, std::size_t count) {
+			const float frequency = frequencies[i], weight = weights[i];
+			for (std::size_t k = 0; k < count; ++k) {
+				octaveXs[k] = frequency * xs[first + k];
+				octaveYs[k] = frequency * ys[first + k];
+			}
+			NoiseGenerator::Period periodOfOctave;
+			if (const NoiseGenerator::Period* octave = octavePeriod(period, frequency, periodOfOctave)) {
+				generator->noise(octaveXs, octaveYs, zs + first, value, count, *octave);
+			}
+			else {
+				generator->noise(octaveXs, octaveYs, zs + first, value, count);
+			}
+			for (std::size_t k = 0; k < count; ++k) {
+				sum[k] += value[k] * weight;
+			}
+		};
+		for (std::size_t first = 0; first < n; first += BLOCK) {
+			std::size_t count = std::min(n - first, BLOCK);
+			std::fill(sum, sum + count, 0.0f);
+			(octave(I, first, count), ...);
+			std::copy(sum, sum + count, out + first);
+		}
+	}
+
+	using FractalOctaves = void (*)(NoiseGenerator*, const float*, const float*, const float*, const float*, const float*, float*, std::size_t, const NoiseGenerator::Period*);
+
+	template <unsigned int Octaves>
+	static void fractalOctaves(NoiseGenerator* generator, const float* frequencies, const float* weights, const float* xs, const float* ys, const float* zs, float* out, std::size_t n, const NoiseGenerator::Period* period) {
+		fractalOctaves(generator, frequencies, weights, xs, ys, zs, out, n, period, std::make_integer_sequence<unsigned int, Octaves>());
+	}
+
+	// FRACTAL_OCTAVES[i] sums i + 1 octaves
+	template <unsigned int... I>
+	static constexpr std::array<FractalOctaves, sizeof...(I)> fractalOctavesTable(std::integer_sequence<unsigned int, I...>) {
+		return { &fractalOctaves<I + 1>... };
+	}
+	static constexpr std::array<FractalOctaves, MAX_OCTAVES> FRACTAL_OCTAVES = fractalOctavesTable(std::make_integer_sequence<unsigned int, MAX_OCTAVES>());
+
+	void fractalNoise(NoiseGenerator* generator, unsigned int numberOctaves, float b, float a, const float* xs, const float* ys, const float* zs, float* out, std::size_t n, const NoiseGenerator::Period* period) {
+		// the tables of FractalNoise, computed the same way
+		float frequencies[MAX_OCTAVES], weights[MAX_OCTAVES];
+		numberOctaves = std::min(numberOctaves, MAX_OCTAVES);
+		if (numberOctaves == 0) {
+			std::fill(out, out + n, 0.0f);
+			return;
+		}
+		float frequency = 1.0f, amplitude = 1.0f, totalAmplitude = 0.0f;
+		for (unsigned int i = 0; i < numberOctaves; ++i) {
+			frequencies[i] = frequency;
+			weights[i] = amplitude;
+			totalAmplitude += amplitude;
+			frequency *= b;
+			amplitude *= a;
+		}
+		for (unsigned int i = 0; i < numberOctaves; ++i) {
+			weights[i] /= totalAmplitude;
+		}
+		FRACTAL_OCTAVES[numberOctaves - 1](generator, frequencies, weights, xs, ys, zs, out, n, period);
+	}
+
+}
@@ -0,0 +1,244 @@
+#ifndef MGL_FRACTAL_NOISE_HPP
+#define MGL_FRACTAL_NOISE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include "noiseGenerator.hpp"
+
+namespace mgl {
+
+	// Reference harmonic noise, one sample at a time in double precision.
+	// Octave i samples b^i * (x, y) at an unscaled z and is weighted by a^i / sum(a^k).
+	double harmonicNoise(NoiseGenerator* generator, int numberOctaves, float b, float a, double x, double y, double z);
+
+	// The period of an octave at a whole frequency, period * frequency along x and y, in
+	// octave. Computed in 64 bits, a product that does not fit an int is no period the
+	// generators can take: the octave is then sampled without one (null) and does not tile.
+	// TextureGraph::parse bounds its octaves so that this does not happen.
+	inline const NoiseGenerator::Period* octavePeriod(const NoiseGenerator::Period* period, float frequency, NoiseGenerator::Period& octave) {
+		const std::int64_t LIMIT = std::numeric_limits<int>::max();
+		if (!period || !(frequency >= 1.0f && frequency <= (float)LIMIT)) return nullptr;
+		const std::int64_t x = (std::int64_t)period->x * (std::int64_t)frequency;
+		const std::int64_t y = (std::int64_t)period->y * (std::int64_t)frequency;
+		if (x > LIMIT || y > LIMIT) return nullptr;
+		octave.x = (int)x;
+		octave.y = (int)y;
+		octave.z = period->z;
+		return &octave;
+	}
+
+	// The same octave sum with the octave count fixed at compile time and the
+	// lacunarity (b) and gain (a) taken from Parameters:
+	//
+	//     struct Marble { static constexpr float lacunarity = 2.0f, gain = 0.6f; };
+	//     FractalNoise<8, Marble>::evaluate(generator, xs, ys, zs, out, n);
+	//
+	// Frequencies and normalized weights are constexpr tables and the octave loop
+	// is unrolled. A row is processed in blocks small enough to stay in L1.
+	template <unsigned int Octaves, typename Parameters>
+	class FractalNoise {
+	public:
+		static constexpr unsigned int BLOCK = 64;
+
+		static constexpr std::array<float, Octaves> frequencies() {
+			std::array<float, Octaves> table = {};
+			float frequency = 1.0f;
+			for (unsigned int i = 0; i < Octaves; ++i) {
+				table[i] = frequency;
+				frequency *= Parameters::lacunarity;
+			}
+			return table;
+		}
+
+		static constexpr std::array<float, Octaves> weights() {
+			std::array<float, Octaves> table = {};
+			float amplitude = 1.0f;
+			float totalAmplitude = 0.0f;
+			for (unsigned int i = 0; i < Octaves; ++i) {
+				table[i] = amplitude;
+				totalAmplitude += amplitude;
+				amplitude *= Parameters::gain;
+			}
+			for (unsigned int i = 0; i < Octaves; ++i) {
+				table[i] /= totalAmplitude;
+			}
+			return table;
+		}
+
+		static constexpr std::array<float, Octaves> FREQUENCIES = frequencies();
+		static constexpr std::array<float, Octaves> WEIGHTS = weights();
+
+		// out[k] = harmonic noise at (xs[k], ys[k], zs[k]) for the whole row
+		static void evaluate(NoiseGenerator* generator, const float* xs, const float* ys, const float* zs, float* out, std::size_t n) {
+			evaluateRow(generator, xs, ys, zs, out, n, nullptr);
+		}
+
+		// Periodic octave sum, the base octave repeats every period cells. Octave i
+		// repeats every FREQUENCIES[i] * period cells in x and y, z is not scaled by
+		// the octaves so its period is the same for all of them.
+		static void evaluate(NoiseGenerator* generator, const float* xs, const float* ys, const float* zs, float* out, std::size_t n, const NoiseGenerator::Period& period) {
+			static_assert(Parameters::lacunarity == (float)(int)Parameters::lacunarity, "periodic octaves need a whole lacunarity");
+			evaluateRow(generator, xs, ys, zs, out, n, &period);
+		}
+
+		// evaluate with the gradient of the sum in dxs, dys, dzs, from NoiseGenerator::noiseWithGradient.
+		// Octave i adds its gradient times WEIGHTS[i], and times FREQUENCIES[i] along x and y.
+		static void evaluateWithGradient(NoiseGenerator* generator, const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n) {
+			evaluateRowWithGradient(generator, xs, ys, zs, out, dxs, dys, dzs, n, nullptr);
+		}
+
+		static void evaluateWithGradient(NoiseGenerator* generator, const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n, const NoiseGenerator::Period& period) {
+			static_assert(Parameters::lacunarity == (float)(int)Parameters::lacunarity, "periodic octaves need a whole lacunarity");
+			evaluateRowWithGradient(generator, xs, ys, zs, out, dxs, dys, dzs, n, &period);
+		}
+
+	private:
+		static void evaluateRow(NoiseGenerator* generator, const float* xs, const float* ys, const float* zs, float* out, std::size_t n, const NoiseGenerator::Period* period) {
+			for (std::size_t first = 0; first < n; first += BLOCK) {
+				std::size_t count = n - first < BLOCK ? n - first : BLOCK;
+				evaluateBlock(generator, xs + first, ys + first, zs + first, out + first, count, period, std::make_integer_sequence<unsigned int, Octaves>());
+			}
+		}
+
+		template <unsigned int... I>
+		static void evaluateBlock(NoiseGenerator* generator, const float* xs, const float* ys, const float* zs, float* out, std::size_t n, const NoiseGenerator::Period* period, std::integer_sequence<unsigned int, I...>) {
+			float sum[BLOCK] = {};
+			(octave<I>(generator, xs, ys, zs, sum, n, period), ...);
+			for (std::size_t k = 0; k < n; ++k) {
+				out[k] = sum[k];
+			}
+		}
+
+		template <unsigned int I>
+		static void octave(NoiseGenerator* generator, const float* xs, const float* ys, const float* zs, float* sum, std::size_t n, const NoiseGenerator::Period* period) {
+			constexpr float frequency = FREQUENCIES[I];
+			constexpr float weight = WEIGHTS[I];
+			float octaveXs[BLOCK], octaveYs[BLOCK], value[BLOCK];
+			for (std::size_t k = 0; k < n; ++k) {
+				octaveXs[k] = frequency * xs[k];
+				octaveYs[k] = frequency * ys[k];
+			}
+			NoiseGenerator::Period periodOfOctave;
+			if (const NoiseGenerator::Period* octave = octavePeriod(period, frequency, periodOfOctave)) {
+				generator->noise(octaveXs, octaveYs, zs, value, n, *octave);
+			}
+			else {
+				generator->noise(octaveXs, octaveYs, zs, value, n);
+			}
+			for (std::size_t k = 0; k < n; ++k) {
+				sum[k] += value[k] * weight;
+			}
+		}
+
+		static void evaluateRowWithGradient(NoiseGenerator* generator, const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n, const NoiseGenerator::Period* period) {
+			for (std::size_t first = 0; first < n; first += BLOCK) {
+				std::size_t count = n - first < BLOCK ? n - first : BLOCK;
+				evaluateBlockWithGradient(generator, xs + first, ys + first, zs + first, out + first, dxs + first, dys + first, dzs + first, count, period, std::make_integer_sequence<unsigned int, Octaves>());
+			}
+		}
+
+		template <unsigned int... I>
+		static void evaluateBlockWithGradient(NoiseGenerator* generator, const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n, const NoiseGenerator::Period* period, std::integer_sequence<unsigned int, I...>) {
+			float sum[BLOCK] = {}, dxSum[BLOCK] = {}, dySum[BLOCK] = {}, dzSum[BLOCK] = {};
+			(octaveWithGradient<I>(generator, xs, ys, zs, sum, dxSum, dySum, dzSum, n, period), ...);
+			for (std::size_t k = 0; k < n; ++k) {
+				out[k] = sum[k];
+				dxs[k] = dxSum[k];
+				dys[k] = dySum[k];
+				dzs[k] = dzSum[k];
+			}
+		}
+
+		template <unsigned int I>
+		static void octaveWithGradient(NoiseGenerator* generator, const float* xs, const float* ys, const float* zs, float* sum, float* dxSum, float* dySum, float* dzSum, std::size_t n, const NoiseGenerator::Period* period) {
+			constexpr float frequency = FREQUENCIES[I];
+			constexpr float weight = WEIGHTS[I];
+			float octaveXs[BLOCK], octaveYs[BLOCK], value[BLOCK], dx[BLOCK], dy[BLOCK], dz[BLOCK];
+			for (std::size_t k = 0; k < n; ++k) {
+				octaveXs[k] = frequency * xs[k];
+				octaveYs[k] = frequency * ys[k];
+			}
+			NoiseGenerator::Period periodOfOctave;
+			if (const NoiseGenerator::Period* octave = octavePeriod(period, frequency, periodOfOctave)) {
+				generator->noiseWithGradient(octaveXs, octaveYs, zs, value, dx, dy, dz, n, *octave);
+			}
+			else {
+				generator->noiseWithGradient(octaveXs, octaveYs, zs, value, dx, dy, dz, n);
+			}
+			for (std::size_t k = 0; k < n; ++k) {
+				sum[k] += value[k] * weight;
+				dxSum[k] += dx[k] * (weight * frequency);
+				dySum[k] += dy[k] * (weight * frequency);
+				dzSum[k] += dz[k] * weight;
+			}
+		}
+	};
+
+	// The same octave sum with the octave count, lacunarity (b) and gain (a) chosen at run
+	// time, for recipes that are data (see TextureGraph). The results are those of
+	// FractalNoise with the same parameters. With a period it is the periodic octave sum,
+	// the lacunarity must then be whole. At most MAX_OCTAVES octaves are summed, each count
+	// has its own instance with the octave loop unrolled as in FractalNoise.
+	const unsigned int MAX_OCTAVES = 32;
+	void fractalNoise(NoiseGenerator* generator, unsigned int numberOctaves, float b, float a, const float* xs, const float* ys, const float* zs, float* out, std::size_t n, const NoiseGenerator::Period* period = nullptr);
+
+	// Whole periods of a term with the given scale over a tile repeated repeat times,
+	// at least one so it still varies, a scale of 0 stays 0
+	inline int tilePeriods(float scale, unsigned int repeat) {
+		return scale == 0.0f ? 0 : std::max(1, (int)std::lround(scale / repeat));
+	}
+
+	// A noise term sampled at (x, y, z) * (j / width, i / height, level / depth). In a
+	// tiling volume the scales are whole periods and the noise wraps with the volume.
+	// A z scale of 0 is for terms sampled at a fixed z.
+	struct NoiseTerm {
+		float x, y, z;
+		bool periodic;
+		NoiseGenerator::Period period;
+
+		NoiseTerm(float scaleX, float scaleY, float scaleZ, unsigned int repeat) : periodic(repeat > 1) {
+			x = periodic ? (float)tilePeriods(scaleX, repeat) : scaleX;
+			y = periodic ? (float)tilePeriods(scaleY, repeat) : scaleY;
+			z = periodic ? (float)tilePeriods(scaleZ, repeat) : scaleZ;
+			period.x = (int)x;
+			period.y = (int)y;
+			if (scaleZ != 0.0f) period.z = (int)z;
+		}
+
+		void noise(NoiseGenerator* generator, const float* xs, const float* ys, const float* zs, float* out, std::size_t n) const {
+			if (periodic) generator->noise(xs, ys, zs, out, n, period);
+			else generator->noise(xs, ys, zs, out, n);
+		}
+
+		template <unsigned int Octaves, typename Parameters>
+		void fractal(NoiseGenerator* generator, const float* xs, const float* ys, const float* zs, float* out, std::size_t n) const {
+			if (periodic) FractalNoise<Octaves, Parameters>::evaluate(generator, xs, ys, zs, out, n, period);
+			else FractalNoise<Octaves, Parameters>::evaluate(generator, xs, ys, zs, out, n);
+		}
+
+		// With the gradient along the noise coordinates, times x, y, z it is along j / width, i / height, level / depth
+		void noiseWithGradient(NoiseGenerator* generator, const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n) const {
+			if (periodic) generator->noiseWithGradient(xs, ys, zs, out, dxs, dys, dzs, n, period);
+			else generator->noiseWithGradient(xs, ys, zs, out, dxs, dys, dzs, n);
+		}
+
+		template <unsigned int Octaves, typename Parameters>
+		void fractalWithGradient(NoiseGenerator* generator, const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n) const {
+			if (periodic) FractalNoise<Octaves, Parameters>::evaluateWithGradient(generator, xs, ys, zs, out, dxs, dys, dzs, n, period);
+			else FractalNoise<Octaves, Parameters>::evaluateWithGradient(generator, xs, ys, zs, out, dxs, dys, dzs, n);
+		}
+
+		void fractal(NoiseGenerator* generator, unsigned int octaves, float lacunarity, float gain, const float* xs, const float* ys, const float* zs, float* out, std::size_t n) const {
+			fractalNoise(generator, octaves, lacunarity, gain, xs, ys, zs, out, n, periodic ? &period : nullptr);
+		}
+	};
+
+}
+
+#endif // !MGL_FRACTAL_NOISE_HPP
@@ -17,6 +17,10 @@
 #include "./mglConventions.hpp"
 #include "./mglError.hpp"
 #include "./mglMesh.hpp"
+#include "./mglMeshCache.hpp"
+#include "./mglMeshOptimizer.hpp"
+#include "./mglLoader.hpp"
+#include "./mglVertexFormat.hpp"
 #include "./mglScenegraph.hpp"
 #include "./mglShader.hpp"
 #include "./mglOrbitCamera.hpp"
@@ -26,5 +30,9 @@
 #include "./mglSampler.hpp"
 #include "./mglManager.hpp"
 #include "./mglSillouette.hpp"
+#include "./mglThreadPool.hpp"
+#include "./mglVolumeCache.hpp"
+#include "./mglCompression.hpp"
+#include "./mglTextureGraph.hpp"
 
 #endif /* MGL_HPP */
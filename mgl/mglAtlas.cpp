@@ -0,0 +1,210 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Texture atlases laying the surface of a mesh out in a 2D texture
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglAtlas.hpp"
+
+#include <map>
+#include <numeric>
+#include <tuple>
+#include <utility>
+
+namespace mgl {
+
+////////////////////////////////////////////////////////////////////////// Atlas
+
+bool Atlas::isValid(const std::vector<glm::vec2> &texcoords,
+                    unsigned int size) {
+  for (const glm::vec2 &texcoord : texcoords) {
+    // written so that NaN fails too
+    if (!(texcoord.x >= 0.0f && texcoord.x <= 1.0f && texcoord.y >= 0.0f &&
+          texcoord.y <= 1.0f)) {
+      return false;
+    }
+  }
+  // texels on an edge shared by two triangles are not an overlap
+  std::vector<GLubyte> covered(size_t(size) * size, 0);
+  bool overlaps = false;
+  for (size_t t = 0; t + 2 < texcoords.size() && !overlaps; t += 3) {
+    const glm::vec2 triangle[3] = {texcoords[t], texcoords[t + 1],
+                                   texcoords[t + 2]};
+    rasterize(triangle, size, -1.0e-3f, [&](int x, int y, const glm::vec3 &) {
+      GLubyte &texel = covered[size_t(y) * size + x];
+      overlaps = overlaps || texel;
+      texel = 1;
+    });
+  }
+  return !overlaps;
+}
+
+static unsigned int findChart(std::vector<unsigned int> &parents,
+                              unsigned int t) {
+  while (parents[t] != t) {
+    parents[t] = parents[parents[t]];
+    t = parents[t];
+  }
+  return t;
+}
+
+std::vector<glm::vec2> Atlas::generate(const std::vector<glm::vec3> &positions,
+                                       unsigned int size) {
+  const unsigned int triangles = (unsigned int)(positions.size() / 3);
+
+  // +x, -x, +y, -y, +z, -z: the axis of the largest component of the normal
+  std::vector<unsigned int> axes(triangles);
+  for (unsigned int t = 0; t < triangles; t++) {
+    const glm::vec3 normal =
+        glm::cross(positions[3 * t + 1] - positions[3 * t],
+                   positions[3 * t + 2] - positions[3 * t]);
+    const glm::vec3 magnitude = glm::abs(normal);
+    const int a = magnitude.x >= magnitude.y && magnitude.x >= magnitude.z ? 0
+                  : magnitude.y >= magnitude.z                             ? 1
+                                                                           : 2;
+    axes[t] = 2 * a + (normal[a] < 0.0f);
+  }
+
+  // the corners of a triangle list are not shared, edges are matched by the
+  // positions of their vertices
+  std::map<std::tuple<float, float, float>, unsigned int> vertices;
+  std::vector<unsigned int> ids(positions.size());
+  for (size_t c = 0; c < positions.size(); c++) {
+    const glm::vec3 &p = positions[c];
+    ids[c] = vertices.emplace(std::make_tuple(p.x, p.y, p.z),
+                              (unsigned int)vertices.size())
+                 .first->second;
+  }
+  std::vector<unsigned int> parents(triangles);
+  std::iota(parents.begin(), parents.end(), 0u);
+  std::map<std::pair<unsigned int, unsigned int>, std::vector<unsigned int>>
+      edges;
+  for (unsigned int t = 0; t < triangles; t++) {
+    for (int e = 0; e < 3; e++) {
+      const unsigned int a = ids[3 * t + e], b = ids[3 * t + (e + 1) % 3];
+      std::vector<unsigned int> &neighbours =
+          edges[std::make_pair(std::min(a, b), std::max(a, b))];
+      for (unsigned int n : neighbours) {
+        if (axes[n] == axes[t]) {
+          parents[findChart(parents, n)] = findChart(parents, t);
+        }
+      }
+      neighbours.push_back(t);
+    }
+  }
+
+  // each chart projected on the plane of its axis, in model units
+  struct Chart {
+    unsigned int axis;
+    glm::vec2 low = glm::vec2(INFINITY), high = glm::vec2(-INFINITY);
+    glm::vec2 origin;
+  };
+  std::vector<Chart> charts;
+  std::vector<unsigned int> chartOf(triangles);
+  std::map<unsigned int, unsigned int> roots;
+  auto project = [&](unsigned int axis, const glm::vec3 &p) {
+    const unsigned int a = axis / 2;
+    return glm::vec2(p[(a + 1) % 3], p[(a + 2) % 3]);
+  };
+  for (unsigned int t = 0; t < triangles; t++) {
+    auto root = roots.emplace(findChart(parents, t),
+                              (unsigned int)charts.size());
+    if (root.second) {
+      charts.push_back(Chart());
+      charts.back().axis = axes[t];
+    }
+    Chart &chart = charts[root.first->second];
+    chartOf[t] = root.first->second;
+    for (int c = 0; c < 3; c++) {
+      const glm::vec2 p = project(chart.axis, positions[3 * t + c]);
+      chart.low = glm::min(chart.low, p);
+      chart.high = glm::max(chart.high, p);
+    }
+  }
+
+  // rows of charts, tallest first. A chart takes its extent plus a texel for
+  // the texels its edges cross plus PADDING, half of it on each side
+  std::vector<unsigned int> order(charts.size());
+  std::iota(order.begin(), order.end(), 0u);
+  std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+    return charts[a].high.y - charts[a].low.y >
+           charts[b].high.y - charts[b].low.y;
+  });
+  auto pack = [&](float scale) {
+    float x = 0.0f, y = 0.0f, rowHeight = 0.0f;
+    for (unsigned int c : order) {
+      const glm::vec2 cell =
+          glm::ceil((charts[c].high - charts[c].low) * scale) +
+          float(1 + PADDING);
+      if (x > 0.0f && x + cell.x > size) {
+        x = 0.0f;
+        y += rowHeight;
+        rowHeight = 0.0f;
+      }
+      if (x + cell.x > size || y + cell.y > size) return false;
+      charts[c].origin = glm::vec2(x, y) + 0.5f * float(1 + PADDING);
+      x += cell.x;
+      rowHeight = std::max(rowHeight, cell.y);
+    }
+    return true;
+  };
+  // no chart can be larger than the texture, the largest scale that packs
+  // is found by bisection
+  float largest = 0.0f;
+  for (const Chart &chart : charts) {
+    const glm::vec2 extent = chart.high - chart.low;
+    largest = std::max(largest, std::max(extent.x, extent.y));
+  }
+  float fits = 0.0f;
+  float scale = float(size - 1 - PADDING) / std::max(largest, 1.0e-6f);
+  if (!pack(scale)) {
+    for (int i = 0; i < 32; i++) {
+      const float middle = 0.5f * (fits + scale);
+      (pack(middle) ? fits : scale) = middle;
+    }
+    scale = fits;
+    pack(scale);
+  }
+
+  std::vector<glm::vec2> texcoords(positions.size());
+  for (unsigned int t = 0; t < triangles; t++) {
+    const Chart &chart = charts[chartOf[t]];
+    for (int c = 0; c < 3; c++) {
+      const glm::vec2 p = project(chart.axis, positions[3 * t + c]);
+      texcoords[3 * t + c] =
+          (chart.origin + (p - chart.low) * scale) / float(size);
+    }
+  }
+  return texcoords;
+}
+
+void Atlas::dilate(std::vector<GLubyte> &image, std::vector<GLubyte> &covered,
+                   unsigned int size, unsigned int iterations) {
+  for (unsigned int i = 0; i < iterations; i++) {
+    std::vector<GLubyte> grown = covered;
+    for (unsigned int y = 0; y < size; y++) {
+      for (unsigned int x = 0; x < size; x++) {
+        if (covered[size_t(y) * size + x]) continue;
+        unsigned int sum = 0, count = 0;
+        for (int dy = -1; dy <= 1; dy++) {
+          for (int dx = -1; dx <= 1; dx++) {
+            // the texture repeats, as it is sampled
+            const size_t n = size_t((y + size + dy) % size) * size +
+                             (x + size + dx) % size;
+            if (!covered[n]) continue;
+            sum += image[n];
+            count++;
+          }
+        }
+        if (count) {
+          image[size_t(y) * size + x] = GLubyte((sum + count / 2) / count);
+          grown[size_t(y) * size + x] = 1;
+        }
+      }
+    }
+    covered.swap(grown);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
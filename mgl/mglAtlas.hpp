@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Texture atlases laying the surface of a mesh out in a 2D texture
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_ATLAS_HPP
+#define MGL_ATLAS_HPP
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace mgl {
+
+class Atlas;
+
+////////////////////////////////////////////////////////////////////////// Atlas
+
+// Texcoords of triangles in a square texture of size x size texels, three per
+// triangle like Mesh::getTrianglePositions. An atlas is usable when every
+// triangle is inside [0, 1] and no texel is covered by two of them.
+class Atlas {
+ public:
+  // Empty texels between the generated charts, filled by dilate so filtering
+  // and the first mipmaps of a chart do not read its neighbours
+  static const unsigned int PADDING = 4;
+
+  static bool isValid(const std::vector<glm::vec2> &texcoords,
+                      unsigned int size);
+
+  // Neighbouring triangles facing the same axis make a chart, projected on the
+  // plane of that axis. Charts keep their size in model units and are packed
+  // in rows, PADDING texels apart, at the largest scale that fits.
+  static std::vector<glm::vec2> generate(
+      const std::vector<glm::vec3> &positions, unsigned int size);
+
+  // Calls texel(x, y, barycentric) for every texel whose center is within
+  // margin texels of the triangle, a negative margin keeps away from its edges
+  template <typename F>
+  static void rasterize(const glm::vec2 (&texcoords)[3], unsigned int size,
+                        float margin, F &&texel);
+
+  // Grows the covered texels of a size x size image into the others, one
+  // texel per iteration, each the mean of its covered neighbours
+  static void dilate(std::vector<GLubyte> &image, std::vector<GLubyte> &covered,
+                     unsigned int size, unsigned int iterations);
+};
+
+template <typename F>
+void Atlas::rasterize(const glm::vec2 (&texcoords)[3], unsigned int size,
+                      float margin, F &&texel) {
+  const glm::vec2 v[3] = {texcoords[0] * float(size),
+                          texcoords[1] * float(size),
+                          texcoords[2] * float(size)};
+  const float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) -
+                     (v[2].x - v[0].x) * (v[1].y - v[0].y);
+  if (std::abs(area) < 1.0e-12f) return;
+
+  // edge e is opposite to vertex e, its function is the barycentric weight of
+  // that vertex times the area, and its length turns it into a distance
+  float lengths[3];
+  for (int e = 0; e < 3; e++) {
+    lengths[e] = glm::length(v[(e + 2) % 3] - v[(e + 1) % 3]);
+  }
+  const float grow = std::max(margin, 0.0f);
+  const glm::vec2 low = glm::min(v[0], glm::min(v[1], v[2])) - grow;
+  const glm::vec2 high = glm::max(v[0], glm::max(v[1], v[2])) + grow;
+  const int firstX = std::max(0, int(std::floor(low.x - 0.5f)));
+  const int firstY = std::max(0, int(std::floor(low.y - 0.5f)));
+  const int lastX = std::min(int(size) - 1, int(std::ceil(high.x - 0.5f)));
+  const int lastY = std::min(int(size) - 1, int(std::ceil(high.y - 0.5f)));
+
+  for (int y = firstY; y <= lastY; y++) {
+    for (int x = firstX; x <= lastX; x++) {
+      const glm::vec2 p(x + 0.5f, y + 0.5f);
+      glm::vec3 barycentric;
+      bool inside = true;
+      for (int e = 0; e < 3 && inside; e++) {
+        const glm::vec2 &a = v[(e + 1) % 3], &b = v[(e + 2) % 3];
+        const float function =
+            (b.x - a.x) * (p.y - a.y) - (p.x - a.x) * (b.y - a.y);
+        barycentric[e] = function / area;
+        inside = barycentric[e] * std::abs(area) >= -margin * lengths[e];
+      }
+      if (inside) texel(x, y, barycentric);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_ATLAS_HPP */
@@ -0,0 +1,183 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// BC4 (RGTC1) block compression of single channel images
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglCompression.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace mgl {
+
+//////////////////////////////////////////////////////////////////////////// BC4
+
+// The 8 values a block can take. With red0 > red1 the six values in between are
+// interpolated, otherwise four are and the last two are 0 and 255.
+static void palette(int red0, int red1, int values[8]) {
+  values[0] = red0;
+  values[1] = red1;
+  if (red0 > red1) {
+    for (int i = 2; i < 8; i++) {
+      values[i] = ((8 - i) * red0 + (i - 1) * red1 + 3) / 7;
+    }
+  } else {
+    for (int i = 2; i < 6; i++) {
+      values[i] = ((6 - i) * red0 + (i - 1) * red1 + 2) / 5;
+    }
+    values[6] = 0;
+    values[7] = 255;
+  }
+}
+
+// Nearest palette entry for every texel, returns the squared error
+static int fitBlock(const int texels[16], int red0, int red1,
+                    std::uint64_t &indices) {
+  int values[8];
+  palette(red0, red1, values);
+  int error = 0;
+  indices = 0;
+  for (int k = 0; k < 16; k++) {
+    int best = 0, bestError = std::numeric_limits<int>::max();
+    for (int i = 0; i < 8; i++) {
+      int d = texels[k] - values[i];
+      if (d * d < bestError) {
+        bestError = d * d;
+        best = i;
+      }
+    }
+    error += bestError;
+    indices |= std::uint64_t(best) << (3 * k);
+  }
+  return error;
+}
+
+// Moves the endpoints of a six value fit to where they fit its indices best in
+// the least squares sense, while that lowers the error. The range of the block
+// is rarely the best pair, its extremes are single texels.
+static void refineBlock(const int texels[16], int &red0, int &red1,
+                        std::uint64_t &indices, int &error) {
+  for (int pass = 0; pass < 2 && error > 0; pass++) {
+    // texel k is taken as (a red0 + b red1) / 7 with a + b = 7
+    double aa = 0, ab = 0, bb = 0, at = 0, bt = 0;
+    for (int k = 0; k < 16; k++) {
+      int index = (indices >> (3 * k)) & 7;
+      double a = index == 0 ? 7 : index == 1 ? 0 : 8 - index;
+      double b = 7 - a;
+      aa += a * a;
+      ab += a * b;
+      bb += b * b;
+      at += a * 7 * texels[k];
+      bt += b * 7 * texels[k];
+    }
+    double determinant = aa * bb - ab * ab;
+    if (determinant == 0) break;
+    int fit0 = int(std::lround((at * bb - bt * ab) / determinant));
+    int fit1 = int(std::lround((bt * aa - at * ab) / determinant));
+    fit0 = std::clamp(fit0, 0, 255);
+    fit1 = std::clamp(fit1, 0, 255);
+    if (fit0 <= fit1) break;
+    std::uint64_t fitIndices;
+    int fitError = fitBlock(texels, fit0, fit1, fitIndices);
+    if (fitError >= error) break;
+    red0 = fit0;
+    red1 = fit1;
+    indices = fitIndices;
+    error = fitError;
+  }
+}
+
+static void encodeBlock(const int texels[16], GLubyte *block) {
+  int low = 255, high = 0;
+  int innerLow = 255, innerHigh = 0;  // ignoring 0 and 255
+  for (int k = 0; k < 16; k++) {
+    low = std::min(low, texels[k]);
+    high = std::max(high, texels[k]);
+    if (texels[k] != 0 && texels[k] != 255) {
+      innerLow = std::min(innerLow, texels[k]);
+      innerHigh = std::max(innerHigh, texels[k]);
+    }
+  }
+
+  // six interpolated values over the whole range, or four over the range
+  // without the extremes when those can be taken by the exact 0 and 255
+  int red0 = high, red1 = low;
+  std::uint64_t indices;
+  int error = fitBlock(texels, red0, red1, indices);
+  if (red0 > red1) refineBlock(texels, red0, red1, indices, error);
+  if (error > 0 && innerLow <= innerHigh) {
+    std::uint64_t innerIndices;
+    int innerError = fitBlock(texels, innerLow, innerHigh, innerIndices);
+    if (innerError < error) {
+      red0 = innerLow;
+      red1 = innerHigh;
+      indices = innerIndices;
+    }
+  }
+
+  block[0] = static_cast<GLubyte>(red0);
+  block[1] = static_cast<GLubyte>(red1);
+  for (int b = 0; b < 6; b++) {
+    block[2 + b] = static_cast<GLubyte>(indices >> (8 * b));
+  }
+}
+
+std::size_t bc4Size(unsigned int width, unsigned int height) {
+  return std::size_t((width + 3) / 4) * ((height + 3) / 4) * BC4_BLOCK_BYTES;
+}
+
+void encodeBC4(const GLubyte *image, unsigned int width, unsigned int height,
+               GLubyte *blocks) {
+  for (unsigned int by = 0; by < height; by += 4) {
+    for (unsigned int bx = 0; bx < width; bx += 4) {
+      int texels[16];
+      for (unsigned int y = 0; y < 4; y++) {
+        unsigned int row = std::min(by + y, height - 1);
+        for (unsigned int x = 0; x < 4; x++) {
+          unsigned int column = std::min(bx + x, width - 1);
+          texels[y * 4 + x] = image[std::size_t(row) * width + column];
+        }
+      }
+      encodeBlock(texels, blocks);
+      blocks += BC4_BLOCK_BYTES;
+    }
+  }
+}
+
+void decodeBC4(const GLubyte *blocks, unsigned int width, unsigned int height,
+               GLubyte *image) {
+  for (unsigned int by = 0; by < height; by += 4) {
+    for (unsigned int bx = 0; bx < width; bx += 4) {
+      int values[8];
+      palette(blocks[0], blocks[1], values);
+      std::uint64_t indices = 0;
+      for (int b = 0; b < 6; b++) {
+        indices |= std::uint64_t(blocks[2 + b]) << (8 * b);
+      }
+      for (unsigned int y = 0; y < 4 && by + y < height; y++) {
+        for (unsigned int x = 0; x < 4 && bx + x < width; x++) {
+          int index = (indices >> (3 * (y * 4 + x))) & 7;
+          image[std::size_t(by + y) * width + bx + x] =
+              static_cast<GLubyte>(values[index]);
+        }
+      }
+      blocks += BC4_BLOCK_BYTES;
+    }
+  }
+}
+
+double psnr(const GLubyte *a, const GLubyte *b, std::size_t size) {
+  double error = 0.0;
+  for (std::size_t i = 0; i < size; i++) {
+    double d = double(a[i]) - double(b[i]);
+    error += d * d;
+  }
+  if (error == 0.0) return std::numeric_limits<double>::infinity();
+  return 10.0 * std::log10(255.0 * 255.0 * double(size) / error);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
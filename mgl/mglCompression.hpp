@@ -0,0 +1,35 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// BC4 (RGTC1) block compression of single channel images
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_COMPRESSION_HPP
+#define MGL_COMPRESSION_HPP
+
+#include <GL/glew.h>
+
+#include <cstddef>
+
+namespace mgl {
+
+//////////////////////////////////////////////////////////////////////////// BC4
+
+// Every 4x4 block of texels is stored in 8 bytes: two endpoints and a 3 bit
+// palette index per texel. Images whose sides are not multiples of 4 are padded
+// by repeating the last row and column.
+const std::size_t BC4_BLOCK_BYTES = 8;
+
+std::size_t bc4Size(unsigned int width, unsigned int height);
+void encodeBC4(const GLubyte *image, unsigned int width, unsigned int height,
+               GLubyte *blocks);
+void decodeBC4(const GLubyte *blocks, unsigned int width, unsigned int height,
+               GLubyte *image);
+
+// Peak signal to noise ratio of b against a in dB, infinite when they are equal
+double psnr(const GLubyte *a, const GLubyte *b, std::size_t size);
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_COMPRESSION_HPP */
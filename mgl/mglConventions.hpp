@@ -20,11 +20,14 @@ const char NORMAL_MATRIX[] = "NormalMatrix";
 const char VIEW_MATRIX[] = "ViewMatrix";
 const char PROJECTION_MATRIX[] = "ProjectionMatrix";
 const char TEXTURE_MATRIX[] = "TextureMatrix";
+const char DEQUANTIZATION_MATRIX[] = "DequantizationMatrix";
 const char CAMERA_BLOCK[] = "Camera";
 const char LIGHT_BLOCK[] = "Light";
 const char PRIMARY_COLOR_UNIFORM[] = "PrimaryColor";
 const char SECONDARY_COLOR_UNIFORM[] = "SecondaryColor";
 const char TEXTURE[] = "Texture";
+const char TEXCOORD_SCALE[] = "TexcoordScale";
+const char PAGE_TABLE[] = "PageTable";
 
 const char POSITION_ATTRIBUTE[] = "inPosition";
 const char NORMAL_ATTRIBUTE[] = "inNormal";
@@ -33,6 +36,15 @@ const char TANGENT_ATTRIBUTE[] = "inTangent";
 const char BITANGENT_ATTRIBUTE[] = "inBitangent";
 const char COLOR_ATTRIBUTE[] = "inColor";
 
+const char COMPRESSED_VOLUME_DEFINE[] = "COMPRESSED_VOLUME";
+const char PROCEDURAL_VOLUME_DEFINE[] = "PROCEDURAL_VOLUME";
+const char BRICKED_VOLUME_DEFINE[] = "BRICKED_VOLUME";
+const char BRICK_SIZE_DEFINE[] = "BRICK_SIZE";
+const char GRADIENT_VOLUME_DEFINE[] = "GRADIENT_VOLUME";
+const char GRADIENT_SCALE_DEFINE[] = "GRADIENT_SCALE";
+const char VOLUME_CHANNEL_DEFINE[] = "VOLUME_CHANNEL";
+const char ATLAS_TEXTURE_DEFINE[] = "ATLAS_TEXTURE";
+
 ////////////////////////////////////////////////////////////////////////////////
 }  // namespace mgl
 
@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Asynchronous asset loading with C++20 coroutines
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglLoader.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include "./mglMesh.hpp"
+#include "./mglTexture.hpp"
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////////////////// Loader
+
+Loader::Loader()
+    : Workers(std::max(std::thread::hardware_concurrency(), MIN_WORKERS)) {}
+
+Loader::~Loader() {}
+
+Loader &Loader::getInstance() {
+  static Loader instance;
+  return instance;
+}
+
+Loader::WorkerAwaiter Loader::resumeOnWorker() { return {*this}; }
+
+Loader::GlThreadAwaiter Loader::resumeOnGlThread() { return {*this}; }
+
+void Loader::schedule(std::coroutine_handle<> handle) {
+  {
+    std::lock_guard<std::mutex> lock(GlThreadMutex);
+    GlThreadQueue.push(handle);
+  }
+  GlThreadCondition.notify_one();
+}
+
+void Loader::resumeNext() {
+  std::coroutine_handle<> handle;
+  {
+    std::unique_lock<std::mutex> lock(GlThreadMutex);
+    GlThreadCondition.wait(lock, [this]() { return !GlThreadQueue.empty(); });
+    handle = GlThreadQueue.front();
+    GlThreadQueue.pop();
+  }
+  handle.resume();
+}
+
+//////////////////////////////////////////////////////////////////////// Loading
+
+Task<Mesh *> loadMesh(Mesh *mesh, std::string filename) {
+  co_await Loader::getInstance().resumeOnWorker();
+  mesh->load(filename);
+  co_await Loader::getInstance().resumeOnGlThread();
+  mesh->upload();
+  co_return mesh;
+}
+
+Task<Texture2D *> loadTexture(Texture2D *texture, std::string filename) {
+  co_await Loader::getInstance().resumeOnWorker();
+  texture->read(filename);
+  co_await Loader::getInstance().resumeOnGlThread();
+  // printed here, on one thread, so the lines of images read at once do not interleave
+  std::cout << "Loaded image file " << filename << std::endl;
+  texture->upload();
+  co_return texture;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,240 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Asynchronous asset loading with C++20 coroutines
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_LOADER_HPP
+#define MGL_LOADER_HPP
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <utility>
+
+#include "./mglThreadPool.hpp"
+
+namespace mgl {
+
+template <typename T>
+class Task;
+class Loader;
+class Mesh;
+class Texture2D;
+
+/////////////////////////////////////////////////////////////////////////// Task
+
+template <typename T>
+struct TaskResult {
+  std::optional<T> value;
+  void return_value(T result) { value.emplace(std::move(result)); }
+  T take() { return std::move(*value); }
+};
+
+template <>
+struct TaskResult<void> {
+  void return_void() {}
+  void take() {}
+};
+
+// A coroutine that starts when called and runs up to its first suspension,
+// so tasks started one after the other load at the same time:
+//
+//   Task<Mesh *> base = loadMesh(baseMesh, "base.obj");
+//   Task<Mesh *> top = loadMesh(topMesh, "top.obj");
+//   co_await base;
+//   co_await top;
+//
+// A task is awaited once, or waited on with Loader::wait, before it goes away:
+// the frame of a task still running would be destroyed under it. Its
+// exceptions are thrown where it is awaited, so tasks started together are
+// awaited with whenAll first, lest one throwing leave the others running.
+template <typename T>
+class Task {
+ public:
+  struct promise_type;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  // Resumes the awaiting coroutine where the task finishes
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    std::coroutine_handle<> await_suspend(Handle handle) noexcept {
+      promise_type &promise = handle.promise();
+      void *continuation = promise.continuation.exchange(&promise);
+      return continuation ? std::coroutine_handle<>::from_address(continuation)
+                          : std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+
+  // The continuation is set at most once, by the coroutine awaiting, and the
+  // address of the promise marks the task as finished
+  struct promise_type : TaskResult<T> {
+    std::atomic<void *> continuation{nullptr};
+    std::exception_ptr error;
+
+    Task get_return_object() { return Task(Handle::from_promise(*this)); }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+  };
+
+  struct ReadyAwaiter {
+    Handle handle;
+    bool await_ready() {
+      return handle.promise().continuation.load() == &handle.promise();
+    }
+    bool await_suspend(std::coroutine_handle<> awaiting) {
+      void *expected = nullptr;
+      return handle.promise().continuation.compare_exchange_strong(
+          expected, awaiting.address());
+    }
+    void await_resume() {}
+  };
+
+  struct ResultAwaiter : ReadyAwaiter {
+    T await_resume() { return Task::result(this->handle); }
+  };
+
+  Task(Task &&other) noexcept : Coroutine(std::exchange(other.Coroutine, {})) {}
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      if (Coroutine) {
+        assert(isReady());
+        Coroutine.destroy();
+      }
+      Coroutine = std::exchange(other.Coroutine, {});
+    }
+    return *this;
+  }
+  ~Task() {
+    if (Coroutine) {
+      assert(isReady());
+      Coroutine.destroy();
+    }
+  }
+
+  bool isReady() {
+    return Coroutine.promise().continuation.load() == &Coroutine.promise();
+  }
+  // Suspends until the task is finished, without taking its result
+  ReadyAwaiter whenReady() { return {Coroutine}; }
+  ResultAwaiter operator co_await() { return {{Coroutine}}; }
+  // Once the task is finished
+  T result() { return result(Coroutine); }
+
+ private:
+  Handle Coroutine;
+
+  explicit Task(Handle coroutine) : Coroutine(coroutine) {}
+
+  static T result(Handle handle) {
+    if (handle.promise().error) {
+      std::rethrow_exception(handle.promise().error);
+    }
+    return handle.promise().take();
+  }
+
+ public:
+  Task(Task const &) = delete;
+  void operator=(Task const &) = delete;
+};
+
+// Suspends until every task is finished, whether or not they threw. Their
+// results are then taken by awaiting each, which no longer suspends.
+template <typename... T>
+Task<void> whenAll(Task<T> &...tasks) {
+  (co_await tasks.whenReady(), ...);
+}
+
+///////////////////////////////////////////////////////////////////////// Loader
+
+// Moves coroutines between its workers and the GL thread. The GL thread runs
+// what is resumed on it while it waits on a task, the workers run everything
+// else: file I/O, imports and CPU processing.
+class Loader {
+ public:
+  // Loads wait on files as much as on the CPU, and have a pool of their own so
+  // they never hold the workers of ThreadPool::getInstance
+  static constexpr unsigned int MIN_WORKERS = 4;
+
+  struct WorkerAwaiter {
+    Loader &loader;
+    bool await_ready() { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+      loader.Workers.submit([handle]() { handle.resume(); });
+    }
+    void await_resume() {}
+  };
+
+  struct GlThreadAwaiter {
+    Loader &loader;
+    bool await_ready() { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+      loader.schedule(handle);
+    }
+    void await_resume() {}
+  };
+
+  static Loader &getInstance();
+
+  WorkerAwaiter resumeOnWorker();
+  GlThreadAwaiter resumeOnGlThread();
+
+  // Called on the GL thread, runs the coroutines resumed on it until task is
+  // finished and returns its result
+  template <typename T>
+  T wait(Task<T> task);
+
+ private:
+  ThreadPool Workers;
+  std::queue<std::coroutine_handle<>> GlThreadQueue;
+  std::mutex GlThreadMutex;
+  std::condition_variable GlThreadCondition;
+
+  Loader();
+  ~Loader();
+
+  void schedule(std::coroutine_handle<> handle);
+  void resumeNext();
+  template <typename T>
+  static Task<void> finish(Task<T> &task);
+
+ public:
+  Loader(Loader const &) = delete;
+  void operator=(Loader const &) = delete;
+};
+
+// the last step is taken on the GL thread, so wait always wakes up for it
+template <typename T>
+Task<void> Loader::finish(Task<T> &task) {
+  co_await task.whenReady();
+  co_await getInstance().resumeOnGlThread();
+}
+
+template <typename T>
+T Loader::wait(Task<T> task) {
+  Task<void> finished = finish(task);
+  while (!finished.isReady()) {
+    resumeNext();
+  }
+  return task.result();
+}
+
+// Imports on a worker what Mesh::create would, then creates the buffers on
+// the GL thread. The mesh is set up (flags, formats) before.
+Task<Mesh *> loadMesh(Mesh *mesh, std::string filename);
+
+// Decodes the image on a worker, creates the texture on the GL thread
+Task<Texture2D *> loadTexture(Texture2D *texture, std::string filename);
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_LOADER_HPP */
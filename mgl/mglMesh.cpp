@@ -8,6 +8,19 @@
 
 #include "./mglMesh.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+
+#include "./mglAtlas.hpp"
+#include "./mglMeshOptimizer.hpp"
+
 namespace mgl {
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -18,6 +31,17 @@ Mesh::Mesh() {
   TangentsAndBitangentsLoaded = false;
   VaoId = -1;
   AssimpFlags = aiProcess_Triangulate;
+  AtlasSize = 0;
+  VertexOrder = false;
+  Levels = 1;
+  LevelCount = 1;
+  BoundsCenter = glm::vec3(0.0f);
+  BoundsRadius = 0.0f;
+  VertexStride = 0;
+  Quantized = false;
+  DequantizationMatrix = glm::mat4(1.0f);
+  IndexType = GL_UNSIGNED_INT;
+  IndexSize = sizeof(GLuint);
 }
 
 Mesh::~Mesh() { destroyBufferObjects(); }
@@ -42,12 +66,63 @@ void Mesh::calculateTangentSpace() {
 
 void Mesh::flipUVs() { AssimpFlags |= aiProcess_FlipUVs; }
 
+void Mesh::generateAtlas(unsigned int size) { AtlasSize = size; }
+
+void Mesh::optimizeVertexOrder() { VertexOrder = true; }
+
+void Mesh::generateLevels(unsigned int count) {
+  Levels = std::max(count, 1u);
+}
+
+void Mesh::quantizeAttributes() { Quantized = true; }
+
 bool Mesh::hasNormals() { return NormalsLoaded; }
 
 bool Mesh::hasTexcoords() { return TexcoordsLoaded; }
 
 bool Mesh::hasTangentsAndBitangents() { return TangentsAndBitangentsLoaded; }
 
+GLsizei Mesh::getVertexStride() { return VertexStride; }
+
+glm::mat4 Mesh::getDequantizationMatrix() { return DequantizationMatrix; }
+
+unsigned int Mesh::getLevelCount() { return LevelCount; }
+
+glm::vec3 Mesh::getBoundsCenter() { return BoundsCenter; }
+
+float Mesh::getBoundsRadius() { return BoundsRadius; }
+
+std::vector<glm::vec3> Mesh::getTrianglePositions() {
+  const glm::vec3 *positions = stream<glm::vec3>(MeshCache::POSITIONS);
+  const unsigned int *indices = stream<unsigned int>(MeshCache::INDICES);
+  std::vector<glm::vec3> triangles;
+  triangles.reserve(Streams.sizes[MeshCache::INDICES] / sizeof(unsigned int));
+  for (MeshData &mesh : Meshes) {
+    if (mesh.level) continue;
+    for (unsigned int i = 0; i < mesh.nIndices; i++) {
+      triangles.push_back(
+          positions[mesh.baseVertex + indices[mesh.baseIndex + i]]);
+    }
+  }
+  return triangles;
+}
+
+std::vector<glm::vec2> Mesh::getTriangleTexcoords() {
+  const glm::vec2 *texcoords = stream<glm::vec2>(MeshCache::TEXCOORDS);
+  const unsigned int *indices = stream<unsigned int>(MeshCache::INDICES);
+  std::vector<glm::vec2> triangles;
+  if (!TexcoordsLoaded) return triangles;
+  triangles.reserve(Streams.sizes[MeshCache::INDICES] / sizeof(unsigned int));
+  for (MeshData &mesh : Meshes) {
+    if (mesh.level) continue;
+    for (unsigned int i = 0; i < mesh.nIndices; i++) {
+      triangles.push_back(
+          texcoords[mesh.baseVertex + indices[mesh.baseIndex + i]]);
+    }
+  }
+  return triangles;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void Mesh::processMesh(const aiMesh *mesh) {
@@ -113,14 +188,262 @@ void Mesh::processScene(const aiScene *scene) {
 #endif
 }
 
+void Mesh::processAtlas() {
+  useImportedStreams();
+  std::vector<glm::vec2> texcoords = getTriangleTexcoords();
+  if (TexcoordsLoaded) {
+    if (Atlas::isValid(texcoords, AtlasSize)) return;
+    std::cerr << "WARNING: Texcoords overlap or leave [0, 1], generating an "
+                 "atlas instead"
+              << std::endl;
+  }
+  texcoords = Atlas::generate(getTrianglePositions(), AtlasSize);
+
+  // each corner becomes the vertex of its position and texcoord, a vertex
+  // shared by several charts is split
+  std::vector<glm::vec3> positions, normals, tangents, bitangents;
+  std::vector<glm::vec2> splitTexcoords;
+  size_t corner = 0;
+  for (MeshData &mesh : Meshes) {
+    const unsigned int baseVertex = static_cast<unsigned int>(positions.size());
+    std::map<std::tuple<unsigned int, float, float>, unsigned int> vertices;
+    for (unsigned int i = 0; i < mesh.nIndices; i++) {
+      const unsigned int vertex = mesh.baseVertex + Indices[mesh.baseIndex + i];
+      const glm::vec2 &texcoord = texcoords[corner++];
+      auto split = vertices.emplace(
+          std::make_tuple(vertex, texcoord.x, texcoord.y),
+          static_cast<unsigned int>(positions.size()) - baseVertex);
+      if (split.second) {
+        positions.push_back(Positions[vertex]);
+        splitTexcoords.push_back(texcoord);
+        if (NormalsLoaded) normals.push_back(Normals[vertex]);
+        if (TangentsAndBitangentsLoaded) {
+          tangents.push_back(Tangents[vertex]);
+#ifdef CREATE_BITANGENT
+          bitangents.push_back(Bitangents[vertex]);
+#endif
+        }
+      }
+      Indices[mesh.baseIndex + i] = split.first->second;
+    }
+    mesh.baseVertex = baseVertex;
+  }
+  Positions.swap(positions);
+  Normals.swap(normals);
+  Texcoords.swap(splitTexcoords);
+  Tangents.swap(tangents);
+#ifdef CREATE_BITANGENT
+  Bitangents.swap(bitangents);
+#endif
+  TexcoordsLoaded = true;
+
+#ifdef DEBUG
+  std::cout << "Generated " << AtlasSize << "x" << AtlasSize << " atlas ["
+            << Positions.size() << " vertices]" << std::endl;
+#endif
+}
+
+void Mesh::processVertexOrder() {
+#ifdef DEBUG
+  MeshOptimizer::Statistics before, after;
+#endif
+  for (std::size_t m = 0; m < Meshes.size(); m++) {
+    MeshData &mesh = Meshes[m];
+    const unsigned int vertices = countVertices(m);
+    unsigned int *indices = Indices.data() + mesh.baseIndex;
+#ifdef DEBUG
+    const MeshOptimizer::Statistics statistics =
+        MeshOptimizer::analyzeVertexCache(indices, mesh.nIndices, vertices);
+    before.acmr += statistics.acmr * mesh.nIndices;
+    before.atvr += statistics.atvr * mesh.nIndices;
+#endif
+    MeshOptimizer::optimizeTriangleOrder(
+        indices, mesh.nIndices, Positions.data() + mesh.baseVertex, vertices);
+    const std::vector<unsigned int> remap =
+        MeshOptimizer::optimizeVertexFetch(indices, mesh.nIndices, vertices);
+    auto reorder = [&](auto &attribute) {
+      if (attribute.size() < mesh.baseVertex + vertices) return;
+      auto begin = attribute.begin() + mesh.baseVertex;
+      std::vector<typename std::decay_t<decltype(attribute)>::value_type>
+          reordered(vertices);
+      for (unsigned int v = 0; v < vertices; v++) {
+        reordered[remap[v]] = begin[v];
+      }
+      std::copy(reordered.begin(), reordered.end(), begin);
+    };
+    reorder(Positions);
+    reorder(Normals);
+    reorder(Texcoords);
+    reorder(Tangents);
+#ifdef CREATE_BITANGENT
+    reorder(Bitangents);
+#endif
+#ifdef DEBUG
+    const MeshOptimizer::Statistics optimized =
+        MeshOptimizer::analyzeVertexCache(indices, mesh.nIndices, vertices);
+    after.acmr += optimized.acmr * mesh.nIndices;
+    after.atvr += optimized.atvr * mesh.nIndices;
+#endif
+  }
+
+#ifdef DEBUG
+  // weighted by the indices of each submesh
+  const float total =
+      static_cast<float>(std::max<std::size_t>(Indices.size(), 1));
+  std::cout << "Optimized vertex order [ACMR " << before.acmr / total << " -> "
+            << after.acmr / total << ", ATVR " << before.atvr / total << " -> "
+            << after.atvr / total << "]" << std::endl;
+#endif
+}
+
+// Vertices of submesh m of level 0, up to the next one
+unsigned int Mesh::countVertices(std::size_t m) {
+  const bool last = m + 1 == Meshes.size() || Meshes[m + 1].level != 0;
+  return (last ? static_cast<unsigned int>(Positions.size())
+               : Meshes[m + 1].baseVertex) -
+         Meshes[m].baseVertex;
+}
+
+void Mesh::processLevels() {
+  glm::vec3 low(INFINITY), high(-INFINITY);
+  for (const glm::vec3 &position : Positions) {
+    low = glm::min(low, position);
+    high = glm::max(high, position);
+  }
+  const float radius = 0.5f * glm::length(high - low);
+
+  // each level simplifies level 0, with the vertices of level 0
+  const std::size_t submeshes = Meshes.size();
+  std::size_t previous = Indices.size();
+  for (unsigned int level = 1; level < Levels; level++) {
+    const float maxError = LEVEL_ERROR * radius * float(1u << (level - 1));
+    std::vector<MeshData> meshes;
+    std::vector<unsigned int> indices;
+    for (std::size_t m = 0; m < submeshes; m++) {
+      const MeshData &mesh = Meshes[m];
+      const unsigned int vertices = countVertices(m);
+      const glm::vec3 *positions = Positions.data() + mesh.baseVertex;
+      std::vector<unsigned int> simplified = MeshOptimizer::simplify(
+          Indices.data() + mesh.baseIndex, mesh.nIndices, positions,
+          NormalsLoaded ? Normals.data() + mesh.baseVertex : nullptr,
+          TexcoordsLoaded ? Texcoords.data() + mesh.baseVertex : nullptr,
+          vertices, (mesh.nIndices >> level) / 3 * 3, maxError);
+      if (VertexOrder) {
+        MeshOptimizer::optimizeTriangleOrder(
+            simplified.data(), simplified.size(), positions, vertices);
+      }
+      MeshData simplifiedMesh;
+      simplifiedMesh.nIndices = static_cast<unsigned int>(simplified.size());
+      simplifiedMesh.baseIndex =
+          static_cast<unsigned int>(Indices.size() + indices.size());
+      simplifiedMesh.baseVertex = mesh.baseVertex;
+      simplifiedMesh.level = level;
+      meshes.push_back(simplifiedMesh);
+      indices.insert(indices.end(), simplified.begin(), simplified.end());
+    }
+    // a level hardly coarser than the one before ends the chain
+    if (indices.size() * 10 > previous * 9) break;
+    previous = indices.size();
+    Meshes.insert(Meshes.end(), meshes.begin(), meshes.end());
+    Indices.insert(Indices.end(), indices.begin(), indices.end());
+    LevelCount = level + 1;
+
+#ifdef DEBUG
+    std::cout << "Generated level " << level << " [" << indices.size() / 3
+              << " triangles]" << std::endl;
+#endif
+  }
+}
+
+void Mesh::useImportedStreams() {
+  auto use = [this](MeshCache::Stream s, const void *data, std::size_t size) {
+    Streams.streams[s] = size ? data : nullptr;
+    Streams.sizes[s] = size;
+  };
+  use(MeshCache::POSITIONS, Positions.data(),
+      sizeof(glm::vec3) * Positions.size());
+  use(MeshCache::NORMALS, Normals.data(),
+      NormalsLoaded ? sizeof(glm::vec3) * Normals.size() : 0);
+  use(MeshCache::TEXCOORDS, Texcoords.data(),
+      TexcoordsLoaded ? sizeof(glm::vec2) * Texcoords.size() : 0);
+  use(MeshCache::TANGENTS, Tangents.data(),
+      TangentsAndBitangentsLoaded ? sizeof(glm::vec3) * Tangents.size() : 0);
+#ifdef CREATE_BITANGENT
+  use(MeshCache::BITANGENTS, Bitangents.data(),
+      TangentsAndBitangentsLoaded ? sizeof(glm::vec3) * Bitangents.size() : 0);
+#endif
+  use(MeshCache::INDICES, Indices.data(), sizeof(unsigned int) * Indices.size());
+}
+
+bool Mesh::loadCachedMesh(const std::string &filename,
+                          const MeshCache::Key &key) {
+  MeshCache::Contents contents;
+  if (!MeshCache::getInstance().load(filename, key, CachedFile, contents)) {
+    return false;
+  }
+  Streams = contents;
+  Meshes.resize(contents.meshCount);
+  for (unsigned int i = 0; i < contents.meshCount; i++) {
+    Meshes[i].nIndices = contents.meshes[i].nIndices;
+    Meshes[i].baseIndex = contents.meshes[i].baseIndex;
+    Meshes[i].baseVertex = contents.meshes[i].baseVertex;
+    Meshes[i].level = contents.meshes[i].level;
+    LevelCount = std::max(LevelCount, Meshes[i].level + 1);
+  }
+  NormalsLoaded = contents.sizes[MeshCache::NORMALS] != 0;
+  TexcoordsLoaded = contents.sizes[MeshCache::TEXCOORDS] != 0;
+  TangentsAndBitangentsLoaded = contents.sizes[MeshCache::TANGENTS] != 0;
+
+#ifdef DEBUG
+  std::cout << "Mapped [" << filename << "] from the mesh cache ["
+            << contents.sizes[MeshCache::POSITIONS] / sizeof(glm::vec3)
+            << " vertices, "
+            << contents.sizes[MeshCache::INDICES] / sizeof(unsigned int)
+            << " indices]" << std::endl;
+#endif
+  return true;
+}
+
+void Mesh::storeCachedMesh(const std::string &filename,
+                           const MeshCache::Key &key) {
+  std::vector<MeshCache::SubMesh> table;
+  for (MeshData &mesh : Meshes) {
+    table.push_back(
+        {mesh.nIndices, mesh.baseIndex, mesh.baseVertex, mesh.level});
+  }
+  MeshCache::Contents contents = Streams;
+  contents.meshCount = static_cast<std::uint32_t>(table.size());
+  contents.meshes = table.data();
+  MeshCache::getInstance().store(filename, key, contents);
+}
+
 void Mesh::create(const std::string &filename) {
+  try {
+    load(filename);
+  } catch (const std::runtime_error &error) {
+    std::cerr << "ERROR: " << error.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  upload();
+}
+
+void Mesh::load(const std::string &filename) {
+  // a warm load maps what the import below left, Assimp is not run
+  MeshCache::Key key;
+  const bool cacheable =
+      MeshCache::getKey(filename, AssimpFlags, AtlasSize, VertexOrder, Levels,
+                        key);
+  if (cacheable && loadCachedMesh(filename, key)) {
+    prepareBufferObjects();
+    return;
+  }
+
   Assimp::Importer importer;
   const aiScene *scene = importer.ReadFile(filename, AssimpFlags);
   if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
       !scene->mRootNode) {
-    std::cout << "Error while loading:" << importer.GetErrorString()
-              << std::endl;
-    exit(EXIT_FAILURE);
+    throw std::runtime_error("Error while loading " + filename + ": " +
+                             importer.GetErrorString());
   }
 
 #ifdef DEBUG
@@ -128,62 +451,224 @@ void Mesh::create(const std::string &filename) {
 #endif
 
   processScene(scene);
-  createBufferObjects();
+  if (AtlasSize) {
+    processAtlas();
+  }
+  if (VertexOrder) {
+    processVertexOrder();
+  }
+  if (Levels > 1) {
+    processLevels();
+  }
+  useImportedStreams();
+  if (cacheable) {
+    storeCachedMesh(filename, key);
+  }
+  prepareBufferObjects();
 }
 
-void Mesh::createBufferObjects() {
-  GLuint boId[6];
+void Mesh::upload() { createBufferObjects(); }
 
-  glGenVertexArrays(1, &VaoId);
-  glBindVertexArray(VaoId);
-  {
-    glGenBuffers(6, boId);
+const GLfloat *Mesh::attributeStream(GLuint index) {
+  const MeshCache::Stream streams[] = {
+      MeshCache::INDICES,   MeshCache::POSITIONS, MeshCache::NORMALS,
+      MeshCache::TEXCOORDS, MeshCache::TANGENTS,  MeshCache::BITANGENTS};
+  if (index == INDEX || index >= sizeof(streams) / sizeof(streams[0])) {
+    return nullptr;
+  }
+  return stream<GLfloat>(streams[index]);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, boId[POSITION]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Positions[0]) * Positions.size(),
-                 &Positions[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(POSITION);
-    glVertexAttribPointer(POSITION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+Mesh::AttributeLayout Mesh::layoutOf(const VertexElement &element,
+                                     bool quantized) {
+  if (quantized) {
+    switch (element.index) {
+      case Mesh::POSITION:
+        // 4 components keep the vertex 4 byte aligned, w is read as 0
+        return {GL_UNSIGNED_SHORT, 4, GL_TRUE, 4 * sizeof(GLushort)};
+      case Mesh::NORMAL:
+      case Mesh::TANGENT:
+#ifdef CREATE_BITANGENT
+      case Mesh::BITANGENT:
+#endif
+        return {GL_INT_2_10_10_10_REV, 4, GL_TRUE, sizeof(GLuint)};
+      case Mesh::TEXCOORD:
+        return {GL_HALF_FLOAT, element.components, GL_FALSE,
+                GLsizei(element.components * sizeof(GLushort))};
+    }
+  }
+  return {GL_FLOAT, element.components, GL_FALSE,
+          GLsizei(element.components * sizeof(GLfloat))};
+}
 
-    if (NormalsLoaded) {
-      glBindBuffer(GL_ARRAY_BUFFER, boId[NORMAL]);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(Normals[0]) * Normals.size(),
-                   &Normals[0], GL_STATIC_DRAW);
-      glEnableVertexAttribArray(NORMAL);
-      glVertexAttribPointer(NORMAL, 3, GL_FLOAT, GL_FALSE, 0, 0);
+void Mesh::prepareBufferObjects() {
+  std::vector<VertexElement> elements = VertexElements;
+  if (elements.empty()) {
+    elements.push_back(PositionAttribute::ELEMENT);
+    if (NormalsLoaded) elements.push_back(NormalAttribute::ELEMENT);
+    if (TexcoordsLoaded) elements.push_back(TexcoordAttribute::ELEMENT);
+    if (TangentsAndBitangentsLoaded) {
+      elements.push_back(TangentAttribute::ELEMENT);
+#ifdef CREATE_BITANGENT
+      elements.push_back(BitangentAttribute::ELEMENT);
+#endif
     }
+  }
 
-    if (TexcoordsLoaded) {
-      glBindBuffer(GL_ARRAY_BUFFER, boId[TEXCOORD]);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(Texcoords[0]) * Texcoords.size(),
-                   &Texcoords[0], GL_STATIC_DRAW);
-      glEnableVertexAttribArray(TEXCOORD);
-      glVertexAttribPointer(TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, 0);
+  // attributes the mesh has not are left out, shaders read them as 0
+  std::vector<VertexElement> &stored = StoredElements;
+  std::vector<AttributeLayout> &layouts = Layouts;
+  std::vector<const GLfloat *> sources;
+  stored.clear();
+  layouts.clear();
+  VertexStride = 0;
+  for (const VertexElement &element : elements) {
+    const GLfloat *source = attributeStream(element.index);
+    if (!source) {
+      std::cerr << "WARNING: Mesh has no attribute " << element.index
+                << " of its vertex format" << std::endl;
+      continue;
     }
+    stored.push_back(element);
+    layouts.push_back(layoutOf(element, Quantized));
+    sources.push_back(source);
+    VertexStride += layouts.back().bytes;
+  }
 
-    if (TangentsAndBitangentsLoaded) {
-      glBindBuffer(GL_ARRAY_BUFFER, boId[TANGENT]);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(Tangents[0]) * Tangents.size(),
-                   &Tangents[0], GL_STATIC_DRAW);
-      glEnableVertexAttribArray(TANGENT);
-      glVertexAttribPointer(TANGENT, 3, GL_FLOAT, GL_FALSE, 0, 0);
+  const std::size_t vertices =
+      Streams.sizes[MeshCache::POSITIONS] / sizeof(glm::vec3);
+  const glm::vec3 *positions = stream<glm::vec3>(MeshCache::POSITIONS);
 
-#ifdef CREATE_BITANGENT
-      glBindBuffer(GL_ARRAY_BUFFER, boId[BITANGENT]);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(Bitangents[0]) * Bitangents.size(),
-                   &Bitangents[0], GL_STATIC_DRAW);
-      glEnableVertexAttribArray(BITANGENT);
-      glVertexAttribPointer(BITANGENT, 3, GL_FLOAT, GL_FALSE, 0, 0);
-#endif
+  glm::vec3 low(INFINITY), high(-INFINITY);
+  for (std::size_t v = 0; v < vertices; v++) {
+    low = glm::min(low, positions[v]);
+    high = glm::max(high, positions[v]);
+  }
+  BoundsCenter = vertices ? 0.5f * (low + high) : glm::vec3(0.0f);
+  BoundsRadius = 0.0f;
+  for (std::size_t v = 0; v < vertices; v++) {
+    BoundsRadius =
+        std::max(BoundsRadius, glm::length(positions[v] - BoundsCenter));
+  }
+
+  // positions are fixed point in the bounds of the mesh, flat axes keep a
+  // nonzero extent
+  glm::vec3 extent(1.0f);
+  DequantizationMatrix = glm::mat4(1.0f);
+  if (!Quantized || !vertices) {
+    low = glm::vec3(0.0f);
+  } else {
+    extent = glm::max(high - low, glm::vec3(1.0e-6f));
+    DequantizationMatrix[0][0] = extent.x;
+    DequantizationMatrix[1][1] = extent.y;
+    DequantizationMatrix[2][2] = extent.z;
+    DequantizationMatrix[3] = glm::vec4(low, 1.0f);
+  }
+
+  VertexData.assign(vertices * VertexStride, 0);
+  GLubyte *vertex = VertexData.data();
+  for (std::size_t v = 0; v < vertices; v++) {
+    for (std::size_t a = 0; a < stored.size(); a++) {
+      const GLint n = stored[a].components;
+      const GLfloat *value = sources[a] + v * n;
+      const AttributeLayout &layout = layouts[a];
+      if (layout.type == GL_UNSIGNED_SHORT) {
+        const glm::vec3 unit = (glm::make_vec3(value) - low) / extent;
+        const glm::u16vec4 packed(
+            glm::round(glm::clamp(unit, 0.0f, 1.0f) * 65535.0f), 0);
+        std::memcpy(vertex, &packed, layout.bytes);
+      } else if (layout.type == GL_INT_2_10_10_10_REV) {
+        const glm::vec3 direction = glm::make_vec3(value);
+        const float length = glm::length(direction);
+        const GLuint packed = glm::packSnorm3x10_1x2(glm::vec4(
+            length > 0.0f ? direction / length : direction, 0.0f));
+        std::memcpy(vertex, &packed, layout.bytes);
+      } else if (layout.type == GL_HALF_FLOAT) {
+        for (GLint c = 0; c < n; c++) {
+          const GLushort half = glm::packHalf1x16(value[c]);
+          std::memcpy(vertex + c * sizeof(GLushort), &half, sizeof(GLushort));
+        }
+      } else {
+        std::memcpy(vertex, value, layout.bytes);
+      }
+      vertex += layout.bytes;
     }
+  }
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boId[INDEX]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices[0]) * Indices.size(),
-                 &Indices[0], GL_STATIC_DRAW);
+  // indices are relative to the base vertex of their submesh
+  const unsigned int *sourceIndices = stream<unsigned int>(MeshCache::INDICES);
+  const std::size_t nIndices =
+      Streams.sizes[MeshCache::INDICES] / sizeof(unsigned int);
+  IndexType = GL_UNSIGNED_INT;
+  IndexSize = sizeof(GLuint);
+  if (Quantized) {
+    const unsigned int largest =
+        nIndices ? *std::max_element(sourceIndices, sourceIndices + nIndices)
+                 : 0;
+    if (largest <= 0xFF) {
+      IndexType = GL_UNSIGNED_BYTE;
+      IndexSize = sizeof(GLubyte);
+    } else if (largest <= 0xFFFF) {
+      IndexType = GL_UNSIGNED_SHORT;
+      IndexSize = sizeof(GLushort);
+    }
+  }
+  std::vector<GLubyte> &indices = IndexData;
+  indices.clear();
+  if (IndexType != GL_UNSIGNED_INT) {
+    indices.resize(nIndices * IndexSize);
+    for (std::size_t i = 0; i < nIndices; i++) {
+      if (IndexType == GL_UNSIGNED_BYTE) {
+        indices[i] = GLubyte(sourceIndices[i]);
+      } else {
+        const GLushort index = GLushort(sourceIndices[i]);
+        std::memcpy(&indices[i * sizeof(GLushort)], &index, sizeof(GLushort));
+      }
+    }
+  }
+}
+
+void Mesh::createBufferObjects() {
+  GLuint boId[2];
+
+  glGenVertexArrays(1, &VaoId);
+  glBindVertexArray(VaoId);
+  {
+    glGenBuffers(2, boId);
+
+    glBindBuffer(GL_ARRAY_BUFFER, boId[0]);
+    glBufferData(GL_ARRAY_BUFFER, VertexData.size(), VertexData.data(),
+                 GL_STATIC_DRAW);
+    std::size_t offset = 0;
+    for (std::size_t a = 0; a < StoredElements.size(); a++) {
+      glEnableVertexAttribArray(StoredElements[a].index);
+      glVertexAttribPointer(StoredElements[a].index, Layouts[a].size,
+                            Layouts[a].type, Layouts[a].normalized,
+                            VertexStride, reinterpret_cast<void *>(offset));
+      offset += Layouts[a].bytes;
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boId[1]);
+    if (IndexType == GL_UNSIGNED_INT) {
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, Streams.sizes[MeshCache::INDICES],
+                   Streams.streams[MeshCache::INDICES], GL_STATIC_DRAW);
+    } else {
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, IndexData.size(), IndexData.data(),
+                   GL_STATIC_DRAW);
+    }
   }
   glBindVertexArray(0);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
-  //glDeleteBuffers(6, boId);
+  //glDeleteBuffers(2, boId);
+
+#ifdef DEBUG
+  std::cout << "Interleaved " << StoredElements.size() << " attribute(s) ["
+            << VertexStride << " bytes per vertex, " << IndexSize
+            << " bytes per index]" << std::endl;
+#endif
+  // the buffers have their own copies now
+  std::vector<GLubyte>().swap(VertexData);
+  std::vector<GLubyte>().swap(IndexData);
 }
 
 void Mesh::destroyBufferObjects() {
@@ -199,12 +684,16 @@ void Mesh::destroyBufferObjects() {
   glBindVertexArray(0);
 }
 
-void Mesh::draw() {
+void Mesh::draw() { draw(0); }
+
+void Mesh::draw(unsigned int level) {
+  level = std::min(level, LevelCount - 1);
   glBindVertexArray(VaoId);
   for (MeshData &mesh : Meshes) {
+    if (mesh.level != level) continue;
     glDrawElementsBaseVertex(
-        GL_TRIANGLES, mesh.nIndices, GL_UNSIGNED_INT,
-        reinterpret_cast<void *>((sizeof(unsigned int) * mesh.baseIndex)),
+        GL_TRIANGLES, mesh.nIndices, IndexType,
+        reinterpret_cast<void *>(std::size_t(IndexSize) * mesh.baseIndex),
         mesh.baseVertex);
   }
   glBindVertexArray(0);
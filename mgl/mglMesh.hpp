@@ -16,10 +16,13 @@
 #include <assimp/Importer.hpp>
 #include <glm/glm.hpp>
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <vector>
 
 #include "./mglIDrawable.hpp"
+#include "./mglMeshCache.hpp"
+#include "./mglVertexFormat.hpp"
 
 namespace mgl {
 
@@ -39,6 +42,7 @@ class Mesh : public IDrawable {
 #ifdef CREATE_BITANGENT
   static const GLuint BITANGENT = 5;
 #endif
+  static constexpr float LEVEL_ERROR = 0.01f;
 
   Mesh();
   ~Mesh();
@@ -50,23 +54,85 @@ class Mesh : public IDrawable {
   void generateTexcoords();
   void calculateTangentSpace();
   void flipUVs();
-
+  // Lays the triangles out in a size x size texture: the loaded texcoords when
+  // they already are an atlas, a generated one otherwise (see Atlas). Vertices
+  // on the seams of the charts are split.
+  void generateAtlas(unsigned int size);
+  // Reorders the triangles of each submesh for the post-transform vertex
+  // cache and overdraw, then the vertices in the order they are drawn (see
+  // MeshOptimizer)
+  void optimizeVertexOrder();
+  // Appends up to count - 1 coarser levels of detail to the index buffer, each
+  // with about half the triangles of the one before and a surface at most
+  // LEVEL_ERROR times the bounds radius away at level 1, twice as far at each
+  // level after (see MeshOptimizer::simplify). Levels that cannot get coarser
+  // within that are left out.
+  void generateLevels(unsigned int count);
+  // Stores only the attributes of the format, interleaved in one buffer (see
+  // VertexFormat). Without a format every attribute loaded is stored.
+  template <typename Format>
+  void setVertexFormat() {
+    VertexElements.assign(std::begin(Format::ELEMENTS),
+                          std::end(Format::ELEMENTS));
+  }
+  // Stores positions as 16 bit fixed point in the bounds of the mesh (see
+  // getDequantizationMatrix), normals, tangents and bitangents as
+  // GL_INT_2_10_10_10_REV, texcoords as half floats and indices in the
+  // smallest of GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT and GL_UNSIGNED_INT that
+  // holds them. Only the buffers change, the streams read back keep floats.
+  void quantizeAttributes();
+
+  // load then upload
   void create(const std::string &filename);
+  // Imports and processes the file, up to the data of the buffers. Makes no GL
+  // calls, other meshes may load on other threads at the same time. Throws
+  // std::runtime_error if the file cannot be imported, create exits instead.
+  void load(const std::string &filename);
+  // Creates the buffers on the GL thread
+  void upload();
   void draw() override;
+  // Levels past the coarsest draw the coarsest
+  void draw(unsigned int level);
 
   bool hasNormals();
   bool hasTexcoords();
   bool hasTangentsAndBitangents();
+  // Bytes of a vertex in the buffer
+  GLsizei getVertexStride();
+  // Takes the positions in the buffer to model space, sent as
+  // DequantizationMatrix. The identity when the attributes are not quantized.
+  glm::mat4 getDequantizationMatrix();
+  unsigned int getLevelCount();
+  // Sphere around the model space positions
+  glm::vec3 getBoundsCenter();
+  float getBoundsRadius();
+
+  // Model space positions of every triangle, three vertices each
+  std::vector<glm::vec3> getTrianglePositions();
+  // Texcoords of every triangle, in the same order
+  std::vector<glm::vec2> getTriangleTexcoords();
 
  private:
   GLuint VaoId;
   unsigned int AssimpFlags;
+  unsigned int AtlasSize;
+  bool VertexOrder;
+  unsigned int Levels, LevelCount;
+  glm::vec3 BoundsCenter;
+  float BoundsRadius;
+  std::vector<VertexElement> VertexElements;
+  GLsizei VertexStride;
+  bool Quantized;
+  glm::mat4 DequantizationMatrix;
+  GLenum IndexType;
+  GLsizei IndexSize;
   bool NormalsLoaded, TexcoordsLoaded, TangentsAndBitangentsLoaded;
 
   struct MeshData {
     unsigned int nIndices = 0;
     unsigned int baseIndex = 0;
     unsigned int baseVertex = 0;
+    unsigned int level = 0;
   };
   std::vector<MeshData> Meshes;
 
@@ -79,12 +145,53 @@ class Mesh : public IDrawable {
 #endif
   std::vector<unsigned int> Indices;
 
+  // The streams drawn and read back: the vectors above after an import, the
+  // mapped file after a warm load from the MeshCache
+  MappedFile CachedFile;
+  MeshCache::Contents Streams;
+
+  template <typename T>
+  const T *stream(MeshCache::Stream s) {
+    return static_cast<const T *>(Streams.streams[s]);
+  }
+  void useImportedStreams();
+  bool loadCachedMesh(const std::string &filename, const MeshCache::Key &key);
+  void storeCachedMesh(const std::string &filename, const MeshCache::Key &key);
+
   void processScene(const aiScene *scene);
   void processMesh(const aiMesh *mesh);
+  void processAtlas();
+  void processVertexOrder();
+  void processLevels();
+  unsigned int countVertices(std::size_t m);
+  // How an attribute is laid out in the vertex buffer
+  struct AttributeLayout {
+    GLenum type;
+    GLint size;
+    GLboolean normalized;
+    GLsizei bytes;
+  };
+  // The buffers, from load to upload
+  std::vector<VertexElement> StoredElements;
+  std::vector<AttributeLayout> Layouts;
+  std::vector<GLubyte> VertexData, IndexData;
+
+  const GLfloat *attributeStream(GLuint index);
+  static AttributeLayout layoutOf(const VertexElement &element, bool quantized);
+  void prepareBufferObjects();
   void createBufferObjects();
   void destroyBufferObjects();
 };
 
+// The attributes of a Mesh, for the formats of Mesh::setVertexFormat
+using PositionAttribute = VertexAttribute<Mesh::POSITION, 3>;
+using NormalAttribute = VertexAttribute<Mesh::NORMAL, 3>;
+using TexcoordAttribute = VertexAttribute<Mesh::TEXCOORD, 2>;
+using TangentAttribute = VertexAttribute<Mesh::TANGENT, 3>;
+#ifdef CREATE_BITANGENT
+using BitangentAttribute = VertexAttribute<Mesh::BITANGENT, 3>;
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 }  // namespace mgl
 
@@ -0,0 +1,189 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// On-disk cache for imported meshes
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglMeshCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace mgl {
+
+// Bytes of an element of each stream, see MeshCache::Stream
+static const std::uint64_t ELEMENT_SIZES[MeshCache::STREAM_COUNT] = {
+    3 * sizeof(float), 3 * sizeof(float), 2 * sizeof(float),
+    3 * sizeof(float), 3 * sizeof(float), sizeof(unsigned int)};
+
+////////////////////////////////////////////////////////////////////// MeshCache
+
+MeshCache::MeshCache() : Directory("mesh-cache"), Enabled(true) {}
+
+MeshCache::~MeshCache() {}
+
+MeshCache &MeshCache::getInstance() {
+  static MeshCache instance;
+  return instance;
+}
+
+void MeshCache::setDirectory(const std::string &directory) {
+  Directory = directory;
+}
+
+void MeshCache::setEnabled(bool enabled) { Enabled = enabled; }
+
+bool MeshCache::isEnabled() { return Enabled; }
+
+bool MeshCache::getKey(const std::string &source, unsigned int assimpFlags,
+                       unsigned int atlasSize, bool vertexOrder,
+                       unsigned int levels, Key &key) {
+  std::error_code error;
+  const std::uintmax_t size = std::filesystem::file_size(source, error);
+  if (error) return false;
+  const auto time = std::filesystem::last_write_time(source, error);
+  if (error) return false;
+  key.sourceSize = size;
+  key.sourceTime = static_cast<std::uint64_t>(time.time_since_epoch().count());
+  key.assimpFlags = assimpFlags;
+  key.atlasSize = atlasSize;
+  key.vertexOrder = vertexOrder;
+  key.levels = levels;
+  return true;
+}
+
+static bool operator==(const MeshCache::Key &a, const MeshCache::Key &b) {
+  return a.sourceSize == b.sourceSize && a.sourceTime == b.sourceTime &&
+         a.assimpFlags == b.assimpFlags && a.atlasSize == b.atlasSize &&
+         a.vertexOrder == b.vertexOrder && a.levels == b.levels;
+}
+
+// FNV-1a of the absolute source path and the processing, a source loaded with
+// other flags gets a file of its own
+std::string MeshCache::getFilename(const std::string &source, const Key &key) {
+  std::error_code error;
+  std::string path = std::filesystem::absolute(source, error).string();
+  if (error) path = source;
+  std::uint64_t hash = 14695981039346656037ull;
+  auto add = [&hash](unsigned char byte) {
+    hash ^= byte;
+    hash *= 1099511628211ull;
+  };
+  for (char c : path) add(static_cast<unsigned char>(c));
+  for (std::uint32_t field :
+       {key.assimpFlags, key.atlasSize, key.vertexOrder, key.levels}) {
+    for (int byte = 0; byte < 4; byte++) add((field >> (8 * byte)) & 0xFF);
+  }
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.mglmesh",
+                static_cast<unsigned long long>(hash));
+  return (std::filesystem::path(Directory) / name).string();
+}
+
+bool MeshCache::load(const std::string &source, const Key &key,
+                     MappedFile &file, Contents &contents) {
+  if (!Enabled || !file.open(getFilename(source, key))) return false;
+
+  const unsigned char *data = file.data();
+  const std::size_t size = file.size();
+  Header header;
+  if (size < sizeof(Header)) return false;
+  std::memcpy(&header, data, sizeof(Header));
+  bool valid = header.magic == MAGIC &&
+               header.formatVersion == FORMAT_VERSION && header.key == key &&
+               size >= sizeof(Header) + header.meshCount * sizeof(SubMesh);
+  for (int s = 0; s < STREAM_COUNT && valid; s++) {
+    valid = header.offsets[s] <= size &&
+            header.sizes[s] <= size - header.offsets[s] &&
+            header.offsets[s] % 16 == 0;
+  }
+  // whole elements, and a vertex stream other than the positions is empty or
+  // has an element per position, as Mesh::prepareBufferObjects reads them
+  const std::uint64_t vertexCount =
+      header.sizes[POSITIONS] / ELEMENT_SIZES[POSITIONS];
+  for (int s = 0; s < STREAM_COUNT && valid; s++) {
+    valid = header.sizes[s] % ELEMENT_SIZES[s] == 0 &&
+            (s == POSITIONS || s == INDICES || header.sizes[s] == 0 ||
+             header.sizes[s] == vertexCount * ELEMENT_SIZES[s]);
+  }
+  // the submeshes must stay within the index stream they are drawn from, and
+  // their indices, relative to the base vertex, within the vertices
+  const SubMesh *meshes =
+      reinterpret_cast<const SubMesh *>(data + sizeof(Header));
+  const unsigned int *indices =
+      reinterpret_cast<const unsigned int *>(data + header.offsets[INDICES]);
+  const std::uint64_t indexCount = header.sizes[INDICES] / sizeof(unsigned int);
+  for (std::uint32_t m = 0; m < header.meshCount && valid; m++) {
+    const SubMesh &mesh = meshes[m];
+    valid = std::uint64_t(mesh.baseIndex) + mesh.nIndices <= indexCount;
+    for (std::uint32_t i = 0; i < mesh.nIndices && valid; i++) {
+      valid = std::uint64_t(mesh.baseVertex) + indices[mesh.baseIndex + i] <
+              vertexCount;
+    }
+  }
+  if (!valid) {
+    file.close();
+    return false;
+  }
+
+  contents.meshCount = header.meshCount;
+  contents.meshes = meshes;
+  for (int s = 0; s < STREAM_COUNT; s++) {
+    contents.streams[s] = header.sizes[s] ? data + header.offsets[s] : nullptr;
+    contents.sizes[s] = static_cast<std::size_t>(header.sizes[s]);
+  }
+  return true;
+}
+
+bool MeshCache::store(const std::string &source, const Key &key,
+                      const Contents &contents) {
+  if (!Enabled) return false;
+
+  std::error_code error;
+  std::filesystem::create_directories(Directory, error);
+  if (error) return false;
+
+  Header header{};
+  header.magic = MAGIC;
+  header.formatVersion = FORMAT_VERSION;
+  header.key = key;
+  header.meshCount = contents.meshCount;
+  std::uint64_t offset = sizeof(Header) + contents.meshCount * sizeof(SubMesh);
+  for (int s = 0; s < STREAM_COUNT; s++) {
+    offset = (offset + 15) / 16 * 16;
+    header.offsets[s] = offset;
+    header.sizes[s] = contents.sizes[s];
+    offset += contents.sizes[s];
+  }
+
+  // written next to the final name and renamed, as VolumeCache::store
+  const std::string filename = getFilename(source, key);
+  const std::string temporary = filename + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    out.write(reinterpret_cast<const char *>(contents.meshes),
+              contents.meshCount * sizeof(SubMesh));
+    std::uint64_t written =
+        sizeof(Header) + contents.meshCount * sizeof(SubMesh);
+    const char padding[16] = {};
+    for (int s = 0; s < STREAM_COUNT; s++) {
+      out.write(padding, static_cast<std::streamsize>(header.offsets[s] - written));
+      out.write(static_cast<const char *>(contents.streams[s]),
+                static_cast<std::streamsize>(contents.sizes[s]));
+      written = header.offsets[s] + contents.sizes[s];
+    }
+    if (!out) {
+      std::cerr << "WARNING: Could not write " << temporary << std::endl;
+      return false;
+    }
+  }
+  std::filesystem::rename(temporary, filename, error);
+  return !error;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// On-disk cache for imported meshes
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_MESH_CACHE_HPP
+#define MGL_MESH_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "./mglVolumeCache.hpp"
+
+namespace mgl {
+
+class MeshCache;
+
+////////////////////////////////////////////////////////////////////// MeshCache
+
+// Meshes as Mesh::create leaves them after the import and its processing, so a
+// warm load maps the file and uploads the streams without running Assimp.
+// Files are named after a hash of the source path and the processing, and the
+// key in the header is checked against the source: a source written since, or
+// of another size, is imported again and the file replaced.
+// File layout: Header, Header::meshCount SubMesh, then the streams, each at
+// Header::offsets[s] (16 byte aligned) and Header::sizes[s] bytes long. The
+// table has the submeshes of every level (see Mesh::generateLevels).
+class MeshCache {
+ public:
+  struct Key {
+    std::uint64_t sourceSize = 0;
+    std::uint64_t sourceTime = 0;
+    std::uint32_t assimpFlags = 0;
+    std::uint32_t atlasSize = 0;
+    std::uint32_t vertexOrder = 0;
+    std::uint32_t levels = 0;
+  };
+
+  struct SubMesh {
+    std::uint32_t nIndices, baseIndex, baseVertex, level;
+  };
+
+  // Positions, normals, tangents and bitangents are glm::vec3, texcoords
+  // glm::vec2 and indices unsigned int. Streams a mesh has not are empty.
+  enum Stream {
+    POSITIONS,
+    NORMALS,
+    TEXCOORDS,
+    TANGENTS,
+    BITANGENTS,
+    INDICES,
+    STREAM_COUNT
+  };
+
+  struct Contents {
+    std::uint32_t meshCount = 0;
+    const SubMesh *meshes = nullptr;
+    const void *streams[STREAM_COUNT] = {};
+    std::size_t sizes[STREAM_COUNT] = {};
+  };
+
+  static MeshCache &getInstance();
+
+  void setDirectory(const std::string &directory);
+  void setEnabled(bool enabled);
+  bool isEnabled();
+
+  // False when the source cannot be read
+  static bool getKey(const std::string &source, unsigned int assimpFlags,
+                     unsigned int atlasSize, bool vertexOrder,
+                     unsigned int levels, Key &key);
+  std::string getFilename(const std::string &source, const Key &key);
+
+  // On success file keeps the mapping alive, contents point into it.
+  bool load(const std::string &source, const Key &key, MappedFile &file,
+            Contents &contents);
+  bool store(const std::string &source, const Key &key,
+             const Contents &contents);
+
+ private:
+  static const std::uint32_t MAGIC = 0x4d4c474d;  // "MGLM"
+  // Also bumped when Mesh processes the imported meshes differently
+  static const std::uint32_t FORMAT_VERSION = 4;
+
+  struct Header {
+    std::uint32_t magic;
+    std::uint32_t formatVersion;
+    Key key;
+    std::uint32_t meshCount;
+    std::uint32_t reserved;
+    std::uint64_t offsets[STREAM_COUNT];
+    std::uint64_t sizes[STREAM_COUNT];
+  };
+
+  std::string Directory;
+  bool Enabled;
+
+  MeshCache();
+  ~MeshCache();
+
+ public:
+  MeshCache(MeshCache const &) = delete;
+  void operator=(MeshCache const &) = delete;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_MESH_CACHE_HPP */
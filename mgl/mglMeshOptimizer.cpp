@@ -0,0 +1,471 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Vertex cache orders and simplification of indexed triangle meshes
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglMeshOptimizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <numeric>
+#include <tuple>
+#include <utility>
+
+namespace mgl {
+
+////////////////////////////////////////////////////////////////// MeshOptimizer
+
+MeshOptimizer::Statistics MeshOptimizer::analyzeVertexCache(
+    const unsigned int *indices, std::size_t count, unsigned int vertexCount) {
+  Statistics statistics;
+  if (count < 3 || vertexCount == 0) return statistics;
+
+  // a vertex is in the FIFO when fewer than CACHE_SIZE misses followed the
+  // one that brought it in, 0 is never
+  std::vector<std::size_t> inserted(vertexCount, 0);
+  std::vector<bool> used(vertexCount, false);
+  std::size_t misses = 0;
+  unsigned int usedCount = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    const unsigned int v = indices[i];
+    if (!inserted[v] || misses - inserted[v] >= CACHE_SIZE) {
+      misses++;
+      inserted[v] = misses;
+    }
+    if (!used[v]) {
+      used[v] = true;
+      usedCount++;
+    }
+  }
+  statistics.acmr = float(misses) / float(count / 3);
+  statistics.atvr = float(misses) / float(usedCount);
+  return statistics;
+}
+
+void MeshOptimizer::optimizeTriangleOrder(unsigned int *indices,
+                                          std::size_t count,
+                                          const glm::vec3 *positions,
+                                          unsigned int vertexCount) {
+  const std::size_t triangles = count / 3;
+  if (triangles < 2) return;
+
+  // the triangles around each vertex, and how many are not emitted yet
+  std::vector<unsigned int> live(vertexCount, 0);
+  for (std::size_t i = 0; i < triangles * 3; i++) live[indices[i]]++;
+  std::vector<std::size_t> first(vertexCount + 1, 0);
+  for (unsigned int v = 0; v < vertexCount; v++) {
+    first[v + 1] = first[v] + live[v];
+  }
+  std::vector<unsigned int> adjacency(first[vertexCount]);
+  {
+    std::vector<std::size_t> next(first.begin(), first.end() - 1);
+    for (std::size_t t = 0; t < triangles; t++) {
+      for (int c = 0; c < 3; c++) {
+        adjacency[next[indices[3 * t + c]]++] = static_cast<unsigned int>(t);
+      }
+    }
+  }
+
+  // Tipsify with a cache of CACHE_SIZE. Time advances as vertices enter the
+  // cache, the fanning vertex is the candidate that stays in it longest
+  // without being pushed out by its own remaining triangles.
+  const long k = CACHE_SIZE;
+  std::vector<long> cached(vertexCount, 0);
+  long time = k + 1;
+  std::vector<bool> emitted(triangles, false);
+  std::vector<unsigned int> deadEnds, candidates;
+  std::vector<unsigned int> order;
+  std::vector<std::size_t> clusters;
+  order.reserve(triangles);
+  unsigned int cursor = 0;
+  long fanning = 0;
+  clusters.push_back(0);
+  while (fanning >= 0) {
+    candidates.clear();
+    for (std::size_t a = first[fanning]; a < first[fanning + 1]; a++) {
+      const unsigned int t = adjacency[a];
+      if (emitted[t]) continue;
+      for (int c = 0; c < 3; c++) {
+        const unsigned int v = indices[3 * t + c];
+        deadEnds.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        if (time - cached[v] > k) cached[v] = time++;
+      }
+      emitted[t] = true;
+      order.push_back(t);
+    }
+
+    fanning = -1;
+    long best = -1;
+    for (unsigned int v : candidates) {
+      if (!live[v]) continue;
+      long priority = 0;
+      if (time - cached[v] + 2 * long(live[v]) <= k) {
+        priority = time - cached[v];
+      }
+      if (priority > best) {
+        best = priority;
+        fanning = v;
+      }
+    }
+    if (fanning >= 0) continue;
+    // a dead end: the most recent vertices with triangles left, else the
+    // next in index order. Either way the fan starts over and so does a
+    // cluster.
+    while (!deadEnds.empty() && fanning < 0) {
+      const unsigned int v = deadEnds.back();
+      deadEnds.pop_back();
+      if (live[v]) fanning = v;
+    }
+    while (fanning < 0 && cursor < vertexCount) {
+      if (live[cursor]) fanning = cursor;
+      cursor++;
+    }
+    if (fanning >= 0) clusters.push_back(order.size());
+  }
+  clusters.push_back(order.size());
+
+  // Long clusters are split further where the cache has warmed up: once the
+  // misses of a cluster so far drop to SPLIT_ACMR times the ACMR of the
+  // whole one, a cluster starting there with a cold cache costs about the
+  // same. A vertex is in the FIFO as in analyzeVertexCache, and not when it
+  // came in before the cache was last emptied at cold.
+  std::vector<std::size_t> inserted(vertexCount, 0);
+  std::size_t misses = 0, cold = 0;
+  auto miss = [&](unsigned int t) {
+    std::size_t count = 0;
+    for (int c = 0; c < 3; c++) {
+      std::size_t &in = inserted[indices[3 * t + c]];
+      if (in <= cold || misses - in >= CACHE_SIZE) {
+        in = ++misses;
+        count++;
+      }
+    }
+    return count;
+  };
+  std::vector<std::size_t> split;
+  for (std::size_t c = 0; c + 1 < clusters.size(); c++) {
+    const std::size_t begin = clusters[c], end = clusters[c + 1];
+    cold = misses;
+    std::size_t total = 0;
+    for (std::size_t o = begin; o < end; o++) total += miss(order[o]);
+    const float threshold = SPLIT_ACMR * float(total) / float(end - begin);
+    split.push_back(begin);
+    cold = misses;
+    std::size_t start = begin, running = 0;
+    for (std::size_t o = begin; o + 1 < end; o++) {
+      running += miss(order[o]);
+      if (float(running) <= threshold * float(o + 1 - start)) {
+        split.push_back(o + 1);
+        start = o + 1;
+        running = 0;
+        cold = misses;
+      }
+    }
+  }
+  split.push_back(order.size());
+  clusters.swap(split);
+
+  // clusters sorted by how far their plane is out of the center of the mesh,
+  // with the areas as weights
+  auto triangleNormal = [&](unsigned int t) {
+    const glm::vec3 &a = positions[indices[3 * t]];
+    return glm::cross(positions[indices[3 * t + 1]] - a,
+                      positions[indices[3 * t + 2]] - a);
+  };
+  auto triangleCenter = [&](unsigned int t) {
+    return (positions[indices[3 * t]] + positions[indices[3 * t + 1]] +
+            positions[indices[3 * t + 2]]) /
+           3.0f;
+  };
+  glm::vec3 meshCenter(0.0f);
+  float meshArea = 0.0f;
+  for (unsigned int t = 0; t < triangles; t++) {
+    const float area = glm::length(triangleNormal(t));
+    meshCenter += area * triangleCenter(t);
+    meshArea += area;
+  }
+  if (meshArea > 0.0f) meshCenter /= meshArea;
+
+  const std::size_t clusterCount = clusters.size() - 1;
+  std::vector<float> distances(clusterCount, 0.0f);
+  for (std::size_t c = 0; c < clusterCount; c++) {
+    glm::vec3 center(0.0f), normal(0.0f);
+    float area = 0.0f;
+    for (std::size_t o = clusters[c]; o < clusters[c + 1]; o++) {
+      const glm::vec3 n = triangleNormal(order[o]);
+      const float a = glm::length(n);
+      center += a * triangleCenter(order[o]);
+      normal += n;
+      area += a;
+    }
+    const float length = glm::length(normal);
+    if (area > 0.0f && length > 0.0f) {
+      distances[c] = glm::dot(center / area - meshCenter, normal / length);
+    }
+  }
+  std::vector<std::size_t> sorted(clusterCount);
+  std::iota(sorted.begin(), sorted.end(), std::size_t(0));
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [&](std::size_t a, std::size_t b) {
+                     return distances[a] > distances[b];
+                   });
+
+  std::vector<unsigned int> reordered;
+  reordered.reserve(triangles * 3);
+  for (std::size_t c : sorted) {
+    for (std::size_t o = clusters[c]; o < clusters[c + 1]; o++) {
+      reordered.insert(reordered.end(), indices + 3 * order[o],
+                       indices + 3 * order[o] + 3);
+    }
+  }
+  std::copy(reordered.begin(), reordered.end(), indices);
+}
+
+std::vector<unsigned int> MeshOptimizer::optimizeVertexFetch(
+    unsigned int *indices, std::size_t count, unsigned int vertexCount) {
+  const unsigned int unused = ~0u;
+  std::vector<unsigned int> remap(vertexCount, unused);
+  unsigned int next = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    unsigned int &v = remap[indices[i]];
+    if (v == unused) v = next++;
+    indices[i] = v;
+  }
+  for (unsigned int &v : remap) {
+    if (v == unused) v = next++;
+  }
+  return remap;
+}
+
+// Sum of squared distances to planes, the upper triangle of a 4x4 matrix
+struct Quadric {
+  double a[10] = {};
+
+  void addPlane(const glm::dvec3 &normal, double distance, double weight) {
+    const double p[4] = {normal.x, normal.y, normal.z, distance};
+    for (int i = 0, k = 0; i < 4; i++) {
+      for (int j = i; j < 4; j++) a[k++] += weight * p[i] * p[j];
+    }
+  }
+  void add(const Quadric &q) {
+    for (int k = 0; k < 10; k++) a[k] += q.a[k];
+  }
+  double error(const glm::vec3 &v) const {
+    const double p[4] = {v.x, v.y, v.z, 1.0};
+    double e = 0.0;
+    for (int i = 0, k = 0; i < 4; i++) {
+      for (int j = i; j < 4; j++) {
+        e += (i == j ? 1.0 : 2.0) * a[k++] * p[i] * p[j];
+      }
+    }
+    return std::max(e, 0.0);
+  }
+};
+
+std::vector<unsigned int> MeshOptimizer::simplify(
+    const unsigned int *indices, std::size_t count, const glm::vec3 *positions,
+    const glm::vec3 *normals, const glm::vec2 *texcoords,
+    unsigned int vertexCount, std::size_t targetCount, float maxError) {
+  // vertices at the same position collapse together
+  std::vector<unsigned int> classOf(vertexCount);
+  std::vector<glm::vec3> classPositions;
+  std::vector<std::vector<unsigned int>> classVertices;
+  {
+    std::map<std::tuple<float, float, float>, unsigned int> classes;
+    for (unsigned int v = 0; v < vertexCount; v++) {
+      const glm::vec3 &p = positions[v];
+      auto c = classes.emplace(std::make_tuple(p.x, p.y, p.z),
+                               (unsigned int)classPositions.size());
+      if (c.second) {
+        classPositions.push_back(p);
+        classVertices.emplace_back();
+      }
+      classOf[v] = c.first->second;
+      classVertices[classOf[v]].push_back(v);
+    }
+  }
+  const unsigned int classCount = (unsigned int)classPositions.size();
+
+  std::vector<std::array<unsigned int, 3>> triangles(count / 3);
+  std::vector<bool> alive(triangles.size(), true);
+  for (std::size_t t = 0; t < triangles.size(); t++) {
+    triangles[t] = {indices[3 * t], indices[3 * t + 1], indices[3 * t + 2]};
+  }
+  auto corner = [&](std::size_t t, int c) { return classOf[triangles[t][c]]; };
+  // triangles with two corners at one position cover nothing
+  std::size_t liveTriangles = triangles.size();
+  for (std::size_t t = 0; t < triangles.size(); t++) {
+    if (corner(t, 0) == corner(t, 1) || corner(t, 1) == corner(t, 2) ||
+        corner(t, 2) == corner(t, 0)) {
+      alive[t] = false;
+      liveTriangles--;
+    }
+  }
+  auto faceNormal = [&](std::size_t t, unsigned int moved,
+                        const glm::vec3 &to) {
+    glm::vec3 p[3];
+    for (int c = 0; c < 3; c++) {
+      p[c] = corner(t, c) == moved ? to : classPositions[corner(t, c)];
+    }
+    return glm::cross(p[1] - p[0], p[2] - p[0]);
+  };
+
+  // the planes of the triangles around each position, and planes across the
+  // open edges so that borders keep their place
+  std::vector<Quadric> quadrics(classCount);
+  std::map<std::pair<unsigned int, unsigned int>, int> edgeUses;
+  for (std::size_t t = 0; t < triangles.size(); t++) {
+    if (!alive[t]) continue;
+    const glm::dvec3 normal = glm::dvec3(faceNormal(t, classCount, {}));
+    const double length = glm::length(normal);
+    if (length == 0.0) continue;
+    const glm::dvec3 unit = normal / length;
+    const double distance =
+        -glm::dot(unit, glm::dvec3(classPositions[corner(t, 0)]));
+    for (int c = 0; c < 3; c++) {
+      quadrics[corner(t, c)].addPlane(unit, distance, 1.0);
+      const unsigned int a = corner(t, c), b = corner(t, (c + 1) % 3);
+      edgeUses[std::make_pair(std::min(a, b), std::max(a, b))]++;
+    }
+  }
+  for (std::size_t t = 0; t < triangles.size(); t++) {
+    if (!alive[t]) continue;
+    const glm::dvec3 normal = glm::dvec3(faceNormal(t, classCount, {}));
+    for (int c = 0; c < 3; c++) {
+      const unsigned int a = corner(t, c), b = corner(t, (c + 1) % 3);
+      if (edgeUses[std::make_pair(std::min(a, b), std::max(a, b))] != 1) {
+        continue;
+      }
+      const glm::dvec3 edge =
+          glm::dvec3(classPositions[b]) - glm::dvec3(classPositions[a]);
+      const glm::dvec3 across = glm::cross(edge, normal);
+      const double length = glm::length(across);
+      if (length == 0.0) continue;
+      const glm::dvec3 unit = across / length;
+      const double distance = -glm::dot(unit, glm::dvec3(classPositions[a]));
+      quadrics[a].addPlane(unit, distance, 1.0);
+      quadrics[b].addPlane(unit, distance, 1.0);
+    }
+  }
+
+  // the vertex at position to that a corner on vertex from becomes
+  auto wedge = [&](unsigned int from, unsigned int to) {
+    unsigned int best = classVertices[to][0];
+    float bestTexcoord = INFINITY, bestNormal = INFINITY;
+    for (unsigned int v : classVertices[to]) {
+      const float texcoord =
+          texcoords ? glm::length(texcoords[v] - texcoords[from]) : 0.0f;
+      const float normal =
+          normals ? glm::length(normals[v] - normals[from]) : 0.0f;
+      if (texcoord < bestTexcoord ||
+          (texcoord == bestTexcoord && normal < bestNormal)) {
+        best = v;
+        bestTexcoord = texcoord;
+        bestNormal = normal;
+      }
+    }
+    return best;
+  };
+
+  // In passes: the cheapest collapses first, each position changed at most
+  // once a pass so that the adjacency of the pass stays valid
+  const double maxCost = double(maxError) * double(maxError);
+  std::vector<std::vector<unsigned int>> around(classCount);
+  while (liveTriangles * 3 > targetCount) {
+    for (std::vector<unsigned int> &list : around) list.clear();
+    std::vector<std::pair<unsigned int, unsigned int>> edges;
+    for (std::size_t t = 0; t < triangles.size(); t++) {
+      if (!alive[t]) continue;
+      for (int c = 0; c < 3; c++) {
+        const unsigned int a = corner(t, c), b = corner(t, (c + 1) % 3);
+        around[a].push_back((unsigned int)t);
+        edges.emplace_back(std::min(a, b), std::max(a, b));
+      }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    struct Collapse {
+      double cost;
+      unsigned int from, to;
+    };
+    std::vector<Collapse> collapses;
+    for (const auto &edge : edges) {
+      Quadric q = quadrics[edge.first];
+      q.add(quadrics[edge.second]);
+      const double first = q.error(classPositions[edge.first]);
+      const double second = q.error(classPositions[edge.second]);
+      const Collapse collapse = first < second
+                                    ? Collapse{first, edge.second, edge.first}
+                                    : Collapse{second, edge.first, edge.second};
+      if (collapse.cost <= maxCost) collapses.push_back(collapse);
+    }
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse &a, const Collapse &b) {
+                return a.cost < b.cost;
+              });
+
+    std::vector<bool> changed(classCount, false);
+    const std::size_t budget = liveTriangles - targetCount / 3;
+    std::size_t removed = 0;
+    for (const Collapse &collapse : collapses) {
+      if (removed >= budget) break;
+      if (changed[collapse.from] || changed[collapse.to]) continue;
+
+      // triangles that would turn over or fold stop the collapse
+      const glm::vec3 &to = classPositions[collapse.to];
+      bool folds = false;
+      for (unsigned int t : around[collapse.from]) {
+        bool shared = false;
+        for (int c = 0; c < 3; c++) shared |= corner(t, c) == collapse.to;
+        if (shared) continue;
+        const glm::vec3 before = faceNormal(t, classCount, {});
+        const glm::vec3 after = faceNormal(t, collapse.from, to);
+        if (glm::dot(before, after) <= 0.0f) {
+          folds = true;
+          break;
+        }
+      }
+      if (folds) continue;
+
+      for (unsigned int t : around[collapse.from]) {
+        bool shared = false;
+        for (int c = 0; c < 3; c++) shared |= corner(t, c) == collapse.to;
+        for (int c = 0; c < 3; c++) changed[corner(t, c)] = true;
+        if (shared) {
+          alive[t] = false;
+          removed++;
+          continue;
+        }
+        for (int c = 0; c < 3; c++) {
+          if (corner(t, c) == collapse.from) {
+            triangles[t][c] = wedge(triangles[t][c], collapse.to);
+          }
+        }
+      }
+      for (unsigned int t : around[collapse.to]) {
+        for (int c = 0; c < 3; c++) changed[corner(t, c)] = true;
+      }
+      quadrics[collapse.to].add(quadrics[collapse.from]);
+    }
+    if (!removed) break;
+    liveTriangles -= removed;
+  }
+
+  std::vector<unsigned int> simplified;
+  simplified.reserve(liveTriangles * 3);
+  for (std::size_t t = 0; t < triangles.size(); t++) {
+    if (alive[t]) {
+      simplified.insert(simplified.end(), triangles[t].begin(),
+                        triangles[t].end());
+    }
+  }
+  return simplified;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Vertex cache orders and simplification of indexed triangle meshes
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_MESH_OPTIMIZER_HPP
+#define MGL_MESH_OPTIMIZER_HPP
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace mgl {
+
+class MeshOptimizer;
+
+////////////////////////////////////////////////////////////////// MeshOptimizer
+
+// Works on the indexed triangles of one submesh: indices in [0, vertexCount)
+// of the vertices at positions, three per triangle.
+class MeshOptimizer {
+ public:
+  // Vertices the cache is assumed to hold, a FIFO as in most hardware
+  static const unsigned int CACHE_SIZE = 16;
+  // Ratio to the ACMR of a whole cluster that the misses of its start must
+  // come down to for optimizeTriangleOrder to split it there. Higher trades
+  // more cache misses for a finer overdraw order.
+  static constexpr float SPLIT_ACMR = 1.05f;
+
+  // Average cache miss ratio (transformed vertices per triangle, 0.5 at best
+  // on large meshes) and average transform to vertex ratio (1 at best)
+  struct Statistics {
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+  };
+  static Statistics analyzeVertexCache(const unsigned int *indices,
+                                       std::size_t count,
+                                       unsigned int vertexCount);
+
+  // Tipsify (Sander, Nehab and Barczak, 2007) fans around the vertices in the
+  // cache. The order is cut into clusters wherever it has to start over
+  // somewhere else, and long clusters again where the cache has warmed up
+  // (see SPLIT_ACMR). The clusters are drawn outermost first (by the distance
+  // of their plane to the center of the mesh), so that for most views near
+  // surfaces come first whatever the view.
+  static void optimizeTriangleOrder(unsigned int *indices, std::size_t count,
+                                    const glm::vec3 *positions,
+                                    unsigned int vertexCount);
+
+  // Numbers the vertices in the order the indices first use them, the unused
+  // ones last, and rewrites the indices. Returns the new index of every
+  // vertex, for the attribute streams.
+  static std::vector<unsigned int> optimizeVertexFetch(
+      unsigned int *indices, std::size_t count, unsigned int vertexCount);
+
+  // Quadric error edge collapses (Garland and Heckbert, 1997) until about
+  // targetCount indices are left or every collapse would move the surface by
+  // more than maxError. A vertex is only ever moved onto a neighbour, so the
+  // triangles returned index the same vertices. Vertices at the same position
+  // are one for the collapses, a corner moved onto a position with several of
+  // them takes the one with the nearest texcoords, then normal (either may be
+  // null).
+  static std::vector<unsigned int> simplify(
+      const unsigned int *indices, std::size_t count,
+      const glm::vec3 *positions, const glm::vec3 *normals,
+      const glm::vec2 *texcoords, unsigned int vertexCount,
+      std::size_t targetCount, float maxError);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_MESH_OPTIMIZER_HPP */
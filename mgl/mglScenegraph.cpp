@@ -4,6 +4,9 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 #include "./mglShader.hpp"
 #include "./mglMesh.hpp"
 
@@ -37,9 +40,17 @@ namespace mgl
 
 	void SceneGraph::renderScene(double elapsed) {
 		camera->updateRotation(elapsed);
+		selectLevels(root);
 		root->update(elapsed);
 	}
 
+	void SceneGraph::selectLevels(SceneNode* node) {
+		node->selectLevel(camera->getViewMatrix(), camera->getProjectionMatrix());
+		for (auto child : node->getChildren()) {
+			selectLevels(child);
+		}
+	}
+
 	void SceneGraph::drawNode(SceneNode* node) {
 		if (node->getMesh()) {
 			node->draw();
@@ -92,12 +103,19 @@ namespace mgl
 		Rotation = glm::quat(glm::angleAxis(glm::radians<float>(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
 		Scale = { 1.0f, 1.0f, 1.0f };
 
+		TextureOffset = { 0.0f, 0.0f, 0.0f };
+		TextureRotation = glm::quat(glm::angleAxis(glm::radians<float>(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+		TextureScale = { 1.0f, 1.0f, 1.0f };
+		updateTextureMatrix();
+
 		frameMovement = { 0.0f, 0.0f, 0.0f };
 		frameRotation = glm::quat(glm::angleAxis(glm::radians<float>(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
 
 		mesh = nullptr;
+		Level = 0;
 		shaderProgram = nullptr;
 		callback = nullptr;
+		textureInfo = nullptr;
 		sillouetteInfo = nullptr;
 
 		parent = nullptr;
@@ -163,6 +181,43 @@ namespace mgl
 		return Scale;
 	}
 
+	void SceneNode::setTextureOffset(glm::vec3 offset) {
+		TextureOffset = offset;
+		updateTextureMatrix();
+	}
+
+	const glm::vec3 SceneNode::getTextureOffset() {
+		return TextureOffset;
+	}
+
+	void SceneNode::setTextureRotation(glm::quat rotation) {
+		TextureRotation = rotation;
+		updateTextureMatrix();
+	}
+
+	const glm::quat SceneNode::getTextureRotation() {
+		return TextureRotation;
+	}
+
+	void SceneNode::setTextureScale(glm::vec3 scale) {
+		TextureScale = scale;
+		updateTextureMatrix();
+	}
+
+	const glm::vec3 SceneNode::getTextureScale() {
+		return TextureScale;
+	}
+
+	const glm::mat4 SceneNode::getTextureMatrix() {
+		return TextureMatrix;
+	}
+
+	// the vertex shaders map the mesh around (0.5, 0.5, 0.5), the middle of the volume
+	void SceneNode::updateTextureMatrix() {
+		const glm::vec3 center(0.5f);
+		TextureMatrix = glm::translate(center + TextureOffset) * glm::mat4(TextureRotation) * glm::scale(TextureScale) * glm::translate(-center);
+	}
+
 	void SceneNode::setNormalMatrix(glm::mat3 normalMatrix) {
 		NormalMatrix = normalMatrix;
 	}
@@ -185,6 +240,33 @@ namespace mgl
 		return meshName;
 	}
 
+	void SceneNode::selectLevel(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) {
+		if (!mesh || mesh->getLevelCount() < 2) {
+			Level = 0;
+			return;
+		}
+		const glm::vec3 center = glm::vec3(viewMatrix * ModelMatrix * glm::vec4(mesh->getBoundsCenter(), 1.0f));
+		const float scale = std::max({ glm::length(glm::vec3(ModelMatrix[0])), glm::length(glm::vec3(ModelMatrix[1])), glm::length(glm::vec3(ModelMatrix[2])) });
+		const float radius = mesh->getBoundsRadius() * scale;
+
+		// the NDC are 2 high, so the radius over the depth gives the fraction of the viewport
+		float size = radius * projectionMatrix[1][1];
+		if (projectionMatrix[2][3] != 0.0f) {
+			size = -center.z > radius ? size / -center.z : INFINITY;
+		}
+
+		// the triangles on screen stay about the same, their area halves each level
+		const float ideal = size > 0.0f ? 2.0f * std::log2(LEVEL_SCREEN_SIZE / size) : INFINITY;
+		if (ideal < Level - LEVEL_HYSTERESIS || ideal > Level + 1 + LEVEL_HYSTERESIS) {
+			const float last = float(mesh->getLevelCount() - 1);
+			Level = (unsigned int)std::max(0.0f, std::min(std::floor(ideal), last));
+		}
+	}
+
+	unsigned int SceneNode::getLevel() {
+		return Level;
+	}
+
 	ShaderProgram* SceneNode::getShaderProgram() {
 		return shaderProgram;
 	}
@@ -258,12 +340,18 @@ namespace mgl
 			setModelMatrix(parentModelMatrix * glm::translate(Position) * glm::mat4(Rotation) * glm::scale(Scale));
 
 			glUniformMatrix4fv(ModelMatrixId, 1, GL_FALSE, glm::value_ptr(ModelMatrix));
+			if (shaderProgram->isUniform(mgl::TEXTURE_MATRIX)) {
+				glUniformMatrix4fv(shaderProgram->Uniforms[mgl::TEXTURE_MATRIX].index, 1, GL_FALSE, glm::value_ptr(TextureMatrix));
+			}
+			if (shaderProgram->isUniform(mgl::DEQUANTIZATION_MATRIX)) {
+				glUniformMatrix4fv(shaderProgram->Uniforms[mgl::DEQUANTIZATION_MATRIX].index, 1, GL_FALSE, glm::value_ptr(mesh->getDequantizationMatrix()));
+			}
 			/* NormalMatrix is currently being calculated on shader, when changing this make sure you also uncomment it in the shaders, when creating the shaderProgram, when setting the model matrix and update it when changing the camera position
 			if (this->shaderProgram->isUniform(mgl::NORMAL_MATRIX)) {
 				glUniformMatrix3fv(this->shaderProgram->Uniforms[mgl::NORMAL_MATRIX].index, 1, GL_FALSE, glm::value_ptr(NormalMatrix));
 			}
 			*/
-			mesh->draw();
+			mesh->draw(Level);
 			shaderProgram->unbind();
 		}
 
@@ -331,8 +419,11 @@ namespace mgl
 
 			const glm::mat4 sillouetteMatrix = ModelMatrix * glm::scale(sillouetteInfo->scale);
 			glUniformMatrix4fv(sillouetteInfo->shaderProgram->Uniforms[mgl::MODEL_MATRIX].index, 1, GL_FALSE, glm::value_ptr(sillouetteMatrix));
+			if (sillouetteInfo->shaderProgram->isUniform(mgl::DEQUANTIZATION_MATRIX)) {
+				glUniformMatrix4fv(sillouetteInfo->shaderProgram->Uniforms[mgl::DEQUANTIZATION_MATRIX].index, 1, GL_FALSE, glm::value_ptr(mesh->getDequantizationMatrix()));
+			}
 
-			mesh->draw();
+			mesh->draw(Level);
 
 			sillouetteInfo->shaderProgram->unbind();
 		}
@@ -351,6 +442,9 @@ namespace mgl
 		node_json["Position"] = glm::to_string(Position);
 		node_json["Rotation"] = glm::to_string(Rotation);
 		node_json["Scale"] = glm::to_string(Scale);
+		node_json["TextureOffset"] = glm::to_string(TextureOffset);
+		node_json["TextureRotation"] = glm::to_string(TextureRotation);
+		node_json["TextureScale"] = glm::to_string(TextureScale);
 		node_json["Mesh"] = meshName;
 		node_json["Shader"] = shaderProgramName;
 		node_json["Callback"] = callbackName;
@@ -376,6 +470,14 @@ namespace mgl
 		Rotation = aux::deserialize_quat(node_json["Rotation"].template get<std::string>());
 		
 		Scale = aux::deserialize_vec3(node_json["Scale"].template get<std::string>());
+
+		// scenes saved before texture transforms keep the identity
+		if (node_json.contains("TextureOffset")) {
+			TextureOffset = aux::deserialize_vec3(node_json["TextureOffset"].template get<std::string>());
+			TextureRotation = aux::deserialize_quat(node_json["TextureRotation"].template get<std::string>());
+			TextureScale = aux::deserialize_vec3(node_json["TextureScale"].template get<std::string>());
+			updateTextureMatrix();
+		}
 		
 		setMesh(node_json["Mesh"].template get<std::string>());
 		
@@ -57,6 +57,7 @@ public:
 	void renderScene(double elapsed);
 
 	void drawNode(SceneNode* node);
+	void selectLevels(SceneNode* node);
 
 	void serialize();
 	void deserialize();
@@ -77,11 +78,20 @@ private:
 	glm::quat Rotation;
 	glm::vec3 Scale;
 
+	// Transform of the texture coordinates about the center of the volume, so nodes
+	// sharing a volume sample different parts of it. Sent as TextureMatrix.
+	glm::vec3 TextureOffset;
+	glm::quat TextureRotation;
+	glm::vec3 TextureScale;
+	glm::mat4 TextureMatrix;
+
 	glm::vec3 frameMovement;
 	glm::quat frameRotation;
 
 	Mesh* mesh;
 	std::string meshName;
+	// level of detail of the mesh drawn, see selectLevel
+	unsigned int Level;
 	ShaderProgram* shaderProgram;
 	std::string shaderProgramName;
 	// when getting the shader get these
@@ -104,6 +114,12 @@ private:
 	// vector childs
 
 public:
+	// Bounds this height on screen, as a fraction of the viewport, and smaller
+	// take level 1. Each level after takes half of that area.
+	static constexpr float LEVEL_SCREEN_SIZE = 0.5f;
+	// Levels the ideal level has to go past those of the current one to change it
+	static constexpr float LEVEL_HYSTERESIS = 0.25f;
+
 	SceneNode(int nodeId);
 	virtual ~SceneNode();
 
@@ -117,6 +133,11 @@ public:
 	void setMesh(std::string meshName);
 	std::string getMeshName();
 
+	// Picks the level of the mesh from the height of its bounds on screen,
+	// with the model matrix of the last frame
+	void selectLevel(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+	unsigned int getLevel();
+
 	TextureInfo* getTextureInfo();
 	void setTextureInfo(std::string textureInfoName);
 	std::string getTextureInfoName();
@@ -130,6 +151,15 @@ public:
 	void setScale(glm::vec3 scale);
 	const glm::vec3 getScale();
 
+	// offset in units of the volume, rotation and scale about its center
+	void setTextureOffset(glm::vec3 offset);
+	const glm::vec3 getTextureOffset();
+	void setTextureRotation(glm::quat rotation);
+	const glm::quat getTextureRotation();
+	void setTextureScale(glm::vec3 scale);
+	const glm::vec3 getTextureScale();
+	const glm::mat4 getTextureMatrix();
+
 	ShaderProgram* getShaderProgram();
 	void setShaderProgram(std::string shaderProgramName);
 	std::string getShaderProgramName();
@@ -163,6 +193,9 @@ public:
 	void applyFrameTransformations(double elapsed);
 
 	void drawSillouette();
+
+private:
+	void updateTextureMatrix();
 };
 
 class PointLightNode : public SceneNode {
@@ -61,10 +61,38 @@ ShaderProgram::~ShaderProgram() {
   glDeleteProgram(ProgramId);
 }
 
+void ShaderProgram::addDefine(const std::string &name,
+                              const std::string &value) {
+  Defines[name] = value;
+}
+
+void ShaderProgram::addInclude(const GLenum shader_type,
+                               const std::string &filename) {
+  Includes[shader_type].push_back(filename);
+}
+
+const std::string ShaderProgram::preprocess(const GLenum shader_type,
+                                            const std::string &code) {
+  std::string prefix;
+  for (auto &d : Defines) {
+    prefix += "#define " + d.first + " " + d.second + "\n";
+  }
+  for (auto &filename : Includes[shader_type]) {
+    prefix += read(filename);
+  }
+  if (prefix.empty()) return code;
+  // #version has to stay the first statement of the shader, read() ends
+  // every line with a newline
+  std::size_t version = code.find("#version");
+  std::size_t line =
+      version == std::string::npos ? 0 : code.find('\n', version) + 1;
+  return code.substr(0, line) + prefix + code.substr(line);
+}
+
 void ShaderProgram::addShader(const GLenum shader_type,
                               const std::string &filename) {
   const GLuint shader_id = glCreateShader(shader_type);
-  const std::string scode = read(filename);
+  const std::string scode = preprocess(shader_type, read(filename));
   const GLchar *code = scode.c_str();
   glShaderSource(shader_id, 1, &code, 0);
   glCompileShader(shader_id);
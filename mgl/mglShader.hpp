@@ -14,6 +14,7 @@
 #include <iostream>
 #include <map>
 #include <string>
+#include <vector>
 
 namespace mgl {
 
@@ -46,8 +47,15 @@ class ShaderProgram {
   };
   std::map<std::string, UboInfo> Ubos;
 
+  // Defined in every shader added after the call, right after its #version line
+  std::map<std::string, std::string> Defines;
+  // Sources pasted after the defines of the next shaders of that type
+  std::map<GLenum, std::vector<std::string>> Includes;
+
   ShaderProgram();
   ~ShaderProgram();
+  void addDefine(const std::string &name, const std::string &value = "");
+  void addInclude(const GLenum shader_type, const std::string &filename);
   void addShader(const GLenum shader_type, const std::string &filename);
   void addAttribute(const std::string &name, const GLuint index);
   bool isAttribute(const std::string &name);
@@ -61,6 +69,8 @@ class ShaderProgram {
 
  private:
   const std::string read(const std::string &filename);
+  const std::string preprocess(const GLenum shader_type,
+                               const std::string &code);
   const GLuint checkCompilation(const GLuint shader_id,
                                 const std::string &filename);
   void checkLinkage();
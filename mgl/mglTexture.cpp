@@ -1,7 +1,18 @@
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
 
 #include "mglTexture.hpp"
+#include "mglAtlas.hpp"
+#include "mglCompression.hpp"
+#include "mglConventions.hpp"
+#include "mglTextureGraph.hpp"
+#include "fractalNoise.hpp"
 #include "perlinNoise.hpp"
 #include "stb_image.h"
 
@@ -25,6 +36,9 @@ void TextureInfo::updateShader(ShaderProgram *shader) {
   if (sampler)
     sampler->bind(index);
   glUniform1i(shader->Uniforms[uniform].index, index);
+  if (shader->isUniform(TEXCOORD_SCALE))
+    glUniform1f(shader->Uniforms[TEXCOORD_SCALE].index, texcoordScale);
+  texture->updateShader(shader);
 }
 
 //////////////////////////////////////////////////////////////////////// Texture
@@ -44,20 +58,29 @@ void Texture2D::bind() { glBindTexture(GL_TEXTURE_2D, id); }
 void Texture2D::unbind() { glBindTexture(GL_TEXTURE_2D, 0); }
 
 void Texture2D::load(const std::string &filename) {
-
-  stbi_set_flip_vertically_on_load(true);
-  int width, height, channels;
-  std::cout << "Loading image file " << filename << "... ";
-  unsigned char *image =
-      stbi_load(filename.c_str(), &width, &height, &channels, 0);
-  assert(channels == 4);
-  if (image == nullptr) {
-    std::cout << "error." << std::endl;
+  try {
+    read(filename);
+  } catch (const std::runtime_error &error) {
+    std::cerr << "ERROR: " << error.what() << std::endl;
     exit(EXIT_FAILURE);
-  } else {
-    std::cout << "ok. " << std::endl;
   }
+  std::cout << "Loaded image file " << filename << std::endl;
+  upload();
+}
 
+void Texture2D::read(const std::string &filename) {
+
+  // per thread, images may be read on several at once
+  stbi_set_flip_vertically_on_load_thread(true);
+  int channels;
+  Image = stbi_load(filename.c_str(), &Width, &Height, &channels, 0);
+  if (Image == nullptr) {
+    throw std::runtime_error("Could not load image file " + filename);
+  }
+  assert(channels == 4);
+}
+
+void Texture2D::upload() {
   glGenTextures(1, &id);
   glBindTexture(GL_TEXTURE_2D, id);
 
@@ -85,38 +108,32 @@ void Texture2D::load(const std::string &filename) {
   //                GL_LINEAR_MIPMAP_LINEAR);
   // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
-               GL_UNSIGNED_BYTE, image);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, Width, Height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, Image);
   // syntax: glTexImage2D(target, level, internalformat, width, height, border,
   // format, type, data)
 
   glGenerateMipmap(GL_TEXTURE_2D);
   glBindTexture(GL_TEXTURE_2D, 0);
 
-  stbi_image_free(image);
+  stbi_image_free(Image);
+  Image = nullptr;
 }
 
-double harmonicNoise(PerlinNoiseGenerator* perlinNoise, int numberOctaves, float b, float a, double x, double y, double z) {
-    double endNoise = 0;
-    float totalAmplitude = 0.0;
-
-    for (int i = 0; i < numberOctaves; ++i) {
-        float amplitude = glm::pow((float)a, (float)i);// 1 / 2 * i;
-        totalAmplitude += amplitude;
+// Octave parameters of the wood and marble recipes
+struct WoodRings { static constexpr float lacunarity = 2.0f, gain = 0.45f; };
+struct WoodGrain { static constexpr float lacunarity = 2.0f, gain = 0.9f; };
+struct MarbleVeins { static constexpr float lacunarity = 2.0f, gain = 0.6f; };
+
+// Fills xs[k] = scaleX * (first + k) / width and ys[k] = y for count samples,
+// one row of sample coordinates starting at column first
+static void fillRow(float* xs, float* ys, unsigned int first, unsigned int count, unsigned int width, float scaleX, float y) {
+    for (unsigned int k = 0; k < count; ++k) {
+        xs[k] = scaleX * ((float)(first + k) / (float)width);
+        ys[k] = y;
     }
-
-    for (int i = 0; i < numberOctaves; ++i) {
-        float frequency = glm::pow((float)b, (float)i); //2 * i;
-        float amplitude = glm::pow((float)a, (float)i);// 1 / 2 * i; //0.7
-
-        endNoise += perlinNoise->noise(frequency * x, frequency * y, z) * amplitude / totalAmplitude;
-    }
-
-    return endNoise;
 }
 
-
-
 void Texture2D::generatePerlinNoiseTexture(const unsigned int height, const unsigned int width) {
     // old texture generator here for nostalgia reasons
     // I don't generate any 2D textures to this code may not produce equal results to the 3D texture anymore
@@ -274,116 +291,1152 @@ void Texture2D::generatePerlinNoiseTexture(const unsigned int height, const unsi
     //delete[] noise;
 }
 
-void Texture3D::bind() { glBindTexture(GL_TEXTURE_3D, id); }
+// State of a full volume being generated by the workers. The jobs only touch this
+// struct, so it must outlive them: the destructor waits for every submitted job.
+struct Texture3D::Generation {
+    VolumeCache::Key key;
+    GLuint id = 0;
+    GLuint pboId[2] = { 0, 0 };
+    std::unique_ptr<NoiseGenerator> generator;
+    // the graph of each channel, kept alive here for the jobs, the planes point to them
+    std::vector<std::shared_ptr<const TextureGraph>> graphs;
+    std::vector<SlicePlanes> planes;
+    // the slices of a compressed volume before they are encoded
+    std::vector<GLubyte> volume;
+    // Every level, filled by the slice jobs: the BC4 blocks of a compressed volume, the
+    // texels of an uncompressed one (the volume is level 0). The slice jobs of an
+    // uncompressed volume filter the first chunkLevels mipmaps of their own slices.
+    std::vector<std::vector<GLubyte>> levels;
+    unsigned int chunkLevels = 0;
+    std::future<void> planesJob;
+    std::vector<std::future<void>> chunks;
+    unsigned int uploaded = 0;
+    // the mipmaps below the chunk levels, filtered once every slice is done
+    std::future<void> mipmapsJob;
+    bool mipmapsUploaded = false;
+
+    explicit Generation(const VolumeCache::Key& key) : key(key), generator(NoiseGenerator::create((NoiseGenerator::Backend)key.noise, key.seed)) {}
+    ~Generation() {
+        if (planesJob.valid()) planesJob.wait();
+        for (std::future<void>& chunk : chunks) {
+            if (chunk.valid()) chunk.wait();
+        }
+        if (mipmapsJob.valid()) mipmapsJob.wait();
+    }
+};
 
-void Texture3D::unbind() { glBindTexture(GL_TEXTURE_3D, 0); }
+Texture3D::Texture3D() {}
 
-void Texture3D::generatePerlinNoiseTexture(unsigned int width, unsigned int height, unsigned int depth, Texture3D::Type type) {
-    glGenTextures(1, &id);
-    glBindTexture(GL_TEXTURE_3D, id);
+Texture3D::~Texture3D() {
+    if (pending) {
+        glDeleteBuffers(2, pending->pboId);
+        glDeleteTextures(1, &pending->id);
+    }
+}
 
-    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+void Texture3D::bind() { glBindTexture(getTarget(), id); }
 
-    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+void Texture3D::unbind() { glBindTexture(getTarget(), 0); }
 
-    glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, width, height, depth, 0, GL_RED,
-        GL_UNSIGNED_BYTE, 0);
+void Texture3D::setCompression(Compression compression) { this->compression = compression; }
 
-    PerlinNoiseGenerator* perlinNoise = new PerlinNoiseGenerator();
+Texture3D::Compression Texture3D::getCompression() { return compression; }
+
+GLenum Texture3D::getTarget() { return compression == BC4 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_3D; }
+
+void Texture3D::setNoise(NoiseGenerator::Backend noise) { this->noise = noise; }
+
+NoiseGenerator::Backend Texture3D::getNoise() { return noise; }
+
+void Texture3D::setGraph(std::shared_ptr<const TextureGraph> graph) { this->graph = graph; }
+
+void Texture3D::setGradient(bool gradient) { this->gradient = gradient; }
+
+bool Texture3D::getGradient() { return gradient; }
+
+void Texture3D::addChannel(Type type, std::shared_ptr<const TextureGraph> graph) {
+    if (channels.size() + 1 >= MAX_CHANNELS) {
+        std::cerr << "WARNING: A volume packs at most " << MAX_CHANNELS << " materials, ignoring the channel" << std::endl;
+        return;
+    }
+    channels.push_back({ type, graph });
+}
+
+unsigned int Texture3D::getChannelCount() { return (unsigned int)channels.size() + 1; }
+
+GLuint Texture3D::createTexture(GLenum target) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(target, texture);
+
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_REPEAT);
 
-    if (type == WOOD) {
-        for (int d = 0; d < depth; ++d) {
-            generateWoodSublevel(perlinNoise, width, height, depth, d);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return texture;
+}
+
+static unsigned int mipLevelCount(unsigned int width, unsigned int height, unsigned int depth) {
+    unsigned int size = std::max(width, std::max(height, depth));
+    unsigned int levels = 1;
+    while (size > 1) {
+        size /= 2;
+        levels++;
+    }
+    return levels;
+}
+
+static GLenum volumeTarget(const VolumeCache::Key& key) {
+    return key.compression == Texture3D::BC4 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_3D;
+}
+
+// The layers of a compressed volume are mipmapped in 2D, their count never changes
+static unsigned int levelCount(const VolumeCache::Key& key) {
+    if (key.compression == Texture3D::BC4) {
+        return mipLevelCount(key.width, key.height, 1);
+    }
+    return mipLevelCount(key.width, key.height, key.depth);
+}
+
+// Bytes and pixel format of the texels of an uncompressed volume, three channels are padded to four
+static unsigned int texelSize(const VolumeCache::Key& key) {
+    return key.gradient || key.channels > 2 ? 4 : key.channels;
+}
+
+static GLenum texelFormat(const VolumeCache::Key& key) {
+    const GLenum formats[] = { GL_RED, GL_RG, GL_RGBA, GL_RGBA };
+    return formats[texelSize(key) - 1];
+}
+
+static GLenum texelInternalFormat(const VolumeCache::Key& key) {
+    const GLenum formats[] = { GL_R8, GL_RG8, GL_RGBA8, GL_RGBA8 };
+    return formats[texelSize(key) - 1];
+}
+
+static VolumeCache::Level levelShape(const VolumeCache::Key& key, unsigned int l) {
+    VolumeCache::Level level;
+    level.width = std::max(1u, key.width >> l);
+    level.height = std::max(1u, key.height >> l);
+    if (key.compression == Texture3D::BC4) {
+        level.depth = key.depth;
+        level.size = bc4Size(level.width, level.height) * level.depth;
+    }
+    else {
+        level.depth = std::max(1u, key.depth >> l);
+        level.size = (size_t)level.width * level.height * level.depth * texelSize(key);
+    }
+    level.data = nullptr;
+    return level;
+}
+
+static std::vector<std::vector<GLubyte>> levelBuffers(const VolumeCache::Key& key) {
+    std::vector<std::vector<GLubyte>> levels(levelCount(key));
+    for (unsigned int l = 0; l < levels.size(); ++l) {
+        levels[l].resize(levelShape(key, l).size);
+    }
+    return levels;
+}
+
+// Mipmap levels a job of SLICES_PER_JOB slices of an uncompressed volume can filter on its
+// own: down to the level its slices shrink to one, every 2x2x2 block of those lies in the
+// job. Only when the depth is a whole number of jobs, otherwise none.
+static unsigned int chunkMipLevels(const VolumeCache::Key& key) {
+    if (key.compression == Texture3D::BC4 || key.depth % Texture3D::SLICES_PER_JOB != 0) {
+        return 0;
+    }
+    unsigned int levels = 0;
+    while ((2u << levels) <= Texture3D::SLICES_PER_JOB && levels + 1 < levelCount(key)) {
+        levels++;
+    }
+    return levels;
+}
+
+// Filters levels [firstLevel, levels.size()) of an uncompressed volume, each from the one above
+static void generateMipmaps(const VolumeCache::Key& key, std::vector<std::vector<GLubyte>>& levels, unsigned int firstLevel) {
+    for (unsigned int l = std::max(1u, firstLevel); l < levels.size(); ++l) {
+        VolumeCache::Level above = levelShape(key, l - 1);
+        Texture3D::downsampleLevel(levels[l - 1].data(), above.width, above.height, above.depth,
+            0, levelShape(key, l).depth, levels[l].data(), texelSize(key));
+    }
+}
+
+// Specifies level l of the bound texture, a null data only allocates it
+static void specifyLevel(const VolumeCache::Key& key, unsigned int l, const GLubyte* data) {
+    VolumeCache::Level level = levelShape(key, l);
+    if (key.compression == Texture3D::BC4) {
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, l, GL_COMPRESSED_RED_RGTC1, level.width, level.height, level.depth, 0,
+            (GLsizei)level.size, data);
+    }
+    else {
+        glTexImage3D(GL_TEXTURE_3D, l, texelInternalFormat(key), level.width, level.height, level.depth, 0,
+            texelFormat(key), GL_UNSIGNED_BYTE, data);
+    }
+}
+
+#ifdef DEBUG
+// Decodes level 0 back and compares it with the volume it was encoded from
+static void checkCompression(const VolumeCache::Key& key, const std::vector<GLubyte>& volume, const std::vector<GLubyte>& blocks) {
+    const size_t sliceSize = (size_t)key.width * key.height;
+    const size_t layerSize = bc4Size(key.width, key.height);
+    std::vector<GLubyte> decoded(volume.size());
+    for (unsigned int d = 0; d < key.depth; ++d) {
+        decodeBC4(&blocks[layerSize * d], key.width, key.height, &decoded[sliceSize * d]);
+    }
+    double quality = psnr(volume.data(), decoded.data(), volume.size());
+    std::cout << "Compressed volume PSNR " << quality << " dB" << std::endl;
+    if (quality < Texture3D::MIN_PSNR && std::min({key.width, key.height, key.depth}) >= Texture3D::MIN_PSNR_SIZE) {
+        std::cerr << "WARNING: Compressed volume below " << Texture3D::MIN_PSNR << " dB" << std::endl;
+    }
+}
+#endif
+
+void Texture3D::compressSlice(const GLubyte* slice, unsigned int width, unsigned int height, unsigned int layer, std::vector<std::vector<GLubyte>>& levels) {
+    std::vector<GLubyte> image(slice, slice + (size_t)width * height), smaller;
+    for (unsigned int l = 0; l < levels.size(); ++l) {
+        encodeBC4(image.data(), width, height, &levels[l][bc4Size(width, height) * layer]);
+        if (l + 1 == levels.size()) {
+            break;
         }
+
+        // 2x2 box filter, the last row or column of an odd side is reused
+        unsigned int smallerWidth = std::max(1u, width / 2);
+        unsigned int smallerHeight = std::max(1u, height / 2);
+        smaller.resize((size_t)smallerWidth * smallerHeight);
+        for (unsigned int i = 0; i < smallerHeight; ++i) {
+            const GLubyte* row0 = &image[(size_t)std::min(2 * i, height - 1) * width];
+            const GLubyte* row1 = &image[(size_t)std::min(2 * i + 1, height - 1) * width];
+            for (unsigned int j = 0; j < smallerWidth; ++j) {
+                unsigned int j0 = std::min(2 * j, width - 1), j1 = std::min(2 * j + 1, width - 1);
+                smaller[(size_t)i * smallerWidth + j] = (GLubyte)((row0[j0] + row0[j1] + row1[j0] + row1[j1] + 2) / 4);
+            }
+        }
+        image.swap(smaller);
+        width = smallerWidth;
+        height = smallerHeight;
     }
-    else if (type == MARBLE) {
-        for (int d = 0; d < depth; ++d) {
-            generateMarbleSublevel(perlinNoise, width, height, depth, d);
+}
+
+void Texture3D::downsampleLevel(const GLubyte* level, unsigned int width, unsigned int height, unsigned int depth, unsigned int firstSlice, unsigned int lastSlice, GLubyte* smaller, unsigned int components) {
+    const unsigned int smallerWidth = std::max(1u, width / 2);
+    const unsigned int smallerHeight = std::max(1u, height / 2);
+    const size_t rowSize = (size_t)width * components;
+    const size_t sliceSize = rowSize * height;
+    // the byte offsets of the columns of each output texel, computed once for every row
+    std::vector<unsigned int> j0(smallerWidth), j1(smallerWidth);
+    for (unsigned int j = 0; j < smallerWidth; ++j) {
+        j0[j] = std::min(2 * j, width - 1) * components;
+        j1[j] = std::min(2 * j + 1, width - 1) * components;
+    }
+
+    for (unsigned int k = firstSlice; k < lastSlice; ++k) {
+        const GLubyte* slice0 = level + sliceSize * std::min(2 * k, depth - 1);
+        const GLubyte* slice1 = level + sliceSize * std::min(2 * k + 1, depth - 1);
+        GLubyte* out = smaller + (size_t)smallerWidth * smallerHeight * components * k;
+        for (unsigned int i = 0; i < smallerHeight; ++i) {
+            const size_t row0 = std::min(2 * i, height - 1) * rowSize;
+            const size_t row1 = std::min(2 * i + 1, height - 1) * rowSize;
+            const GLubyte* a = slice0 + row0;
+            const GLubyte* b = slice0 + row1;
+            const GLubyte* c = slice1 + row0;
+            const GLubyte* d = slice1 + row1;
+            for (unsigned int j = 0; j < smallerWidth; ++j) {
+                for (unsigned int e = 0; e < components; ++e) {
+                    unsigned int sum = a[j0[j] + e] + a[j1[j] + e] + b[j0[j] + e] + b[j1[j] + e] + c[j0[j] + e] + c[j1[j] + e] + d[j0[j] + e] + d[j1[j] + e];
+                    *out++ = (GLubyte)((sum + 4) / 8);
+                }
+            }
         }
     }
+}
 
-    glGenerateMipmap(GL_TEXTURE_3D);
-    glBindTexture(GL_TEXTURE_3D, 0);
+bool Texture3D::loadCachedTexture(const VolumeCache::Key& key) {
+    MappedFile file;
+    std::vector<VolumeCache::Level> levels;
+    if (!VolumeCache::getInstance().load(key, file, levels)) {
+        return false;
+    }
+    for (unsigned int l = 0; l < levels.size(); ++l) {
+        VolumeCache::Level shape = levelShape(key, l);
+        if (levels[l].width != shape.width || levels[l].height != shape.height || levels[l].depth != shape.depth ||
+            levels[l].size != shape.size) {
+            return false;
+        }
+    }
+
+    GLenum target = volumeTarget(key);
+    id = createTexture(target);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned int l = 0; l < levels.size(); ++l) {
+        specifyLevel(key, l, levels[l].data);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+    glBindTexture(target, 0);
+
+#ifdef DEBUG
+    std::cout << "Loaded cached volume " << VolumeCache::getInstance().getFilename(key) << std::endl;
+#endif
+    return true;
 }
 
-void Texture3D::generateWoodSublevel(PerlinNoiseGenerator* perlinNoise, unsigned int width, unsigned int height, unsigned int depth, unsigned int level) {
-    std::vector<GLubyte> image(height * width * sizeof(GLubyte), 0);
+void Texture3D::storeCachedTexture(const VolumeCache::Key& key, std::vector<std::vector<GLubyte>>& levels) {
+    if (!VolumeCache::getInstance().isEnabled()) {
+        return;
+    }
 
-    for (int i = 0; i < height; ++i) {
-        for (int j = 0; j < width; ++j) {
-            double x = (double)j / ((double)width);
-            double y = (double)i / ((double)height);
-            double z = (double)level / ((double)depth);
+    // every level is generated on the CPU, they are taken over and written by a worker
+    auto mipmaps = std::make_shared<std::vector<std::vector<GLubyte>>>();
+    mipmaps->swap(levels);
+    std::vector<VolumeCache::Level> entries;
+    for (unsigned int l = 0; l < mipmaps->size(); ++l) {
+        VolumeCache::Level level = levelShape(key, l);
+        level.data = (*mipmaps)[l].data();
+        entries.push_back(level);
+    }
 
-            double xPeriod = 3.0; //defines repetition of marble lines in x direction
-            double yPeriod = 0.0; //defines repetition of marble lines in y direction
-            double turbPower = 1.0; //makes twists
-            double turbSize = 32.0; //initial size of the turbulence
+    ThreadPool::getInstance().submit([key, entries, mipmaps] {
+        VolumeCache::getInstance().store(key, entries);
+    });
+}
 
-            double n = harmonicNoise(perlinNoise, 4, 2, 0.45, 0.5 * x, 0.5 * y, z);
-            double normalizedN = (n + 1.0) / 2.0;
-            double xyValue = j * xPeriod / width + i * yPeriod / height + turbPower * normalizedN;
-            double zebraNoise = 256 * fabs(sin(xyValue * 3.14159));
+// The backend a volume is generated with, Perlin when the one asked for cannot tile it
+static NoiseGenerator::Backend volumeNoise(NoiseGenerator::Backend noise, unsigned int repeat) {
+    if (repeat > 1 && !NoiseGenerator::create(noise)->tiles()) {
+        std::cerr << "WARNING: Noise backend " << noise << " does not tile, using Perlin noise for a volume repeated " << repeat << " times" << std::endl;
+        return NoiseGenerator::PERLIN;
+    }
+    return noise;
+}
 
-            n = 20 * normalizedN;
-            n = n - floor(n);
+static VolumeCache::Key volumeKey(unsigned int width, unsigned int height, unsigned int depth, Texture3D::Type type, std::uint32_t seed, unsigned int repeat, Texture3D::Compression compression, NoiseGenerator::Backend noise, const TextureGraph* graph, bool gradient, const std::vector<Texture3D::Channel>& channels) {
+    VolumeCache::Key key;
+    key.type = type;
+    key.width = width;
+    key.height = height;
+    key.depth = depth;
+    key.generatorVersion = Texture3D::GENERATOR_VERSION;
+    key.seed = seed;
+    key.repeat = std::max(1u, repeat);
+    key.compression = compression;
+    key.noise = volumeNoise(noise, key.repeat);
+    key.graph = graph ? graph->getHash() : 0;
+    if (gradient && (compression != Texture3D::UNCOMPRESSED || graph)) {
+        std::cerr << "WARNING: Only uncompressed volumes of the built-in recipes store a gradient, generating one without" << std::endl;
+        gradient = false;
+    }
+    key.gradient = gradient;
+    if (!channels.empty() && (compression != Texture3D::UNCOMPRESSED || gradient)) {
+        std::cerr << "WARNING: Only uncompressed volumes without gradient pack materials, generating the first one" << std::endl;
+        return key;
+    }
+    key.channels = (std::uint32_t)channels.size() + 1;
+    for (size_t c = 0; c < channels.size(); ++c) {
+        key.packedTypes[c] = channels[c].type;
+        key.packedGraphs[c] = channels[c].graph ? channels[c].graph->getHash() : 0;
+    }
+    return key;
+}
 
-            double fineGrain = 2 * harmonicNoise(perlinNoise, 10, 2, 0.9, 1 * x, 4 * y, z);
-            double normalizedFN = (fineGrain + 1.0) / 2.0;
+// Type of the material in channel c of a volume
+static Texture3D::Type channelType(const VolumeCache::Key& key, unsigned int c) {
+    return (Texture3D::Type)(c == 0 ? key.type : key.packedTypes[c - 1]);
+}
 
-            double fineGrain3 = perlinNoise->noise(10 * x, 80 * y, 0.9);
-            double normalizedFN3 = (fineGrain3 + 1.0) / 2.0;
+// The graph of every channel of a volume, null for the recipes
+static std::vector<std::shared_ptr<const TextureGraph>> channelGraphs(const VolumeCache::Key& key, const std::shared_ptr<const TextureGraph>& graph, const std::vector<Texture3D::Channel>& channels) {
+    std::vector<std::shared_ptr<const TextureGraph>> graphs = { graph };
+    for (unsigned int c = 1; c < key.channels; ++c) {
+        graphs.push_back(channels[c - 1].graph);
+    }
+    return graphs;
+}
 
-            double fineGrain2 = perlinNoise->noise(256 * x, 256 * y, 0.8);
-            double normalizedFN2 = (fineGrain2 + 1.0) / 2.0;
+// The planes of every channel of a volume, then its slices [first, last) into volume
+static void generateVolumePlanes(const VolumeCache::Key& key, NoiseGenerator* generator, const std::vector<std::shared_ptr<const TextureGraph>>& graphs, std::vector<Texture3D::SlicePlanes>& planes) {
+    planes.resize(key.channels);
+    for (unsigned int c = 0; c < key.channels; ++c) {
+        Texture3D::generatePlanes(channelType(key, c), generator, key.width, key.height, key.repeat, planes[c], graphs[c].get(), key.gradient != 0);
+    }
+}
 
-            double thing = (1 - (normalizedFN * normalizedFN3)) * normalizedFN2;
-            double thing2 = (1 - (normalizedFN * normalizedFN3));
-            thing = thing > 0.2 ? 1.0 : thing;
-            thing2 = thing2 < 0.86 ? thing2 - (0.86 - thing2) * (0.0 - thing2) : thing2;
-            thing2 = thing2 < 0.86 ? 0.0 : thing2 - 1.0 * (1 - thing2);
+static void generateVolumeSlices(const VolumeCache::Key& key, NoiseGenerator* generator, const std::vector<Texture3D::SlicePlanes>& planes, unsigned int first, unsigned int last, GLubyte* volume) {
+    if (key.channels == 1) {
+        Texture3D::generateSlices((Texture3D::Type)key.type, generator, planes[0], key.depth, first, last, volume);
+        return;
+    }
+    std::vector<Texture3D::Type> types;
+    for (unsigned int c = 0; c < key.channels; ++c) {
+        types.push_back(channelType(key, c));
+    }
+    Texture3D::generatePackedSlices(types, generator, planes, key.depth, first, last, volume);
+}
+
+void Texture3D::generatePerlinNoiseTexture(unsigned int width, unsigned int height, unsigned int depth, Texture3D::Type type, std::uint32_t seed, unsigned int repeat) {
+    VolumeCache::Key key = volumeKey(width, height, depth, type, seed, repeat, compression, noise, graph.get(), gradient, channels);
+    if (loadCachedTexture(key)) {
+        return;
+    }
+    startGeneration(key);
+    uploadGeneration(0.0, true);
+}
 
-            image[i * width + j] = (GLubyte)floor((n * normalizedFN * (1 - thing2)) * 256);
+void Texture3D::generateProgressive(unsigned int width, unsigned int height, unsigned int depth, Texture3D::Type type, std::uint32_t seed, unsigned int repeat, unsigned int previewSize) {
+    VolumeCache::Key key = volumeKey(width, height, depth, type, seed, repeat, compression, noise, graph.get(), gradient, channels);
+    if (loadCachedTexture(key)) {
+        return;
+    }
+
+    // the preview is small enough to generate right here, without waiting
+    // behind the jobs other textures already queued on the workers
+    VolumeCache::Key previewKey = volumeKey(std::min(width, previewSize), std::min(height, previewSize), std::min(depth, previewSize),
+        type, seed, repeat, compression, (NoiseGenerator::Backend)key.noise, graph.get(), key.gradient, key.channels > 1 ? channels : std::vector<Channel>());
+    const size_t sliceSize = (size_t)previewKey.width * previewKey.height;
+    std::unique_ptr<NoiseGenerator> generator = NoiseGenerator::create((NoiseGenerator::Backend)key.noise, seed);
+    std::vector<SlicePlanes> planes;
+    std::vector<GLubyte> preview(sliceSize * previewKey.depth * texelSize(key));
+    generateVolumePlanes(previewKey, generator.get(), channelGraphs(previewKey, graph, channels), planes);
+    generateVolumeSlices(previewKey, generator.get(), planes, 0, previewKey.depth, preview.data());
+
+    GLenum target = volumeTarget(key);
+    id = createTexture(target);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    std::vector<std::vector<GLubyte>> levels = levelBuffers(previewKey);
+    if (compression == BC4) {
+        for (unsigned int d = 0; d < previewKey.depth; ++d) {
+            compressSlice(&preview[sliceSize * d], previewKey.width, previewKey.height, d, levels);
         }
     }
+    else {
+        levels[0].swap(preview);
+        generateMipmaps(previewKey, levels, 1);
+    }
+    for (unsigned int l = 0; l < levels.size(); ++l) {
+        specifyLevel(previewKey, l, levels[l].data());
+    }
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(target, 0);
 
-    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, level, width, height, 1, GL_RED, GL_UNSIGNED_BYTE, (GLvoid*)image.data());
-    
+    startGeneration(key);
 }
 
-void Texture3D::generateMarbleSublevel(PerlinNoiseGenerator* perlinNoise, unsigned int width, unsigned int height, unsigned int depth, unsigned int level) {
-    std::vector<GLubyte> image(height * width * sizeof(GLubyte), 0);
+bool Texture3D::refine(double budget) {
+    return uploadGeneration(budget, false);
+}
 
-    for (int i = 0; i < height; ++i) {
-        for (int j = 0; j < width; ++j) {
-            double x = (double)j / ((double)width);
-            double y = (double)i / ((double)height);
-            double z = (double)level / ((double)depth);
+bool Texture3D::isRefined() { return !pending; }
 
-            double n = harmonicNoise(perlinNoise, 8, 2, 0.6, 2 * x, 2 * y, z); // 0.7
-            double normalizedN = (n + 1.0) / 2.0;
+void Texture3D::startGeneration(const VolumeCache::Key& key) {
+    pending.reset(new Generation(key));
+    Generation& generation = *pending;
+    generation.graphs = channelGraphs(key, graph, channels);
+    generation.levels = levelBuffers(key);
+    if (key.compression == BC4) {
+        generation.volume.resize((size_t)key.width * key.height * key.depth);
+    }
+    generation.chunkLevels = chunkMipLevels(key);
 
-            // marble
+    // the levels are all allocated up front, they are uploaded as they are generated
+    GLenum target = volumeTarget(key);
+    generation.id = createTexture(target);
+    for (unsigned int l = 0; l < generation.levels.size(); ++l) {
+        specifyLevel(key, l, nullptr);
+    }
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, (GLint)generation.levels.size() - 1);
+    glBindTexture(target, 0);
+    glGenBuffers(2, generation.pboId);
+
+    // the slice jobs are only submitted once the planes they read are done
+    generation.planesJob = ThreadPool::getInstance().submit([&generation] {
+        generateVolumePlanes(generation.key, generation.generator.get(), generation.graphs, generation.planes);
+    });
+}
+
+bool Texture3D::uploadGeneration(double budget, bool wait) {
+    if (!pending) {
+        return true;
+    }
+    Generation& generation = *pending;
+    const VolumeCache::Key& key = generation.key;
+    const unsigned int width = key.width, height = key.height, depth = key.depth;
+    const size_t sliceSize = (size_t)width * height;
+    const GLenum target = volumeTarget(key);
+
+    auto start = std::chrono::steady_clock::now();
+    auto ready = [wait](std::future<void>& job) {
+        return wait || job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    };
+    auto overBudget = [&]() {
+        return !wait && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > budget;
+    };
+
+    if (generation.chunks.empty()) {
+        if (!ready(generation.planesJob)) {
+            return false;
+        }
+        generation.planesJob.get();
+        for (unsigned int first = 0; first < depth; first += SLICES_PER_JOB) {
+            unsigned int last = std::min(first + SLICES_PER_JOB, depth);
+            generation.chunks.push_back(ThreadPool::getInstance().submit([=, &generation] {
+                if (generation.key.compression == BC4) {
+                    generateVolumeSlices(generation.key, generation.generator.get(), generation.planes, first, last, generation.volume.data());
+                    for (unsigned int d = first; d < last; ++d) {
+                        compressSlice(&generation.volume[sliceSize * d], width, height, d, generation.levels);
+                    }
+                    return;
+                }
+                generateVolumeSlices(generation.key, generation.generator.get(), generation.planes, first, last, generation.levels[0].data());
+                for (unsigned int l = 1; l <= generation.chunkLevels; ++l) {
+                    VolumeCache::Level above = levelShape(generation.key, l - 1);
+                    downsampleLevel(generation.levels[l - 1].data(), above.width, above.height, above.depth,
+                        first >> l, last >> l, generation.levels[l].data(), texelSize(generation.key));
+                }
+            }));
+        }
+    }
+
+    // The workers fill the volume buffer in chunks of slices while this thread,
+    // which owns the GL context, uploads every finished chunk in order. Each chunk
+    // is copied once, into a PBO mapped with its old contents invalidated so the map
+    // does not wait on the GPU. glTexSubImage3D then returns at once and the GPU reads
+    // the chunk from the PBO while the workers generate the next ones, the two PBOs
+    // alternate so the next map does not wait on that read. A compressed chunk
+    // carries the blocks of its layers at every level, an uncompressed one the slices
+    // of the mipmaps it filtered.
+    const bool compressed = key.compression == BC4;
+    const unsigned int chunkLevels = compressed ? (unsigned int)generation.levels.size() : generation.chunkLevels + 1;
+    glBindTexture(target, generation.id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    while (generation.uploaded < generation.chunks.size()) {
+        unsigned int c = generation.uploaded;
+        if (!ready(generation.chunks[c]) || overBudget()) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glBindTexture(target, 0);
+            return false;
+        }
+        unsigned int first = c * SLICES_PER_JOB;
+        unsigned int slices = std::min(SLICES_PER_JOB, depth - first);
+        generation.chunks[c].get();
+
+        // where the part of each level starts in its buffer and how long it is,
+        // the parts follow each other in the PBO
+        std::vector<size_t> starts(chunkLevels), sizes(chunkLevels), offsets(chunkLevels);
+        size_t chunkSize = 0;
+        for (unsigned int l = 0; l < chunkLevels; ++l) {
+            VolumeCache::Level level = levelShape(key, l);
+            if (compressed) {
+                size_t layerSize = bc4Size(level.width, level.height);
+                starts[l] = layerSize * first;
+                sizes[l] = layerSize * slices;
+            }
+            else {
+                size_t levelSliceSize = (size_t)level.width * level.height * texelSize(key);
+                starts[l] = levelSliceSize * (first >> l);
+                sizes[l] = levelSliceSize * (slices >> l);
+            }
+            offsets[l] = chunkSize;
+            chunkSize += sizes[l];
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, generation.pboId[c % 2]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, chunkSize, nullptr, GL_STREAM_DRAW);
+        GLubyte* mapped = (GLubyte*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, chunkSize,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped) {
+            for (unsigned int l = 0; l < chunkLevels; ++l) {
+                std::copy_n(&generation.levels[l][starts[l]], sizes[l], mapped + offsets[l]);
+            }
+        }
+        // a store lost while mapped (a mode switch) is filled again from the levels
+        if (!mapped || glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE) {
+            for (unsigned int l = 0; l < chunkLevels; ++l) {
+                glBufferSubData(GL_PIXEL_UNPACK_BUFFER, offsets[l], sizes[l], &generation.levels[l][starts[l]]);
+            }
+        }
+
+        for (unsigned int l = 0; l < chunkLevels; ++l) {
+            VolumeCache::Level level = levelShape(key, l);
+            if (compressed) {
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, first, level.width, level.height, slices,
+                    GL_COMPRESSED_RED_RGTC1, (GLsizei)sizes[l], (GLvoid*)offsets[l]);
+            }
+            else {
+                glTexSubImage3D(GL_TEXTURE_3D, l, 0, 0, first >> l, level.width, level.height, slices >> l,
+                    texelFormat(key), GL_UNSIGNED_BYTE, (GLvoid*)offsets[l]);
+            }
+        }
+        generation.uploaded++;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // The remaining mipmaps are small (an eighth of the volume at most, or a 512th when
+    // the chunks filtered three levels), one worker filters them while frames go on
+    if (key.compression != BC4 && !generation.mipmapsUploaded) {
+        if (!generation.mipmapsJob.valid()) {
+            generation.mipmapsJob = ThreadPool::getInstance().submit([&generation] {
+                generateMipmaps(generation.key, generation.levels, generation.chunkLevels + 1);
+            });
+        }
+        if (!ready(generation.mipmapsJob) || overBudget()) {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glBindTexture(target, 0);
+            return false;
+        }
+        generation.mipmapsJob.get();
+        for (unsigned int l = generation.chunkLevels + 1; l < generation.levels.size(); ++l) {
+            VolumeCache::Level level = levelShape(key, l);
+            glTexSubImage3D(GL_TEXTURE_3D, l, 0, 0, 0, level.width, level.height, level.depth,
+                texelFormat(key), GL_UNSIGNED_BYTE, generation.levels[l].data());
+        }
+        generation.mipmapsUploaded = true;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // the cache write goes to the next frame if this one is spent
+    if (overBudget()) {
+        glBindTexture(target, 0);
+        return false;
+    }
+#ifdef DEBUG
+    if (key.compression == BC4) {
+        checkCompression(key, generation.volume, generation.levels[0]);
+    }
+#endif
+    storeCachedTexture(key, generation.levels);
+    glBindTexture(target, 0);
+
+    // swap the full volume in, the preview (if any) is no longer needed
+    if (id != (GLuint)-1) {
+        glDeleteTextures(1, &id);
+    }
+    id = generation.id;
+    glDeleteBuffers(2, generation.pboId);
+    pending.reset();
+
+#ifdef DEBUG
+    std::cout << "Generated volume " << width << "x" << height << "x" << depth << std::endl;
+#endif
+    return true;
+}
+
+void Texture3D::generatePlanes(Type type, NoiseGenerator* generator, unsigned int width, unsigned int height, unsigned int repeat, SlicePlanes& planes, const TextureGraph* graph, bool gradient) {
+    if (graph) {
+        graph->generatePlanes(generator, width, height, repeat, planes);
+        planes.gradient = false;
+        return;
+    }
+    planes.graph = nullptr;
+    planes.width = width;
+    planes.height = height;
+    planes.repeat = repeat;
+    planes.plane.resize((size_t)width * height);
+    planes.gradient = gradient;
+    planes.planeGradient.resize(gradient ? 2 * planes.plane.size() : 0);
+    const NoiseTerm streaks(10.0f, 80.0f, 0.0f, repeat);
+
+    for (unsigned int i = 0; i < height; ++i) {
+        double* row = &planes.plane[(size_t)i * width];
+        double* rowGradient = gradient ? &planes.planeGradient[2 * (size_t)i * width] : nullptr;
+        if (type == WOOD) {
+            std::vector<float> xs(width), ys(width), zs(width, 0.9f), fineGrain3(width);
+            fillRow(xs.data(), ys.data(), 0, width, width, streaks.x, streaks.y * ((float)i / (float)height));
+            if (gradient) {
+                std::vector<float> dxs(width), dys(width), dzs(width);
+                streaks.noiseWithGradient(generator, xs.data(), ys.data(), zs.data(), fineGrain3.data(), dxs.data(), dys.data(), dzs.data(), width);
+                for (unsigned int j = 0; j < width; ++j) {
+                    rowGradient[2 * j] = streaks.x * dxs[j] / 2.0;
+                    rowGradient[2 * j + 1] = streaks.y * dys[j] / 2.0;
+                }
+            }
+            else {
+                streaks.noise(generator, xs.data(), ys.data(), zs.data(), fineGrain3.data(), width);
+            }
+            for (unsigned int j = 0; j < width; ++j) {
+                row[j] = (fineGrain3[j] + 1.0) / 2.0;
+            }
+        }
+        else if (type == MARBLE) {
             double xPeriod = 0.5; //defines repetition of marble lines in x direction 0.0
             double yPeriod = 1.0; //defines repetition of marble lines in y direction 10.0
-            //turbPower = 0 ==> it becomes a normal sine pattern
-            double turbPower = 5.0; //makes twists 4.0
-            double turbSize = 32.0; //initial size of the turbulence
+            if (repeat > 1) {
+                xPeriod = tilePeriods((float)xPeriod, repeat);
+                yPeriod = tilePeriods((float)yPeriod, repeat);
+            }
+            for (unsigned int j = 0; j < width; ++j) {
+                row[j] = j * xPeriod / width + i * yPeriod / height;
+            }
+            for (unsigned int j = 0; gradient && j < width; ++j) {
+                rowGradient[2 * j] = xPeriod;
+                rowGradient[2 * j + 1] = yPeriod;
+            }
+        }
+    }
+}
 
-            double xyValue = j * xPeriod / width + i * yPeriod / height + turbPower * normalizedN; // x and y
+// Soft clamps a gradient into three bytes, see Texture3D::GRADIENT_SCALE
+static void packGradient(const glm::dvec3& gradient, GLubyte* bytes) {
+    const glm::dvec3 g = gradient / (glm::length(gradient) + Texture3D::GRADIENT_SCALE);
+    for (int k = 0; k < 3; ++k) {
+        bytes[k] = (GLubyte)(128 + std::lround(127.0 * g[k]));
+    }
+}
+
+void Texture3D::generateSlices(Type type, NoiseGenerator* generator, const SlicePlanes& planes, unsigned int depth, unsigned int firstLevel, unsigned int lastLevel, GLubyte* volume) {
+    const Region slice = { 0, 0, planes.width, planes.height };
+    const size_t sliceSize = (size_t)planes.width * planes.height * (planes.gradient ? 4 : 1);
+    for (unsigned int d = firstLevel; d < lastLevel; ++d) {
+        GLubyte* image = volume + sliceSize * d;
+        generateSublevel(type, generator, planes, depth, d, slice, image, planes.width);
+    }
+}
+
+void Texture3D::generatePackedSlices(const std::vector<Type>& types, NoiseGenerator* generator, const std::vector<SlicePlanes>& planes, unsigned int depth, unsigned int firstLevel, unsigned int lastLevel, GLubyte* volume) {
+    const unsigned int channels = (unsigned int)types.size();
+    const unsigned int texel = channels > 2 ? 4 : channels;
+    const Region slice = { 0, 0, planes[0].width, planes[0].height };
+    const size_t texels = (size_t)slice.width * slice.height;
+    // each material is generated as a slice of its own and spread into its channel
+    std::vector<GLubyte> image(texels);
+    for (unsigned int d = firstLevel; d < lastLevel; ++d) {
+        GLubyte* texture = volume + texels * texel * d;
+        for (unsigned int c = 0; c < texel; ++c) {
+            if (c < channels) {
+                generateSublevel(types[c], generator, planes[c], depth, d, slice, image.data(), slice.width);
+            }
+            else {
+                std::fill(image.begin(), image.end(), (GLubyte)0);
+            }
+            for (size_t k = 0; k < texels; ++k) {
+                texture[k * texel + c] = image[k];
+            }
+        }
+    }
+}
+
+void Texture3D::generateSublevel(Type type, NoiseGenerator* generator, const SlicePlanes& planes, unsigned int depth, unsigned int level, const Region& region, GLubyte* image, size_t rowStride) {
+    if (planes.graph) {
+        planes.graph->generateSublevel(generator, planes, depth, level, region, image, rowStride);
+    }
+    else if (type == WOOD) {
+        generateWoodSublevel(generator, planes, depth, level, region, image, rowStride);
+    }
+    else if (type == MARBLE) {
+        generateMarbleSublevel(generator, planes, depth, level, region, image, rowStride);
+    }
+}
+
+void Texture3D::generateWoodSublevel(NoiseGenerator* generator, const SlicePlanes& planes, unsigned int depth, unsigned int level, const Region& region, GLubyte* image, size_t rowStride) {
+    const unsigned int width = planes.width, height = planes.height;
+    const unsigned int columns = region.width;
+
+    const unsigned int texel = planes.gradient ? 4 : 1;
+
+    // the noise terms are evaluated a row at a time with the batched noise
+    std::vector<float> xs(columns), ys(columns);
+    std::vector<float> n(columns), fineGrain(columns);
+    const NoiseTerm rings(0.5f, 0.5f, 1.0f, planes.repeat);
+    const NoiseTerm grain(1.0f, 4.0f, 1.0f, planes.repeat);
+    std::vector<float> ringZs(columns, rings.z * ((float)level / (float)depth));
+    std::vector<float> grainZs(columns, grain.z * ((float)level / (float)depth));
+    // gradients of the terms along the noise coordinates, with planes.gradient
+    const size_t gradientColumns = planes.gradient ? columns : 0;
+    std::vector<float> ringDx(gradientColumns), ringDy(gradientColumns), ringDz(gradientColumns);
+    std::vector<float> grainDx(gradientColumns), grainDy(gradientColumns), grainDz(gradientColumns);
+
+    for (unsigned int i = region.y; i < region.y + region.height; ++i) {
+        float y = (float)i / (float)height;
+
+        fillRow(xs.data(), ys.data(), region.x, columns, width, rings.x, rings.y * y);
+        if (planes.gradient) rings.fractalWithGradient<4, WoodRings>(generator, xs.data(), ys.data(), ringZs.data(), n.data(), ringDx.data(), ringDy.data(), ringDz.data(), columns);
+        else rings.fractal<4, WoodRings>(generator, xs.data(), ys.data(), ringZs.data(), n.data(), columns);
+
+        fillRow(xs.data(), ys.data(), region.x, columns, width, grain.x, grain.y * y);
+        if (planes.gradient) grain.fractalWithGradient<10, WoodGrain>(generator, xs.data(), ys.data(), grainZs.data(), fineGrain.data(), grainDx.data(), grainDy.data(), grainDz.data(), columns);
+        else grain.fractal<10, WoodGrain>(generator, xs.data(), ys.data(), grainZs.data(), fineGrain.data(), columns);
+
+        const double* normalizedFN3 = &planes.plane[(size_t)i * width + region.x];
+        GLubyte* row = image + (i - region.y) * rowStride * texel;
+
+        for (unsigned int j = 0; j < columns; ++j) {
+            double normalizedN = (n[j] + 1.0) / 2.0;
+            double ringValue = 20 * normalizedN;
+            ringValue = ringValue - floor(ringValue);
+
+            double normalizedFN = (2.0 * fineGrain[j] + 1.0) / 2.0;
+
+            double thing2 = (1 - (normalizedFN * normalizedFN3[j]));
+            thing2 = thing2 < 0.86 ? thing2 - (0.86 - thing2) * (0.0 - thing2) : thing2;
+            thing2 = thing2 < 0.86 ? 0.0 : thing2 - 1.0 * (1 - thing2);
+
+            row[j * texel] = (GLubyte)floor((ringValue * normalizedFN * (1 - thing2)) * 256);
+        }
+
+        if (!planes.gradient) {
+            continue;
+        }
+        // the recipe above differentiated along the texture coordinates, the
+        // jumps of the rings and of the thresholds are left out
+        const double* dFN3 = &planes.planeGradient[2 * ((size_t)i * width + region.x)];
+        for (unsigned int j = 0; j < columns; ++j) {
+            glm::dvec3 dRings = 10.0 * glm::dvec3(rings.x * ringDx[j], rings.y * ringDy[j], rings.z * ringDz[j]);
+            double ringValue = 20 * ((n[j] + 1.0) / 2.0);
+            ringValue = ringValue - floor(ringValue);
+
+            double normalizedFN = (2.0 * fineGrain[j] + 1.0) / 2.0;
+            glm::dvec3 dFN(grain.x * grainDx[j], grain.y * grainDy[j], grain.z * grainDz[j]);
+
+            double thing2 = (1 - (normalizedFN * normalizedFN3[j]));
+            glm::dvec3 dThing2 = -(dFN * normalizedFN3[j] + normalizedFN * glm::dvec3(dFN3[2 * j], dFN3[2 * j + 1], 0.0));
+            if (thing2 < 0.86) {
+                dThing2 *= 1.86 - 2.0 * thing2;
+                thing2 = thing2 - (0.86 - thing2) * (0.0 - thing2);
+            }
+            if (thing2 < 0.86) {
+                thing2 = 0.0;
+                dThing2 = glm::dvec3(0.0);
+            }
+            else {
+                thing2 = thing2 - 1.0 * (1 - thing2);
+                dThing2 *= 2.0;
+            }
+
+            packGradient(dRings * normalizedFN * (1 - thing2) + ringValue * dFN * (1 - thing2) - ringValue * normalizedFN * dThing2, &row[j * texel + 1]);
+        }
+    }
+}
+
+void Texture3D::generateMarbleSublevel(NoiseGenerator* generator, const SlicePlanes& planes, unsigned int depth, unsigned int level, const Region& region, GLubyte* image, size_t rowStride) {
+    const unsigned int width = planes.width, height = planes.height;
+    const unsigned int columns = region.width;
+
+    // marble, the x and y periods are in planes
+    //turbPower = 0 ==> it becomes a normal sine pattern
+    const double turbPower = 5.0; //makes twists 4.0
+
+    const unsigned int texel = planes.gradient ? 4 : 1;
+
+    std::vector<float> xs(columns), ys(columns), n(columns);
+    const NoiseTerm veins(2.0f, 2.0f, 1.0f, planes.repeat);
+    std::vector<float> zs(columns, veins.z * ((float)level / (float)depth));
+    // gradient of the turbulence along the noise coordinates, with planes.gradient
+    const size_t gradientColumns = planes.gradient ? columns : 0;
+    std::vector<float> dxs(gradientColumns), dys(gradientColumns), dzs(gradientColumns);
+
+    for (unsigned int i = region.y; i < region.y + region.height; ++i) {
+        fillRow(xs.data(), ys.data(), region.x, columns, width, veins.x, veins.y * ((float)i / (float)height));
+        if (planes.gradient) veins.fractalWithGradient<8, MarbleVeins>(generator, xs.data(), ys.data(), zs.data(), n.data(), dxs.data(), dys.data(), dzs.data(), columns);
+        else veins.fractal<8, MarbleVeins>(generator, xs.data(), ys.data(), zs.data(), n.data(), columns); // 0.7
+        const double* periods = &planes.plane[(size_t)i * width + region.x];
+        GLubyte* row = image + (i - region.y) * rowStride * texel;
+
+        for (unsigned int j = 0; j < columns; ++j) {
+            double normalizedN = (n[j] + 1.0) / 2.0;
+
+            double xyValue = periods[j] + turbPower * normalizedN; // x and y
             double sineValue = fabs(sin(xyValue * 3.14159));
 
             if (sineValue >= -0.001 && sineValue < 0.1) sineValue += 0.05 * (1.0 - sineValue);
-            image[i * width + j] = (GLubyte)floor((sineValue > 0.0 && sineValue < 1.0 ? sineValue + sineValue * (1.0 - sineValue) : sineValue) * 256);
-            
+            row[j * texel] = (GLubyte)floor((sineValue > 0.0 && sineValue < 1.0 ? sineValue + sineValue * (1.0 - sineValue) : sineValue) * 256);
+
+            if (planes.gradient) {
+                // the same steps differentiated along the texture coordinates
+                const double* dPeriods = &planes.planeGradient[2 * ((size_t)i * width + region.x + j)];
+                glm::dvec3 dXY = glm::dvec3(dPeriods[0], dPeriods[1], 0.0) + turbPower / 2.0 * glm::dvec3(veins.x * dxs[j], veins.y * dys[j], veins.z * dzs[j]);
+                double sine = sin(xyValue * 3.14159);
+                glm::dvec3 dSine = (sine < 0.0 ? -3.14159 : 3.14159) * cos(xyValue * 3.14159) * dXY;
+                if (fabs(sine) < 0.1) dSine *= 0.95;
+                if (sineValue > 0.0 && sineValue < 1.0) dSine *= 2.0 - 2.0 * sineValue;
+                packGradient(dSine, &row[j * texel + 1]);
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////// BrickedTexture3D
+
+BrickedTexture3D::BrickedTexture3D() : pageTableId(-1), brickCount(0) {}
+
+void BrickedTexture3D::bind() { glBindTexture(GL_TEXTURE_3D, id); }
+
+void BrickedTexture3D::unbind() { glBindTexture(GL_TEXTURE_3D, 0); }
+
+void BrickedTexture3D::updateShader(ShaderProgram* shader) {
+    if (!shader->isUniform(PAGE_TABLE)) {
+        return;
+    }
+    GLint unit;
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &unit);
+    glActiveTexture(GL_TEXTURE0 + PAGE_TABLE_UNIT);
+    glBindTexture(GL_TEXTURE_3D, pageTableId);
+    glUniform1i(shader->Uniforms[PAGE_TABLE].index, PAGE_TABLE_UNIT);
+    glActiveTexture(unit);
+}
+
+void BrickedTexture3D::setNoise(NoiseGenerator::Backend noise) { this->noise = noise; }
+
+void BrickedTexture3D::setGraph(std::shared_ptr<const TextureGraph> graph) { this->graph = graph; }
+
+void BrickedTexture3D::setFootprint(const std::vector<glm::vec3>& triangles) { footprint = triangles; }
+
+unsigned int BrickedTexture3D::getBrickCount() { return brickCount; }
+
+// Separating axis test of a triangle against an axis aligned box, vertices relative
+// to the center of the box (Akenine-Moller): the box normals, the triangle normal
+// and the 9 cross products of their edges.
+static bool triangleOverlapsBox(const glm::vec3 (&v)[3], const glm::vec3& halfSize) {
+    const glm::vec3 edges[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+    auto separates = [&](const glm::vec3& axis) {
+        float p0 = glm::dot(v[0], axis), p1 = glm::dot(v[1], axis), p2 = glm::dot(v[2], axis);
+        float radius = glm::dot(halfSize, glm::abs(axis));
+        return std::min(p0, std::min(p1, p2)) > radius || std::max(p0, std::max(p1, p2)) < -radius;
+    };
+    for (int a = 0; a < 3; ++a) {
+        glm::vec3 boxAxis(0.0f);
+        boxAxis[a] = 1.0f;
+        if (separates(boxAxis)) return false;
+        for (const glm::vec3& edge : edges) {
+            if (separates(glm::cross(boxAxis, edge))) return false;
+        }
+    }
+    return !separates(glm::cross(edges[0], edges[1]));
+}
+
+void BrickedTexture3D::markOccupancy(const std::vector<glm::vec3>& triangles, unsigned int bricksX, unsigned int bricksY, unsigned int bricksZ, std::vector<GLubyte>& occupancy) {
+    occupancy.assign((size_t)bricksX * bricksY * bricksZ, 0);
+    const glm::vec3 bricks((float)bricksX, (float)bricksY, (float)bricksZ);
+    // a little over half a brick, so texels on a brick face count for both bricks
+    const glm::vec3 halfSize(0.5f + 1.0e-3f);
+
+    for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+        // in brick units, before wrapping
+        const glm::vec3 a = triangles[t] * bricks, b = triangles[t + 1] * bricks, c = triangles[t + 2] * bricks;
+        const glm::ivec3 first = glm::ivec3(glm::floor(glm::min(a, glm::min(b, c)) - halfSize + 0.5f));
+        const glm::ivec3 last = glm::ivec3(glm::floor(glm::max(a, glm::max(b, c)) + halfSize - 0.5f));
+        for (int z = first.z; z <= last.z; ++z) {
+            for (int y = first.y; y <= last.y; ++y) {
+                for (int x = first.x; x <= last.x; ++x) {
+                    const glm::vec3 center = glm::vec3(x, y, z) + 0.5f;
+                    const glm::vec3 v[3] = { a - center, b - center, c - center };
+                    if (!triangleOverlapsBox(v, halfSize)) continue;
+                    // the volume repeats, a brick outside [0, bricks) is the wrapped one
+                    unsigned int wx = (unsigned int)(((x % (int)bricksX) + (int)bricksX) % (int)bricksX);
+                    unsigned int wy = (unsigned int)(((y % (int)bricksY) + (int)bricksY) % (int)bricksY);
+                    unsigned int wz = (unsigned int)(((z % (int)bricksZ) + (int)bricksZ) % (int)bricksZ);
+                    occupancy[((size_t)wz * bricksY + wy) * bricksX + wx] = 1;
+                }
+            }
+        }
+    }
+}
+
+void BrickedTexture3D::generatePerlinNoiseTexture(unsigned int width, unsigned int height, unsigned int depth, Texture3D::Type type, std::uint32_t seed, unsigned int repeat) {
+    if (width % BRICK_SIZE || height % BRICK_SIZE || depth % BRICK_SIZE) {
+        std::cerr << "ERROR: Bricked volume " << width << "x" << height << "x" << depth
+            << " is not a multiple of " << BRICK_SIZE << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    const unsigned int bricksX = width / BRICK_SIZE, bricksY = height / BRICK_SIZE, bricksZ = depth / BRICK_SIZE;
+    std::vector<GLubyte> occupancy;
+    if (footprint.empty()) {
+        occupancy.assign((size_t)bricksX * bricksY * bricksZ, 1);
+    }
+    else {
+        markOccupancy(footprint, bricksX, bricksY, bricksZ, occupancy);
+    }
+
+    // the page table entry of every brick, occupied bricks are numbered in order
+    // and placed in the atlas row by row
+    std::vector<GLubyte> pageTable(occupancy.size() * 4, 0);
+    std::vector<unsigned int> bricks;
+    for (unsigned int b = 0; b < occupancy.size(); ++b) {
+        if (!occupancy[b]) continue;
+        unsigned int slot = (unsigned int)bricks.size();
+        pageTable[4 * b + 0] = (GLubyte)(slot % ATLAS_BRICKS);
+        pageTable[4 * b + 1] = (GLubyte)(slot / ATLAS_BRICKS % ATLAS_BRICKS);
+        pageTable[4 * b + 2] = (GLubyte)(slot / (ATLAS_BRICKS * ATLAS_BRICKS));
+        pageTable[4 * b + 3] = 1;
+        bricks.push_back(b);
+    }
+    brickCount = (unsigned int)bricks.size();
+    const unsigned int count = std::max(1u, brickCount);
+    const unsigned int atlasWidth = std::min(count, ATLAS_BRICKS) * BRICK_SIZE;
+    const unsigned int atlasHeight = std::min((count + ATLAS_BRICKS - 1) / ATLAS_BRICKS, ATLAS_BRICKS) * BRICK_SIZE;
+    const unsigned int atlasDepth = (count + ATLAS_BRICKS * ATLAS_BRICKS - 1) / (ATLAS_BRICKS * ATLAS_BRICKS) * BRICK_SIZE;
+    std::vector<GLubyte> atlas((size_t)atlasWidth * atlasHeight * atlasDepth, 0);
+
+    // the planes are whole slices, the bricks only read the rows and columns they cover
+    repeat = std::max(1u, repeat);
+    std::unique_ptr<NoiseGenerator> generator = NoiseGenerator::create(volumeNoise(noise, repeat), seed);
+    Texture3D::SlicePlanes planes;
+    Texture3D::generatePlanes(type, generator.get(), width, height, repeat, planes, graph.get());
+    ThreadPool::getInstance().parallelFor(brickCount, [&](unsigned int slot) {
+        const unsigned int b = bricks[slot];
+        const unsigned int x = b % bricksX, y = b / bricksX % bricksY, z = b / (bricksX * bricksY);
+        const Texture3D::Region region = { x * BRICK_SIZE, y * BRICK_SIZE, BRICK_SIZE, BRICK_SIZE };
+        const unsigned int atlasX = slot % ATLAS_BRICKS, atlasY = slot / ATLAS_BRICKS % ATLAS_BRICKS, atlasZ = slot / (ATLAS_BRICKS * ATLAS_BRICKS);
+        for (unsigned int k = 0; k < BRICK_SIZE; ++k) {
+            GLubyte* image = &atlas[(((size_t)atlasZ * BRICK_SIZE + k) * atlasHeight + atlasY * BRICK_SIZE) * atlasWidth + atlasX * BRICK_SIZE];
+            Texture3D::generateSublevel(type, generator.get(), planes, depth, z * BRICK_SIZE + k, region, image, atlasWidth);
+        }
+    });
+
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_3D, id);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, atlasWidth, atlasHeight, atlasDepth, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+
+    glGenTextures(1, &pageTableId);
+    glBindTexture(GL_TEXTURE_3D, pageTableId);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8UI, bricksX, bricksY, bricksZ, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, pageTable.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+#ifdef DEBUG
+    std::cout << "Generated bricked volume " << width << "x" << height << "x" << depth << ": " << brickCount
+        << " of " << occupancy.size() << " bricks, " << atlas.size() + pageTable.size() << " bytes" << std::endl;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////// AtlasTexture
+
+void AtlasTexture::bind() { glBindTexture(GL_TEXTURE_2D, id); }
+
+void AtlasTexture::unbind() { glBindTexture(GL_TEXTURE_2D, 0); }
+
+void AtlasTexture::setNoise(NoiseGenerator::Backend noise) { this->noise = noise; }
+
+void AtlasTexture::setGraph(std::shared_ptr<const TextureGraph> graph) { this->graph = graph; }
+
+void AtlasTexture::setSurface(const std::vector<glm::vec3>& triangles, const std::vector<glm::vec2>& texcoords) {
+    this->triangles = triangles;
+    this->texcoords = texcoords;
+}
+
+void AtlasTexture::bakeSurface(const std::vector<glm::vec3>& triangles, const std::vector<glm::vec2>& texcoords, unsigned int size, Texture3D::Type type, NoiseGenerator* generator, const Texture3D::SlicePlanes& planes, unsigned int depth, std::vector<GLubyte>& image, std::vector<GLubyte>& covered) {
+    image.assign((size_t)size * size, 0);
+    covered.assign((size_t)size * size, 0);
+
+    // The surface point of each texel whose center is in a triangle, then of the texels
+    // the edges cross that no triangle covers (2 and 1 in covered), so bilinear filtering
+    // of the edge texels reads the surface too
+    std::vector<glm::vec3> points((size_t)size * size);
+    const float margins[2] = { 0.0f, 0.75f };
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t t = 0; t + 2 < triangles.size() && t + 2 < texcoords.size(); t += 3) {
+            const glm::vec2 triangle[3] = { texcoords[t], texcoords[t + 1], texcoords[t + 2] };
+            Atlas::rasterize(triangle, size, margins[pass], [&](int x, int y, const glm::vec3& barycentric) {
+                const size_t texel = (size_t)y * size + x;
+                if (pass && covered[texel] == 2) return;
+                covered[texel] = (GLubyte)(2 - pass);
+                points[texel] = barycentric.x * triangles[t] + barycentric.y * triangles[t + 1] + barycentric.z * triangles[t + 2];
+            });
         }
     }
 
-    glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, level, width, height, 1, GL_RED, GL_UNSIGNED_BYTE, (GLvoid*)image.data());
+    // the volume texel of each point as GL_NEAREST and GL_REPEAT sample it, sorted so the
+    // texels of a volume row are generated together
+    struct Request {
+        unsigned int level, row, column;
+        size_t texel;
+    };
+    const unsigned int width = planes.width, height = planes.height;
+    std::vector<Request> requests;
+    for (size_t texel = 0; texel < covered.size(); ++texel) {
+        if (!covered[texel]) continue;
+        const glm::vec3 point = glm::fract(points[texel]);
+        requests.push_back({ std::min(depth - 1, (unsigned int)(point.z * depth)),
+            std::min(height - 1, (unsigned int)(point.y * height)),
+            std::min(width - 1, (unsigned int)(point.x * width)), texel });
+    }
+    std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) {
+        return std::tie(a.level, a.row, a.column) < std::tie(b.level, b.row, b.column);
+    });
+    std::vector<size_t> levels;
+    for (size_t r = 0; r < requests.size(); ++r) {
+        if (r == 0 || requests[r].level != requests[r - 1].level) levels.push_back(r);
+    }
+    levels.push_back(requests.size());
+
+    // a job per level, the columns of a row less than RUN_GAP apart are one region
+    ThreadPool::getInstance().parallelFor((unsigned int)levels.size() - 1, [&](unsigned int l) {
+        std::vector<GLubyte> row(width);
+        for (size_t first = levels[l]; first < levels[l + 1];) {
+            size_t last = first;
+            while (last + 1 < levels[l + 1] && requests[last + 1].row == requests[first].row &&
+                requests[last + 1].column - requests[last].column < RUN_GAP) {
+                ++last;
+            }
+            const unsigned int column = requests[first].column;
+            const Texture3D::Region region = { column, requests[first].row, requests[last].column - column + 1, 1 };
+            Texture3D::generateSublevel(type, generator, planes, depth, requests[first].level, region, row.data(), width);
+            for (size_t r = first; r <= last; ++r) {
+                image[requests[r].texel] = row[requests[r].column - column];
+            }
+            first = last + 1;
+        }
+    });
+
+    std::vector<GLubyte> dilated = covered;
+    Atlas::dilate(image, dilated, size, Atlas::PADDING);
+}
+
+void AtlasTexture::generatePerlinNoiseTexture(unsigned int size, unsigned int width, unsigned int height, unsigned int depth, Texture3D::Type type, std::uint32_t seed, unsigned int repeat) {
+#ifdef DEBUG
+    auto start = std::chrono::steady_clock::now();
+#endif
+    repeat = std::max(1u, repeat);
+    std::unique_ptr<NoiseGenerator> generator = NoiseGenerator::create(volumeNoise(noise, repeat), seed);
+    Texture3D::SlicePlanes planes;
+    Texture3D::generatePlanes(type, generator.get(), width, height, repeat, planes, graph.get());
+    std::vector<GLubyte> image, covered;
+    bakeSurface(triangles, texcoords, size, type, generator.get(), planes, depth, image, covered);
 
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, size, size, 0, GL_RED, GL_UNSIGNED_BYTE, image.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+#ifdef DEBUG
+    const size_t texels = std::count_if(covered.begin(), covered.end(), [](GLubyte c) { return c != 0; });
+    std::cout << "Baked " << size << "x" << size << " atlas of a " << width << "x" << height << "x" << depth
+        << " volume: " << texels << " surface texels, " << image.size() * 4 / 3 << " bytes with mipmaps in "
+        << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+#endif
+}
+
+///////////////////////////////////////////////////////////// PermutationTexture
+
+void PermutationTexture::bind() { glBindTexture(GL_TEXTURE_1D, id); }
+
+void PermutationTexture::unbind() { glBindTexture(GL_TEXTURE_1D, 0); }
+
+void PermutationTexture::generate(std::uint32_t seed) {
+    PerlinNoiseGenerator perlinNoise(seed);
+
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_1D, id);
+    // integer textures are only complete with nearest filtering
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_R8UI, 512, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE,
+        perlinNoise.getPermutations().data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_1D, 0);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
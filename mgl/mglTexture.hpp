@@ -10,20 +10,28 @@
 #define MGL_TEXTURE_HPP
 
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "mglSampler.hpp"
 #include "mglShader.hpp"
-#include "perlinNoise.hpp"
+#include "mglThreadPool.hpp"
+#include "mglVolumeCache.hpp"
+#include "noiseGenerator.hpp"
 
 namespace mgl {
 
 class Texture;
 class Texture2D;
 class Texture3D;
+class BrickedTexture3D;
+class AtlasTexture;
+class PermutationTexture;
+class TextureGraph;
 struct TextureInfo;
 
 //////////////////////////////////////////////////////////////////////// TEXTURE
@@ -37,6 +45,8 @@ public:
   ~Texture();
   virtual void bind() = 0;
   virtual void unbind() = 0;
+  // Anything else the shader needs from the texture, called after bind()
+  virtual void updateShader(ShaderProgram * /*shader*/) {}
   GLint getId();
 };
 
@@ -48,6 +58,7 @@ struct TextureInfo {
   std::string uniform;        // uniform name in shader
   Texture *texture = nullptr; // Texture (engine object)
   Sampler *sampler = nullptr; // Sampler (engine object)
+  float texcoordScale = 1.0f;  // times a tiling texture repeats over the texcoords
 
   TextureInfo(GLenum textureunit, GLuint index, const std::string &uniform,
               Texture *texture, Sampler *sampler);
@@ -60,20 +71,236 @@ class Texture2D : public Texture {
 public:
   void bind() override;
   void unbind() override;
+  // read then upload
   void load(const std::string &filename);
+  // Decodes the image, no GL calls and no output: other threads may read at the same time.
+  // Throws std::runtime_error if it cannot, load exits instead.
+  void read(const std::string &filename);
+  // Creates the texture on the GL thread
+  void upload();
   void generatePerlinNoiseTexture(const unsigned int height, const unsigned int width);
+
+private:
+  unsigned char *Image = nullptr;
+  int Width = 0, Height = 0;
 };
 
 class Texture3D : public Texture {
 public:
     enum Type { WOOD, MARBLE };
+    // BC4 volumes are GL_COMPRESSED_RED_RGTC1 2D arrays, one layer per slice with
+    // its own 2D mipmaps: RGTC formats are not allowed in GL_TEXTURE_3D.
+    enum Compression { UNCOMPRESSED, BC4 };
+
+    // Slices generated by each worker job, also the size of each upload
+    static const unsigned int SLICES_PER_JOB = 8;
+    // Bump whenever the generated content changes, cached volumes of other versions are ignored
+    static const unsigned int GENERATOR_VERSION = 6;
+    // Size of the preview volume shown while the full volume is being generated
+    static const unsigned int PREVIEW_SIZE = 32;
+    // Compressed volumes below this PSNR (dB) are reported in DEBUG builds and fail the
+    // bc4 case of the benchmark (make check)
+    static constexpr double MIN_PSNR = 35.0;
+    // Smallest side held to MIN_PSNR. BC4 keeps 8 values per 4x4 block and smaller volumes put
+    // more of a marble vein in each block: simplex marble is 33.7 dB at 64^3 and 33 dB at 32^3
+    // (a TextureRepeat of 4 or 8 in the app), and a wider endpoint search gains only 0.3 dB.
+    // Those sizes are still reported, without failing
+    static const unsigned int MIN_PSNR_SIZE = 128;
+    // Gradients g of the texels along the texture coordinates are stored soft clamped,
+    // g / (|g| + GRADIENT_SCALE) * 127 + 128 per component, so |g| = GRADIENT_SCALE is halfway
+    static constexpr double GRADIENT_SCALE = 64.0;
+    // Materials one volume packs in its channels, see addChannel
+    static const unsigned int MAX_CHANNELS = 4;
 
+    // A material packed in a channel of a volume, the graph is null for the recipe of type
+    struct Channel {
+        Type type;
+        std::shared_ptr<const TextureGraph> graph;
+    };
+
+    Texture3D();
+    ~Texture3D();
     void bind() override;
     void unbind() override;
+    // Set before generating, shaders sampling a BC4 volume need a sampler2DArray
+    void setCompression(Compression compression);
+    Compression getCompression();
+    GLenum getTarget();
+    // Set before generating. Backends that do not tile fall back to Perlin for repeat > 1.
+    void setNoise(NoiseGenerator::Backend noise);
+    NoiseGenerator::Backend getNoise();
+    // Set before generating, the volume is made of the graph instead of the recipe of its type.
+    // The type still tells the shaders apart. Null goes back to the recipe.
+    void setGraph(std::shared_ptr<const TextureGraph> graph);
+    // Set before generating. The volume becomes GL_RGBA8, four times the memory: red is the texel as
+    // always, green, blue and alpha its gradient along the texture coordinates (see GRADIENT_SCALE),
+    // from the analytic gradient of the noise, so a shader bump maps with the one sample. Only for
+    // uncompressed volumes of the built-in recipes, BC4 and graph volumes stay single channel.
+    void setGradient(bool gradient);
+    bool getGradient();
+    // Set before generating. Packs another material in the next channel of the volume, which becomes
+    // GL_RG8 with two materials and GL_RGBA8 with three or four (alpha is 0 with three). Red is the
+    // type and graph it is generated with. The channels share size, seed, noise and repeat, a shader
+    // picks its own with VOLUME_CHANNEL. Only for uncompressed volumes without gradient.
+    void addChannel(Type type, std::shared_ptr<const TextureGraph> graph = nullptr);
+    unsigned int getChannelCount();
     //void load(const std::string& filename);
-    void generatePerlinNoiseTexture(unsigned int width, unsigned int height, unsigned int depth, Type type);
-    void generateWoodSublevel(PerlinNoiseGenerator* perlinNoise, unsigned int width, unsigned int height, unsigned int depth, unsigned int level);
-    void generateMarbleSublevel(PerlinNoiseGenerator* perlinNoise, unsigned int width, unsigned int height, unsigned int depth, unsigned int level);
+    // seed picks the permutation of the noise, 0 is the reference permutation.
+    // repeat > 1 makes a volume that tiles seamlessly and is meant to be repeated that many
+    // times over the texture coordinates (see TextureInfo::texcoordScale). Every noise term
+    // is rounded to a whole number of periods over the tile, so the pattern changes slightly.
+    void generatePerlinNoiseTexture(unsigned int width, unsigned int height, unsigned int depth, Type type, std::uint32_t seed = 0, unsigned int repeat = 1);
+
+    // Progressive generation: a small preview is generated on the calling thread and used
+    // right away while the full volume is generated by the workers. refine() is called
+    // between frames, it uploads the finished slices for at most budget seconds and swaps
+    // the full volume in once all of it is on the GPU.
+    void generateProgressive(unsigned int width, unsigned int height, unsigned int depth, Type type, std::uint32_t seed = 0, unsigned int repeat = 1, unsigned int previewSize = PREVIEW_SIZE);
+    // true once the full volume is in use
+    bool refine(double budget);
+    bool isRefined();
+
+    // Terms of a recipe that do not depend on z, computed once per volume and read by every slice.
+    // wood: fine grain streaks (normalized noise at z = 0.9)
+    // marble: sine phase of the x and y periods, before the turbulence is added
+    // graph: every plane of the graph one after the other, the slices are made of the graph
+    // With gradient the slices are RGBA8 texels with their gradient, planeGradient holds the
+    // derivatives of plane along j / width and i / height of each texel one after the other.
+    struct SlicePlanes {
+        unsigned int width = 0, height = 0;
+        unsigned int repeat = 1;
+        std::vector<double> plane;
+        const TextureGraph* graph = nullptr;
+        bool gradient = false;
+        std::vector<double> planeGradient;
+    };
+
+    // Columns [x, x + width) of rows [y, y + height) of a slice
+    struct Region {
+        unsigned int x, y, width, height;
+    };
+
+    // CPU side of the generation, no GL calls so they can run on any thread.
+    // Each slice only depends on its level, the result is the same for any number of threads.
+    // Slices are width * height texels of one byte, or of four with gradient (not with a graph).
+    static void generatePlanes(Type type, NoiseGenerator* generator, unsigned int width, unsigned int height, unsigned int repeat, SlicePlanes& planes, const TextureGraph* graph = nullptr, bool gradient = false);
+    static void generateSlices(Type type, NoiseGenerator* generator, const SlicePlanes& planes, unsigned int depth, unsigned int firstLevel, unsigned int lastLevel, GLubyte* volume);
+    // As generateSlices for a volume packing the material types[c] made with planes[c] in channel c,
+    // texels of two bytes for two materials and of four for three or four.
+    static void generatePackedSlices(const std::vector<Type>& types, NoiseGenerator* generator, const std::vector<SlicePlanes>& planes, unsigned int depth, unsigned int firstLevel, unsigned int lastLevel, GLubyte* volume);
+    // Only the region of the slice is generated, its rows are rowStride texels apart in image.
+    // generateSublevel is the recipe of type or the graph of the planes.
+    static void generateSublevel(Type type, NoiseGenerator* generator, const SlicePlanes& planes, unsigned int depth, unsigned int level, const Region& region, GLubyte* image, size_t rowStride);
+    static void generateWoodSublevel(NoiseGenerator* generator, const SlicePlanes& planes, unsigned int depth, unsigned int level, const Region& region, GLubyte* image, size_t rowStride);
+    static void generateMarbleSublevel(NoiseGenerator* generator, const SlicePlanes& planes, unsigned int depth, unsigned int level, const Region& region, GLubyte* image, size_t rowStride);
+    // Encodes the width x height slice and its 2D mipmaps as layer of every level,
+    // levels[l] holds the BC4 blocks of all the layers of level l.
+    static void compressSlice(const GLubyte* slice, unsigned int width, unsigned int height, unsigned int layer, std::vector<std::vector<GLubyte>>& levels);
+    // Box filters a width x height x depth level into slices [firstSlice, lastSlice) of the next
+    // one, each texel the rounded mean of a 2x2x2 block. Each side of the next level is
+    // max(1, side / 2) as GL sizes mipmaps, so the last texel of an odd side is dropped, and a
+    // side of 1 stays 1 by averaging its texel with itself.
+    // Texels are components bytes, each filtered on its own.
+    // Uncompressed mipmaps are made this way while the volume is generated, not by the GPU.
+    static void downsampleLevel(const GLubyte* level, unsigned int width, unsigned int height, unsigned int depth, unsigned int firstSlice, unsigned int lastSlice, GLubyte* smaller, unsigned int components = 1);
+
+private:
+    struct Generation;
+    std::unique_ptr<Generation> pending;
+    Compression compression = UNCOMPRESSED;
+    NoiseGenerator::Backend noise = NoiseGenerator::PERLIN;
+    std::shared_ptr<const TextureGraph> graph;
+    bool gradient = false;
+    std::vector<Channel> channels;
+
+    static GLuint createTexture(GLenum target);
+    bool loadCachedTexture(const VolumeCache::Key& key);
+    void storeCachedTexture(const VolumeCache::Key& key, std::vector<std::vector<GLubyte>>& levels);
+    void startGeneration(const VolumeCache::Key& key);
+    bool uploadGeneration(double budget, bool wait);
+};
+
+// Volume stored only where a mesh samples it. The bricks touched by the triangles of the
+// footprint are generated into an atlas (GL_R8) and a page table (GL_RGBA8UI, one texel
+// per brick of the volume) holds the atlas brick of each, w = 0 for bricks left out.
+// The shader reads both with texelFetch: sampling is nearest, so bricks need no border
+// and the volume has no mipmaps. The texels are the same as those of a Texture3D.
+class BrickedTexture3D : public Texture {
+public:
+    static const unsigned int BRICK_SIZE = 8;
+    // Bricks per side of the atlas in x and y, the atlas grows in z
+    static const unsigned int ATLAS_BRICKS = 32;
+    // Texture unit of the page table, the atlas goes in the unit of the TextureInfo
+    static const unsigned int PAGE_TABLE_UNIT = 1;
+
+    BrickedTexture3D();
+    void bind() override;
+    void unbind() override;
+    void updateShader(ShaderProgram* shader) override;
+    // as Texture3D::setNoise and setGraph
+    void setNoise(NoiseGenerator::Backend noise);
+    void setGraph(std::shared_ptr<const TextureGraph> graph);
+
+    // Triangles in texture coordinates, three vertices each, wrapping around [0, 1) like
+    // the repeated volume. An empty footprint generates every brick.
+    void setFootprint(const std::vector<glm::vec3>& triangles);
+    // Sides must be multiples of BRICK_SIZE
+    void generatePerlinNoiseTexture(unsigned int width, unsigned int height, unsigned int depth, Texture3D::Type type, std::uint32_t seed = 0, unsigned int repeat = 1);
+    unsigned int getBrickCount();
+
+    // occupancy[(z * bricksY + y) * bricksX + x] is set for every brick a triangle touches
+    static void markOccupancy(const std::vector<glm::vec3>& triangles, unsigned int bricksX, unsigned int bricksY, unsigned int bricksZ, std::vector<GLubyte>& occupancy);
+
+private:
+    GLuint pageTableId;
+    std::vector<glm::vec3> footprint;
+    unsigned int brickCount;
+    NoiseGenerator::Backend noise = NoiseGenerator::PERLIN;
+    std::shared_ptr<const TextureGraph> graph;
+};
+
+// Material baked on the surface of one mesh. Each texel of the atlas of the mesh
+// (Mesh::generateAtlas) holds the texel of the volume at the surface point it covers, the
+// one nearest sampling of a Texture3D returns there, and only those volume texels are
+// generated. The atlas is a GL_R8 2D texture with mipmaps, so it filters like any other;
+// the texels around the charts are dilated from their edges so filtering reads no background.
+class AtlasTexture : public Texture {
+public:
+    // Gap in columns of a volume row under which texels are generated in one region
+    static const unsigned int RUN_GAP = 8;
+
+    void bind() override;
+    void unbind() override;
+    // as Texture3D::setNoise and setGraph
+    void setNoise(NoiseGenerator::Backend noise);
+    void setGraph(std::shared_ptr<const TextureGraph> graph);
+
+    // Triangles in texture coordinates like BrickedTexture3D::setFootprint, and the
+    // texcoords of their vertices in the atlas
+    void setSurface(const std::vector<glm::vec3>& triangles, const std::vector<glm::vec2>& texcoords);
+    // A size x size atlas of the width x height x depth volume
+    void generatePerlinNoiseTexture(unsigned int size, unsigned int width, unsigned int height, unsigned int depth, Texture3D::Type type, std::uint32_t seed = 0, unsigned int repeat = 1);
+
+    // CPU side: the size x size image of the surface in a volume of the planes, dilated by
+    // Atlas::PADDING texels, covered is set for the texels of the surface before dilating
+    static void bakeSurface(const std::vector<glm::vec3>& triangles, const std::vector<glm::vec2>& texcoords, unsigned int size, Texture3D::Type type, NoiseGenerator* generator, const Texture3D::SlicePlanes& planes, unsigned int depth, std::vector<GLubyte>& image, std::vector<GLubyte>& covered);
+
+private:
+    std::vector<glm::vec3> triangles;
+    std::vector<glm::vec2> texcoords;
+    NoiseGenerator::Backend noise = NoiseGenerator::PERLIN;
+    std::shared_ptr<const TextureGraph> graph;
+};
+
+// Permutation table of a PerlinNoiseGenerator for the noise evaluated in shaders:
+// the 256 entries twice, 512 GL_R8UI texels read with texelFetch from a usampler1D.
+// A material sampling this instead of a Texture3D needs no volume at all.
+class PermutationTexture : public Texture {
+public:
+    void bind() override;
+    void unbind() override;
+    // seed as in PerlinNoiseGenerator, 0 is the reference permutation
+    void generate(std::uint32_t seed = 0);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,540 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Procedural materials described as node graphs
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglTextureGraph.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "fractalNoise.hpp"
+
+namespace mgl {
+
+/////////////////////////////////////////////////////////////////// TextureGraph
+
+TextureGraph::TextureGraph() : Output(0), NodeCount(0), PlaneCount(0), Hash(0) {}
+
+std::uint32_t TextureGraph::getHash() const { return Hash; }
+
+unsigned int TextureGraph::getNodeCount() const { return NodeCount; }
+
+unsigned int TextureGraph::getPlaneCount() const { return PlaneCount; }
+
+namespace {
+
+void fail(const std::string &material, const std::string &message) {
+  std::cerr << "ERROR: Material " << material << ": " << message << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+// Key of a node for merging equal ones, the parameters bit exact
+std::string nodeKey(int op, const std::vector<unsigned int> &operands,
+                    const std::vector<double> &parameters) {
+  std::string key = std::to_string(op);
+  for (unsigned int operand : operands) key += " n" + std::to_string(operand);
+  for (double parameter : parameters) {
+    char text[32];
+    std::snprintf(text, sizeof(text), " %a", parameter);
+    key += text;
+  }
+  return key;
+}
+
+// out[k] = op(a[k], b[k], c[k]) over a whole block, also past the texels of a
+// short one on what earlier blocks left. With a fixed trip count and operands
+// that never overlap the target, the loop vectorizes at -O2 where the cost
+// model does not version loops for aliasing.
+template <typename F>
+void blockwise(double *__restrict out, const double *__restrict a,
+               const double *__restrict b, const double *__restrict c, F op) {
+  for (unsigned int k = 0; k < TextureGraph::BLOCK; k++) {
+    out[k] = op(a[k], b[k], c[k]);
+  }
+}
+
+}  // namespace
+
+std::shared_ptr<const TextureGraph> TextureGraph::parse(
+    const nlohmann::json &material, const std::string &name) {
+  static const std::map<std::string, Op> OPS = {
+      {"coordinate", COORDINATE}, {"noise", NOISE},   {"fbm", FBM},
+      {"add", ADD},               {"subtract", SUBTRACT},
+      {"multiply", MULTIPLY},     {"remap", REMAP},   {"sine", SINE},
+      {"abs", ABS},               {"fract", FRACT},   {"threshold", THRESHOLD}};
+
+  std::shared_ptr<TextureGraph> graph(new TextureGraph());
+  std::map<std::string, unsigned int> keys, names;
+  auto intern = [&](Op op, const std::vector<unsigned int> &operands,
+                    const std::vector<double> &parameters) {
+    std::string key = nodeKey(op, operands, parameters);
+    auto found = keys.find(key);
+    if (found != keys.end()) return found->second;
+    unsigned int index = static_cast<unsigned int>(graph->Nodes.size());
+    graph->Nodes.push_back({op, operands, parameters});
+    keys[key] = index;
+    return index;
+  };
+  auto operand = [&](const nlohmann::json &value) -> unsigned int {
+    if (value.is_number()) return intern(CONSTANT, {}, {value.get<double>()});
+    if (value.is_string()) {
+      auto found = names.find(value.get<std::string>());
+      if (found == names.end()) {
+        fail(name, "node " + value.get<std::string>() +
+                       " is not defined above its use");
+      }
+      return found->second;
+    }
+    fail(name, "an input is neither a node name nor a number: " + value.dump());
+    return 0;
+  };
+  auto numbers = [&](const nlohmann::json &node, const char *field,
+                     std::vector<double> fallback) {
+    if (!node.contains(field)) return fallback;
+    std::vector<double> values = node[field].get<std::vector<double>>();
+    if (values.size() != fallback.size()) {
+      fail(name, std::string(field) + " needs " +
+                     std::to_string(fallback.size()) + " numbers");
+    }
+    return values;
+  };
+
+  if (!material.contains("nodes") || !material["nodes"].is_array() ||
+      material["nodes"].empty()) {
+    fail(name, "no nodes");
+  }
+  unsigned int last = 0;
+  for (const nlohmann::json &node : material["nodes"]) {
+    std::string opName = node.value("op", "");
+    auto op = OPS.find(opName);
+    if (op == OPS.end()) fail(name, "unknown op \"" + opName + "\"");
+
+    switch (op->second) {
+      case COORDINATE: {
+        std::string axis = node.value("axis", "x");
+        if (axis != "x" && axis != "y" && axis != "z") {
+          fail(name, "coordinate axis must be x, y or z");
+        }
+        last = intern(COORDINATE, {},
+                      {double(axis[0] - 'x'), node.value("scale", 1.0)});
+        break;
+      }
+      case NOISE:
+      case FBM: {
+        std::vector<double> parameters = numbers(node, "scale", {1, 1, 1});
+        std::vector<double> offset = numbers(node, "offset", {0, 0, 0});
+        parameters.insert(parameters.end(), offset.begin(), offset.end());
+        if (op->second == FBM) {
+          int octaves = node.value("octaves", 1);
+          if (octaves < 1 || octaves > static_cast<int>(MAX_OCTAVES))
+            fail(name, "fbm needs 1 to " + std::to_string(MAX_OCTAVES) +
+                           " octaves");
+          // as floats, like the FractalNoise parameters
+          const float lacunarity = float(node.value("lacunarity", 2.0));
+          // In a repeated volume the period of the last octave is up to the
+          // scale times lacunarity^(octaves - 1), and has to fit an int (see
+          // octavePeriod)
+          const double periodBits =
+              std::log2(std::max({1.0, std::fabs(parameters[0]),
+                                  std::fabs(parameters[1])})) +
+              (octaves - 1) * std::log2(std::max(1.0f, lacunarity));
+          if (periodBits >= 31.0) {
+            fail(name, "fbm octaves times log2(lacunarity) are too many, the "
+                       "octave periods would overflow");
+          }
+          parameters.push_back(octaves);
+          parameters.push_back(lacunarity);
+          parameters.push_back(float(node.value("gain", 0.5)));
+        }
+        last = intern(op->second, {}, parameters);
+        break;
+      }
+      case ADD:
+      case SUBTRACT:
+      case MULTIPLY: {
+        // a + b + c is (a + b) + c
+        const nlohmann::json &inputs = node.value("inputs", nlohmann::json());
+        if (!inputs.is_array() || inputs.size() < 2) {
+          fail(name, opName + " needs two inputs or more");
+        }
+        last = operand(inputs[0]);
+        for (std::size_t i = 1; i < inputs.size(); i++) {
+          last = intern(op->second, {last, operand(inputs[i])}, {});
+        }
+        break;
+      }
+      case REMAP: {
+        std::vector<double> from = numbers(node, "from", {-1, 1});
+        std::vector<double> to = numbers(node, "to", {0, 1});
+        if (from[0] == from[1]) fail(name, "remap from an empty range");
+        last = intern(REMAP, {operand(node.value("input", nlohmann::json()))},
+                      {from[0], from[1], to[0], to[1]});
+        break;
+      }
+      case SINE:
+        last = intern(SINE, {operand(node.value("input", nlohmann::json()))},
+                      {node.value("frequency", 1.0)});
+        break;
+      case ABS:
+      case FRACT:
+        last = intern(op->second,
+                      {operand(node.value("input", nlohmann::json()))}, {});
+        break;
+      case THRESHOLD:
+        last = intern(THRESHOLD,
+                      {operand(node.value("input", nlohmann::json())),
+                       operand(node.value("below", nlohmann::json(0.0))),
+                       operand(node.value("above", nlohmann::json(1.0)))},
+                      {node.value("edge", 0.5)});
+        break;
+      default:
+        break;
+    }
+
+    if (node.contains("name")) {
+      std::string nodeName = node["name"].get<std::string>();
+      if (names.count(nodeName)) fail(name, "node " + nodeName + " defined twice");
+      names[nodeName] = last;
+    }
+  }
+
+  graph->Output = material.contains("output")
+                      ? operand(material["output"])
+                      : last;
+  graph->compile();
+  return graph;
+}
+
+std::map<std::string, std::shared_ptr<const TextureGraph>> TextureGraph::load(
+    const std::string &filename) {
+  std::map<std::string, std::shared_ptr<const TextureGraph>> materials;
+  std::ifstream file(filename);
+  if (!file) return materials;
+
+  nlohmann::json materials_json;
+  try {
+    file >> materials_json;
+  } catch (const nlohmann::json::exception &error) {
+    std::cerr << "ERROR: " << filename << ": " << error.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  for (auto &material : materials_json.items()) {
+    materials[material.key()] = parse(material.value(), material.key());
+  }
+  return materials;
+}
+
+void TextureGraph::compile() {
+  const std::size_t count = Nodes.size();
+
+  // operands always come before their node, the output is the last node used
+  std::vector<bool> live(count, false), zDependent(count, false);
+  live[Output] = true;
+  for (std::size_t i = count; i-- > 0;) {
+    if (!live[i]) continue;
+    for (unsigned int operand : Nodes[i].operands) live[operand] = true;
+  }
+  for (std::size_t i = 0; i < count; i++) {
+    const Node &node = Nodes[i];
+    if (node.op == COORDINATE) {
+      zDependent[i] = node.parameters[0] == 2 && node.parameters[1] != 0;
+    } else if (node.op == NOISE || node.op == FBM) {
+      zDependent[i] = node.parameters[2] != 0;
+    }
+    for (unsigned int operand : node.operands) {
+      zDependent[i] = zDependent[i] || zDependent[operand];
+    }
+  }
+
+  // a node evaluated per volume is kept in a plane when a slice reads it
+  std::vector<int> planeOf(count, -1);
+  std::vector<unsigned int> volumeNodes, sliceNodes, stored;
+  for (std::size_t i = 0; i < count; i++) {
+    if (!live[i] || Nodes[i].op == CONSTANT) continue;
+    if (zDependent[i]) {
+      sliceNodes.push_back(static_cast<unsigned int>(i));
+      continue;
+    }
+    volumeNodes.push_back(static_cast<unsigned int>(i));
+    bool read = i == Output;
+    for (std::size_t j = i + 1; j < count && !read; j++) {
+      if (!live[j] || !zDependent[j]) continue;
+      const std::vector<unsigned int> &operands = Nodes[j].operands;
+      read = std::find(operands.begin(), operands.end(), i) != operands.end();
+    }
+    if (read) {
+      planeOf[i] = static_cast<int>(stored.size());
+      stored.push_back(static_cast<unsigned int>(i));
+    }
+  }
+  NodeCount = static_cast<unsigned int>(volumeNodes.size() + sliceNodes.size());
+  PlaneCount = static_cast<unsigned int>(stored.size());
+  PlaneProgram = schedule(volumeNodes, planeOf, stored, Output);
+  SliceProgram = schedule(sliceNodes, planeOf, {}, Output);
+
+  // FNV-1a over the live nodes, numbered in order, so names, layout and
+  // nodes the output does not use leave the hash alone
+  std::vector<unsigned int> number(count, 0);
+  std::string program;
+  unsigned int next = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    if (!live[i]) continue;
+    number[i] = next++;
+    std::vector<unsigned int> operands;
+    for (unsigned int operand : Nodes[i].operands) {
+      operands.push_back(number[operand]);
+    }
+    program += nodeKey(Nodes[i].op, operands, Nodes[i].parameters) + ";";
+  }
+  std::uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : program) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  Hash = static_cast<std::uint32_t>(hash ^ (hash >> 32));
+  if (Hash == 0) Hash = 1;  // 0 is the key of the built-in recipes
+}
+
+// Slots are given in order and reused once the last instruction reading them
+// ran. Planes and constants stay in their slots for the whole program.
+TextureGraph::Program TextureGraph::schedule(
+    const std::vector<unsigned int> &nodes, const std::vector<int> &planeOf,
+    const std::vector<unsigned int> &stored, unsigned int output) const {
+  Program program;
+  std::map<unsigned int, unsigned int> slotOf;
+  std::map<unsigned int, std::size_t> lastUse;
+  std::vector<unsigned int> freeSlots;
+  auto allocate = [&]() {
+    if (freeSlots.empty()) return program.slots++;
+    unsigned int slot = freeSlots.back();
+    freeSlots.pop_back();
+    return slot;
+  };
+
+  std::vector<bool> inProgram(Nodes.size(), false);
+  for (unsigned int node : nodes) inProgram[node] = true;
+  for (std::size_t n = 0; n < nodes.size(); n++) {
+    for (unsigned int operand : Nodes[nodes[n]].operands) {
+      lastUse[operand] = n;
+    }
+  }
+  // read back after every block
+  for (unsigned int node : stored) lastUse[node] = nodes.size();
+  lastUse[output] = nodes.size();
+
+  // what the program reads without computing it: constants and planes
+  for (auto &use : lastUse) {
+    unsigned int node = use.first;
+    if (inProgram[node]) continue;
+    if (Nodes[node].op == CONSTANT) {
+      slotOf[node] = allocate();
+      program.constants.push_back({slotOf[node], Nodes[node].parameters[0]});
+    } else if (planeOf[node] >= 0 && stored.empty()) {
+      slotOf[node] = allocate();
+      Instruction load = {PLANE, slotOf[node], {0, 0, 0}, &Nodes[node],
+                          static_cast<unsigned int>(planeOf[node])};
+      program.instructions.push_back(load);
+    }
+  }
+
+  for (std::size_t n = 0; n < nodes.size(); n++) {
+    const Node &node = Nodes[nodes[n]];
+    Instruction instruction = {node.op, 0, {0, 0, 0}, &node, 0};
+    for (std::size_t o = 0; o < node.operands.size(); o++) {
+      instruction.operands[o] = slotOf[node.operands[o]];
+    }
+    // the target is never the slot of an operand, see blockwise
+    instruction.target = allocate();
+    slotOf[nodes[n]] = instruction.target;
+    for (unsigned int operand : node.operands) {
+      if (inProgram[operand] && lastUse[operand] == n &&
+          std::find(freeSlots.begin(), freeSlots.end(), slotOf[operand]) ==
+              freeSlots.end()) {
+        freeSlots.push_back(slotOf[operand]);
+      }
+    }
+    program.instructions.push_back(instruction);
+  }
+
+  for (unsigned int node : stored) program.stores.push_back(slotOf[node]);
+  program.output = slotOf.count(output) ? slotOf[output] : 0;
+  return program;
+}
+
+void TextureGraph::run(const Program &program, NoiseGenerator *generator,
+                       unsigned int width, unsigned int height,
+                       unsigned int depth, unsigned int repeat,
+                       unsigned int level, unsigned int row,
+                       unsigned int column, unsigned int count,
+                       const double *planes, double *workspace) const {
+  const bool periodic = repeat > 1;
+  float xs[BLOCK], ys[BLOCK], zs[BLOCK], noise[BLOCK];
+
+  for (const Instruction &instruction : program.instructions) {
+    const std::vector<double> &p = instruction.node->parameters;
+    double *out = workspace + instruction.target * BLOCK;
+    const double *a = workspace + instruction.operands[0] * BLOCK;
+    const double *b = workspace + instruction.operands[1] * BLOCK;
+    const double *c = workspace + instruction.operands[2] * BLOCK;
+
+    switch (instruction.op) {
+      case COORDINATE: {
+        double scale = periodic ? tilePeriods(float(p[1]), repeat) : p[1];
+        if (p[0] == 0) {
+          for (unsigned int k = 0; k < count; k++) {
+            out[k] = double(column + k) * scale / width;
+          }
+        } else {
+          double value = p[0] == 1 ? double(row) * scale / height
+                                   : double(level) * scale / depth;
+          std::fill(out, out + count, value);
+        }
+        break;
+      }
+      case NOISE:
+      case FBM: {
+        const NoiseTerm term(static_cast<float>(p[0]), static_cast<float>(p[1]),
+                             static_cast<float>(p[2]), repeat);
+        const float y = term.y * (float(row) / float(height)) + float(p[4]);
+        const float z = term.z * (float(level) / float(depth)) + float(p[5]);
+        for (unsigned int k = 0; k < count; k++) {
+          xs[k] = term.x * (float(column + k) / float(width)) + float(p[3]);
+          ys[k] = y;
+          zs[k] = z;
+        }
+        if (instruction.op == NOISE) {
+          term.noise(generator, xs, ys, zs, noise, count);
+        } else {
+          term.fractal(generator, static_cast<unsigned int>(p[6]),
+                       float(p[7]), float(p[8]), xs, ys, zs, noise, count);
+        }
+        for (unsigned int k = 0; k < count; k++) out[k] = noise[k];
+        break;
+      }
+      case ADD:
+        blockwise(out, a, b, c, [](double x, double y, double) { return x + y; });
+        break;
+      case SUBTRACT:
+        blockwise(out, a, b, c, [](double x, double y, double) { return x - y; });
+        break;
+      case MULTIPLY:
+        blockwise(out, a, b, c, [](double x, double y, double) { return x * y; });
+        break;
+      case REMAP: {
+        const double from = p[0], to = p[2];
+        const double scale = (p[3] - p[2]) / (p[1] - p[0]);
+        blockwise(out, a, b, c, [=](double x, double, double) {
+          return to + (x - from) * scale;
+        });
+        break;
+      }
+      case SINE: {
+        const double frequency = p[0];
+        for (unsigned int k = 0; k < count; k++) {
+          out[k] = std::sin(a[k] * frequency);
+        }
+        break;
+      }
+      case ABS:
+        blockwise(out, a, b, c, [](double x, double, double) { return std::fabs(x); });
+        break;
+      case FRACT:
+        blockwise(out, a, b, c, [](double x, double, double) { return x - std::floor(x); });
+        break;
+      case THRESHOLD: {
+        const double edge = p[0];
+        blockwise(out, a, b, c, [=](double x, double below, double above) {
+          return x < edge ? below : above;
+        });
+        break;
+      }
+      case PLANE: {
+        const double *plane =
+            planes + (size_t(instruction.plane) * height + row) * width + column;
+        std::copy(plane, plane + count, out);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+}
+
+void TextureGraph::generatePlanes(NoiseGenerator *generator,
+                                  unsigned int width, unsigned int height,
+                                  unsigned int repeat,
+                                  Texture3D::SlicePlanes &planes) const {
+  planes.width = width;
+  planes.height = height;
+  planes.repeat = repeat;
+  planes.graph = this;
+  planes.plane.assign(size_t(PlaneCount) * width * height, 0.0);
+  // the octave periods are whole only with a whole lacunarity, the preview
+  // generates its planes first so this exits on the calling thread
+  if (repeat > 1) {
+    for (const Node &node : Nodes) {
+      if (node.op != FBM) continue;
+      const double lacunarity = node.parameters[7];
+      if (lacunarity < 1.0 || lacunarity != std::floor(lacunarity)) {
+        std::cerr << "ERROR: fbm with a lacunarity of " << lacunarity
+                  << " does not tile, a repeated volume needs a whole one"
+                  << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+  }
+  if (PlaneCount == 0) return;
+
+  std::vector<double> workspace(size_t(PlaneProgram.slots) * BLOCK);
+  for (const auto &constant : PlaneProgram.constants) {
+    std::fill_n(&workspace[size_t(constant.first) * BLOCK], BLOCK,
+                constant.second);
+  }
+  for (unsigned int i = 0; i < height; i++) {
+    for (unsigned int first = 0; first < width; first += BLOCK) {
+      unsigned int count = std::min(BLOCK, width - first);
+      run(PlaneProgram, generator, width, height, 1, repeat, 0, i, first,
+          count, nullptr, workspace.data());
+      for (unsigned int p = 0; p < PlaneCount; p++) {
+        const double *slot = &workspace[size_t(PlaneProgram.stores[p]) * BLOCK];
+        std::copy(slot, slot + count,
+                  &planes.plane[(size_t(p) * height + i) * width + first]);
+      }
+    }
+  }
+}
+
+void TextureGraph::generateSublevel(NoiseGenerator *generator,
+                                    const Texture3D::SlicePlanes &planes,
+                                    unsigned int depth, unsigned int level,
+                                    const Texture3D::Region &region,
+                                    GLubyte *image, size_t rowStride) const {
+  std::vector<double> workspace(std::max(1u, SliceProgram.slots) * BLOCK);
+  for (const auto &constant : SliceProgram.constants) {
+    std::fill_n(&workspace[size_t(constant.first) * BLOCK], BLOCK,
+                constant.second);
+  }
+  const double *output = &workspace[size_t(SliceProgram.output) * BLOCK];
+
+  for (unsigned int i = region.y; i < region.y + region.height; i++) {
+    GLubyte *row = image + (i - region.y) * rowStride;
+    for (unsigned int first = 0; first < region.width; first += BLOCK) {
+      unsigned int count = std::min(BLOCK, region.width - first);
+      run(SliceProgram, generator, planes.width, planes.height, depth,
+          planes.repeat, level, i, region.x + first, count,
+          planes.plane.data(), workspace.data());
+      for (unsigned int k = 0; k < count; k++) {
+        row[first + k] = GLubyte(int(std::floor(output[k] * 256)));
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
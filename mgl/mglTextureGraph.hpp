@@ -0,0 +1,155 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Procedural materials described as node graphs
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_TEXTURE_GRAPH_HPP
+#define MGL_TEXTURE_GRAPH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "./json.hpp"
+#include "mglTexture.hpp"
+#include "noiseGenerator.hpp"
+
+namespace mgl {
+
+class TextureGraph;
+
+/////////////////////////////////////////////////////////////////// TextureGraph
+
+// A material is a list of nodes, each one a value per texel, and the node whose
+// value becomes the texel: (GLubyte)floor(value * 256), wrapping outside [0, 1).
+// Nodes refer to the nodes above them by name, a number where a node is
+// expected is a constant. The last node is the output unless one is named.
+//
+//   { "op": "coordinate", "axis": "x", "scale": 1 }       scale * j / width
+//   { "op": "noise", "scale": [x, y, z], "offset": [x, y, z] }
+//   { "op": "fbm", "scale": [...], "offset": [...], "octaves": 8,
+//     "lacunarity": 2, "gain": 0.5 }                       as FractalNoise
+//   { "op": "add" | "subtract" | "multiply", "inputs": [a, b, ...] }
+//   { "op": "remap", "input": a, "from": [-1, 1], "to": [0, 1] }
+//   { "op": "sine", "input": a, "frequency": 3.14159 }     sin(a * frequency)
+//   { "op": "abs" | "fract", "input": a }
+//   { "op": "threshold", "input": a, "edge": 0.5, "below": b, "above": c }
+//
+// Noise is sampled at scale * (j / width, i / height, level / depth) + offset.
+// In a tiling volume the scales of noise, fbm and coordinate nodes are rounded
+// to whole periods over the tile, as the built-in recipes do.
+// fbm then needs a whole lacunarity, and log2(scale) + (octaves - 1) *
+// log2(lacunarity) is kept below 31 so the octave periods fit an int.
+//
+// The graph is compiled once: equal nodes are merged, nodes the output does not
+// use are dropped, and the nodes that do not depend on z are evaluated once per
+// volume into the slice planes. What is left runs a row at a time over blocks
+// of BLOCK texels held in L1, each node a loop over the block, so the noise
+// calls are batched and the arithmetic vectorizes. The built-in recipes fuse
+// the arithmetic of a texel instead, the graph of a material runs at about
+// their cost (wood within a few percent, marble 10-20% faster).
+class TextureGraph {
+ public:
+  static const unsigned int BLOCK = 64;
+
+  // Errors in the description are reported and exit, like shader errors
+  static std::shared_ptr<const TextureGraph> parse(const nlohmann::json &material,
+                                                   const std::string &name);
+  // Every material of a file, by name. A missing file has no materials.
+  static std::map<std::string, std::shared_ptr<const TextureGraph>> load(
+      const std::string &filename);
+
+  // Hash of the compiled graph, part of the cache key of the volumes made of it
+  std::uint32_t getHash() const;
+  // Nodes left after compiling, and how many of them are kept in slice planes
+  unsigned int getNodeCount() const;
+  unsigned int getPlaneCount() const;
+
+  // As Texture3D::generatePlanes and the Sublevel generators, for this graph
+  void generatePlanes(NoiseGenerator *generator, unsigned int width,
+                      unsigned int height, unsigned int repeat,
+                      Texture3D::SlicePlanes &planes) const;
+  void generateSublevel(NoiseGenerator *generator,
+                        const Texture3D::SlicePlanes &planes,
+                        unsigned int depth, unsigned int level,
+                        const Texture3D::Region &region, GLubyte *image,
+                        size_t rowStride) const;
+
+ private:
+  enum Op {
+    CONSTANT,
+    COORDINATE,
+    NOISE,
+    FBM,
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    REMAP,
+    SINE,
+    ABS,
+    FRACT,
+    THRESHOLD,
+    PLANE
+  };
+
+  // One node, operands are node indices. Parameters by op: CONSTANT value;
+  // COORDINATE axis, scale; NOISE and FBM scale xyz, offset xyz, then octaves,
+  // lacunarity, gain; REMAP from, to; SINE frequency; THRESHOLD edge.
+  struct Node {
+    Op op;
+    std::vector<unsigned int> operands;
+    std::vector<double> parameters;
+  };
+
+  // A node evaluated into a slot of the workspace, reading the slots of its
+  // operands. PLANE loads slot target from plane parameter of the planes.
+  struct Instruction {
+    Op op;
+    unsigned int target;
+    unsigned int operands[3];
+    const Node *node;
+    unsigned int plane;
+  };
+
+  // Instructions for one pass over a row, constants are in their own slots
+  // and filled once. stores[p] is the slot written to plane p.
+  struct Program {
+    std::vector<Instruction> instructions;
+    std::vector<std::pair<unsigned int, double>> constants;
+    std::vector<unsigned int> stores;
+    unsigned int slots = 0;
+    unsigned int output = 0;
+  };
+
+  std::vector<Node> Nodes;
+  unsigned int Output;
+  unsigned int NodeCount;
+  unsigned int PlaneCount;
+  Program PlaneProgram, SliceProgram;
+  std::uint32_t Hash;
+
+  TextureGraph();
+  void compile();
+  Program schedule(const std::vector<unsigned int> &nodes,
+                   const std::vector<int> &planeOf,
+                   const std::vector<unsigned int> &stored,
+                   unsigned int output) const;
+  void run(const Program &program, NoiseGenerator *generator,
+           unsigned int width, unsigned int height, unsigned int depth,
+           unsigned int repeat, unsigned int level, unsigned int row,
+           unsigned int column, unsigned int count, const double *planes,
+           double *workspace) const;
+
+ public:
+  TextureGraph(TextureGraph const &) = delete;
+  void operator=(TextureGraph const &) = delete;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_TEXTURE_GRAPH_HPP */
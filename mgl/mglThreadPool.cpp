@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Worker Thread Pool
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglThreadPool.hpp"
+
+#include <atomic>
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////////////// ThreadPool
+
+ThreadPool::ThreadPool(unsigned int threads) : Stopping(false) {
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+  }
+  if (threads == 0) {
+    threads = 1;
+  }
+  for (unsigned int i = 0; i < threads; i++) {
+    Workers.emplace_back(&ThreadPool::work, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(JobsMutex);
+    Stopping = true;
+  }
+  JobsCondition.notify_all();
+  for (std::thread &worker : Workers) {
+    worker.join();
+  }
+}
+
+ThreadPool &ThreadPool::getInstance() {
+  static ThreadPool instance;
+  return instance;
+}
+
+unsigned int ThreadPool::getThreadCount() {
+  return static_cast<unsigned int>(Workers.size());
+}
+
+void ThreadPool::work() {
+  for (;;) {
+    std::packaged_task<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(JobsMutex);
+      JobsCondition.wait(lock, [this] { return Stopping || !Jobs.empty(); });
+      if (Jobs.empty()) {
+        return;
+      }
+      job = std::move(Jobs.front());
+      Jobs.pop();
+    }
+    job();
+  }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> job) {
+  std::packaged_task<void()> task(std::move(job));
+  std::future<void> result = task.get_future();
+  {
+    std::lock_guard<std::mutex> lock(JobsMutex);
+    Jobs.push(std::move(task));
+  }
+  JobsCondition.notify_one();
+  return result;
+}
+
+void ThreadPool::parallelFor(unsigned int count,
+                             const std::function<void(unsigned int)> &job) {
+  // one job per worker, each taking the next index until none are left
+  std::atomic<unsigned int> next(0);
+  std::vector<std::future<void>> results;
+  for (unsigned int i = 0; i < getThreadCount() && i < count; i++) {
+    results.push_back(submit([&next, count, &job] {
+      for (unsigned int k = next++; k < count; k = next++) {
+        job(k);
+      }
+    }));
+  }
+  // every job has to finish before next goes out of scope, even if one throws
+  for (std::future<void> &result : results) {
+    result.wait();
+  }
+  for (std::future<void> &result : results) {
+    result.get();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
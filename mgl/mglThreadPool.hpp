@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Worker Thread Pool
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_THREAD_POOL_HPP
+#define MGL_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace mgl {
+
+class ThreadPool;
+
+///////////////////////////////////////////////////////////////////// ThreadPool
+
+class ThreadPool {
+ public:
+  // 0 threads means one per hardware thread
+  explicit ThreadPool(unsigned int threads = 0);
+  ~ThreadPool();
+
+  static ThreadPool &getInstance();
+
+  unsigned int getThreadCount();
+
+  // Jobs must not wait on other jobs of the same pool.
+  std::future<void> submit(std::function<void()> job);
+  void parallelFor(unsigned int count, const std::function<void(unsigned int)> &job);
+
+ private:
+  std::vector<std::thread> Workers;
+  std::queue<std::packaged_task<void()>> Jobs;
+  std::mutex JobsMutex;
+  std::condition_variable JobsCondition;
+  bool Stopping;
+
+  void work();
+
+ public:
+  ThreadPool(ThreadPool const &) = delete;
+  void operator=(ThreadPool const &) = delete;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_THREAD_POOL_HPP */
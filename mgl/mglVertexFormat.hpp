@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Interleaved vertex formats described at compile time
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_VERTEX_FORMAT_HPP
+#define MGL_VERTEX_FORMAT_HPP
+
+#include <GL/glew.h>
+
+#include <cstddef>
+
+namespace mgl {
+
+struct VertexElement;
+template <GLuint Index, GLint Components>
+struct VertexAttribute;
+template <typename... Attributes>
+struct VertexFormat;
+
+////////////////////////////////////////////////////////////////// VertexFormat
+
+// An attribute of the vertices, components floats bound to index
+struct VertexElement {
+  GLuint index;
+  GLint components;
+};
+
+template <GLuint Index, GLint Components>
+struct VertexAttribute {
+  static constexpr VertexElement ELEMENT = {Index, Components};
+};
+
+// The attributes of one interleaved vertex in this order, with no padding:
+//
+//   using LitVertex = VertexFormat<PositionAttribute, NormalAttribute>;
+//   mesh->setVertexFormat<LitVertex>();
+//
+// Attributes not in the format are not stored at all. STRIDE and offsetOf are
+// those of float attributes, Mesh::quantizeAttributes packs them tighter.
+template <typename... Attributes>
+struct VertexFormat {
+  static_assert(sizeof...(Attributes) > 0, "a vertex has some attribute");
+
+  static constexpr std::size_t COUNT = sizeof...(Attributes);
+  static constexpr VertexElement ELEMENTS[] = {Attributes::ELEMENT...};
+  static constexpr GLsizei STRIDE =
+      GLsizei((0 + ... + Attributes::ELEMENT.components) * sizeof(GLfloat));
+
+  static constexpr bool contains(GLuint index) {
+    return (false || ... || (Attributes::ELEMENT.index == index));
+  }
+  // Byte offset of the attribute at index in a vertex, -1 if not in it
+  static constexpr GLsizei offsetOf(GLuint index) {
+    GLsizei offset = 0;
+    for (const VertexElement &element : ELEMENTS) {
+      if (element.index == index) return offset;
+      offset += GLsizei(element.components * sizeof(GLfloat));
+    }
+    return -1;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_VERTEX_FORMAT_HPP */
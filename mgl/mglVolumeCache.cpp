@@ -0,0 +1,251 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// On-disk cache for generated volume textures
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglVolumeCache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mgl {
+
+///////////////////////////////////////////////////////////////////// MappedFile
+
+MappedFile::MappedFile()
+    : File(nullptr), Mapping(nullptr), Data(nullptr), Size(0) {}
+
+MappedFile::~MappedFile() { close(); }
+
+const unsigned char *MappedFile::data() { return Data; }
+
+std::size_t MappedFile::size() { return Size; }
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &filename) {
+  close();
+  HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  File = file;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    close();
+    return false;
+  }
+  Size = static_cast<std::size_t>(size.QuadPart);
+
+  Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!Mapping) {
+    close();
+    return false;
+  }
+  Data = static_cast<const unsigned char *>(
+      MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!Data) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::close() {
+  if (Data) UnmapViewOfFile(Data);
+  if (Mapping) CloseHandle(Mapping);
+  if (File) CloseHandle(File);
+  File = Mapping = nullptr;
+  Data = nullptr;
+  Size = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string &filename) {
+  close();
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+  void *data = mmap(nullptr, static_cast<std::size_t>(info.st_size),
+                    PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);  // the mapping stays valid
+  if (data == MAP_FAILED) return false;
+
+  Mapping = data;
+  Data = static_cast<const unsigned char *>(data);
+  Size = static_cast<std::size_t>(info.st_size);
+  return true;
+}
+
+void MappedFile::close() {
+  if (Mapping) munmap(Mapping, Size);
+  File = Mapping = nullptr;
+  Data = nullptr;
+  Size = 0;
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////// VolumeCache
+
+VolumeCache::VolumeCache() : Directory("texture-cache"), Enabled(true) {}
+
+VolumeCache::~VolumeCache() {}
+
+VolumeCache &VolumeCache::getInstance() {
+  static VolumeCache instance;
+  return instance;
+}
+
+void VolumeCache::setDirectory(const std::string &directory) {
+  Directory = directory;
+}
+
+void VolumeCache::setEnabled(bool enabled) { Enabled = enabled; }
+
+bool VolumeCache::isEnabled() { return Enabled; }
+
+static bool operator==(const VolumeCache::Key &a, const VolumeCache::Key &b) {
+  return a.type == b.type && a.width == b.width && a.height == b.height &&
+         a.depth == b.depth && a.generatorVersion == b.generatorVersion &&
+         a.seed == b.seed && a.repeat == b.repeat &&
+         a.compression == b.compression && a.noise == b.noise &&
+         a.graph == b.graph && a.gradient == b.gradient &&
+         a.channels == b.channels &&
+         std::equal(a.packedTypes, a.packedTypes + 3, b.packedTypes) &&
+         std::equal(a.packedGraphs, a.packedGraphs + 3, b.packedGraphs);
+}
+
+// FNV-1a over the key fields, byte by byte so the name does not depend on
+// padding or on the endianness of the machine
+static std::uint64_t hashKey(const VolumeCache::Key &key) {
+  const std::uint32_t fields[] = {key.type, key.width, key.height, key.depth,
+                                  key.generatorVersion, key.seed, key.repeat,
+                                  key.compression, key.noise, key.graph,
+                                  key.gradient, key.channels,
+                                  key.packedTypes[0], key.packedTypes[1],
+                                  key.packedTypes[2], key.packedGraphs[0],
+                                  key.packedGraphs[1], key.packedGraphs[2]};
+  std::uint64_t hash = 14695981039346656037ull;
+  for (std::uint32_t field : fields) {
+    for (int byte = 0; byte < 4; byte++) {
+      hash ^= (field >> (8 * byte)) & 0xFF;
+      hash *= 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+std::string VolumeCache::getFilename(const Key &key) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.mglvol",
+                static_cast<unsigned long long>(hashKey(key)));
+  return (std::filesystem::path(Directory) / name).string();
+}
+
+bool VolumeCache::load(const Key &key, MappedFile &file,
+                       std::vector<Level> &levels) {
+  if (!Enabled || !file.open(getFilename(key))) return false;
+
+  const unsigned char *data = file.data();
+  const std::size_t size = file.size();
+  Header header;
+  if (size < sizeof(Header)) return false;
+  std::memcpy(&header, data, sizeof(Header));
+  if (header.magic != MAGIC || header.formatVersion != FORMAT_VERSION ||
+      !(header.key == key) ||
+      size < sizeof(Header) + header.levelCount * sizeof(LevelEntry)) {
+    file.close();
+    return false;
+  }
+
+  levels.clear();
+  for (std::uint32_t l = 0; l < header.levelCount; l++) {
+    LevelEntry entry;
+    std::memcpy(&entry, data + sizeof(Header) + l * sizeof(LevelEntry),
+                sizeof(LevelEntry));
+    if (entry.offset > size || entry.size > size - entry.offset) {
+      file.close();
+      return false;
+    }
+    levels.push_back({entry.width, entry.height, entry.depth,
+                      static_cast<std::size_t>(entry.size),
+                      reinterpret_cast<const GLubyte *>(data + entry.offset)});
+  }
+  return true;
+}
+
+bool VolumeCache::store(const Key &key, const std::vector<Level> &levels) {
+  if (!Enabled) return false;
+
+  std::error_code error;
+  std::filesystem::create_directories(Directory, error);
+  if (error) return false;
+
+  Header header;
+  header.magic = MAGIC;
+  header.formatVersion = FORMAT_VERSION;
+  header.key = key;
+  header.levelCount = static_cast<std::uint32_t>(levels.size());
+
+  std::vector<LevelEntry> entries;
+  std::uint64_t offset = sizeof(Header) + levels.size() * sizeof(LevelEntry);
+  for (const Level &level : levels) {
+    LevelEntry entry;
+    entry.width = level.width;
+    entry.height = level.height;
+    entry.depth = level.depth;
+    entry.reserved = 0;
+    entry.offset = offset;
+    entry.size = level.size;
+    offset += entry.size;
+    entries.push_back(entry);
+  }
+
+  // written next to the final name and renamed, a crash never leaves a
+  // truncated file under a valid key
+  const std::string filename = getFilename(key);
+  const std::string temporary = filename + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    out.write(reinterpret_cast<const char *>(entries.data()),
+              entries.size() * sizeof(LevelEntry));
+    for (std::size_t l = 0; l < levels.size(); l++) {
+      out.write(reinterpret_cast<const char *>(levels[l].data),
+                static_cast<std::streamsize>(entries[l].size));
+    }
+    if (!out) {
+      std::cerr << "WARNING: Could not write " << temporary << std::endl;
+      return false;
+    }
+  }
+  std::filesystem::rename(temporary, filename, error);
+  return !error;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// On-disk cache for generated volume textures
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_VOLUME_CACHE_HPP
+#define MGL_VOLUME_CACHE_HPP
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mgl {
+
+class MappedFile;
+class VolumeCache;
+
+///////////////////////////////////////////////////////////////////// MappedFile
+
+// Read only memory mapping of a whole file.
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  bool open(const std::string &filename);
+  void close();
+  const unsigned char *data();
+  std::size_t size();
+
+ private:
+  void *File;
+  void *Mapping;
+  const unsigned char *Data;
+  std::size_t Size;
+
+ public:
+  MappedFile(MappedFile const &) = delete;
+  void operator=(MappedFile const &) = delete;
+};
+
+//////////////////////////////////////////////////////////////////// VolumeCache
+
+// Volume files are named after a hash of everything the content depends on,
+// so a key only ever maps to one content and stale files are simply never read.
+// File layout: Header, Header::levelCount LevelEntry, then the level data
+// (LevelEntry::size bytes each, width * height * depth texels of one byte for
+// uncompressed volumes, of four with their gradient, of two or four packing
+// materials, the BC4 blocks of every layer for compressed ones).
+class VolumeCache {
+ public:
+  struct Key {
+    std::uint32_t type = 0;
+    std::uint32_t width = 0, height = 0, depth = 0;
+    std::uint32_t generatorVersion = 0;
+    std::uint32_t seed = 0;
+    std::uint32_t repeat = 1;
+    std::uint32_t compression = 0;
+    std::uint32_t noise = 0;
+    // TextureGraph::getHash of the graph it is made of, 0 for the built-in recipes
+    std::uint32_t graph = 0;
+    // 1 for RGBA8 volumes of texels and their gradients
+    std::uint32_t gradient = 0;
+    // Materials packed in the channels, red is the type and graph above and
+    // channel c > 0 is made of packedTypes[c - 1] and packedGraphs[c - 1]
+    std::uint32_t channels = 1;
+    std::uint32_t packedTypes[3] = {0, 0, 0};
+    std::uint32_t packedGraphs[3] = {0, 0, 0};
+  };
+
+  struct Level {
+    unsigned int width, height, depth;
+    std::size_t size;
+    const GLubyte *data;
+  };
+
+  static VolumeCache &getInstance();
+
+  void setDirectory(const std::string &directory);
+  void setEnabled(bool enabled);
+  bool isEnabled();
+
+  std::string getFilename(const Key &key);
+
+  // On success file keeps the mapping alive, levels point into it.
+  bool load(const Key &key, MappedFile &file, std::vector<Level> &levels);
+  bool store(const Key &key, const std::vector<Level> &levels);
+
+ private:
+  static const std::uint32_t MAGIC = 0x564c474d;  // "MGLV"
+  static const std::uint32_t FORMAT_VERSION = 8;
+
+  struct Header {
+    std::uint32_t magic;
+    std::uint32_t formatVersion;
+    Key key;
+    std::uint32_t levelCount;
+  };
+
+  struct LevelEntry {
+    std::uint32_t width, height, depth, reserved;
+    std::uint64_t offset, size;
+  };
+
+  std::string Directory;
+  bool Enabled;
+
+  VolumeCache();
+  ~VolumeCache();
+
+ public:
+  VolumeCache(VolumeCache const &) = delete;
+  void operator=(VolumeCache const &) = delete;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_VOLUME_CACHE_HPP */
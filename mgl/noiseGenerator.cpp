@@ -0,0 +1,53 @@
+#include "noiseGenerator.hpp"
+
+#include "noiseSimd.hpp"
+#include "perlinNoise.hpp"
+#include "simplexNoise.hpp"
+
+namespace mgl {
+
+	std::unique_ptr<NoiseGenerator> NoiseGenerator::create(Backend backend, std::uint32_t seed) {
+		switch (backend) {
+			case SIMPLEX: return std::unique_ptr<NoiseGenerator>(new SimplexNoiseGenerator(seed));
+			default: return std::unique_ptr<NoiseGenerator>(new PerlinNoiseGenerator(seed));
+		}
+	}
+
+	NoiseGenerator::NoiseGenerator() : simdLevel(detectSimdLevel()) {}
+
+	NoiseGenerator::~NoiseGenerator() {}
+
+	NoiseGenerator::SimdLevel NoiseGenerator::detectSimdLevel() {
+#if defined(MGL_NOISE_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool sse41 = (info[2] & (1 << 19)) != 0;
+		bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6;
+		if (osAvx && maxLeaf >= 7) {
+			__cpuidex(info, 7, 0);
+			if (info[1] & (1 << 5)) return AVX2;
+		}
+		return sse41 ? SSE41 : SCALAR;
+#elif defined(MGL_NOISE_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) return AVX2;
+		if (__builtin_cpu_supports("sse4.1")) return SSE41;
+		return SCALAR;
+#else
+		return SCALAR;
+#endif
+	}
+
+	NoiseGenerator::SimdLevel NoiseGenerator::getSimdLevel() {
+		return simdLevel;
+	}
+
+	void NoiseGenerator::setSimdLevel(SimdLevel level) {
+		// never go above what the processor supports
+		SimdLevel supported = detectSimdLevel();
+		simdLevel = level < supported ? level : supported;
+	}
+
+}
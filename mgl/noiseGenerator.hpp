@@ -0,0 +1,62 @@
+#ifndef MGL_NOISE_GENERATOR_HPP
+#define MGL_NOISE_GENERATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace mgl {
+
+	class NoiseGenerator;
+
+	// Gradient noise in [-1, 1] behind one interface, so the texture generators and
+	// FractalNoise work with any backend. The seed fixes the noise of each backend in its
+	// own way: PerlinNoiseGenerator shuffles its permutation table with it (0 keeps the
+	// reference table), SimplexNoiseGenerator has no table and xors a hash of it into the
+	// integer hash of every corner. The same seed on two backends gives unrelated noise.
+	class NoiseGenerator {
+	public:
+		enum Backend { PERLIN, SIMPLEX };
+		enum SimdLevel { SCALAR, SSE41, AVX2 };
+
+		// Lattice cells after which periodic noise repeats along each axis,
+		// 256 on every axis gives the same values as the non periodic noise.
+		struct Period {
+			int x = 256, y = 256, z = 256;
+		};
+
+		static std::unique_ptr<NoiseGenerator> create(Backend backend, std::uint32_t seed = 0);
+
+		NoiseGenerator();
+		virtual ~NoiseGenerator();
+
+		virtual Backend getBackend() = 0;
+		virtual std::uint32_t getSeed() = 0;
+		virtual double noise(double x, double y, double z) = 0;
+
+		// Batched single precision noise, out[i] = noise(xs[i], ys[i], zs[i]).
+		// Every kernel performs the same float operations in the same order, and the
+		// library is built without FMA contraction, so the result does not depend on
+		// the instruction set picked at runtime. The same holds for noiseWithGradient.
+		virtual void noise(const float* xs, const float* ys, const float* zs, float* out, std::size_t n) = 0;
+		// Periodic variant, noise(x + period.x, y, z) == noise(x, y, z) and likewise for y and z.
+		// Only meaningful for backends that tile().
+		virtual void noise(const float* xs, const float* ys, const float* zs, float* out, std::size_t n, const Period& period) = 0;
+		// The same noise with its analytic gradient, out as noise() and dxs[i], dys[i], dzs[i]
+		// its derivatives along x, y and z, from the one evaluation instead of extra samples
+		virtual void noiseWithGradient(const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n) = 0;
+		virtual void noiseWithGradient(const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n, const Period& period) = 0;
+		// Whether the periodic noise() repeats, a volume meant to be repeated needs it
+		virtual bool tiles() = 0;
+
+		static SimdLevel detectSimdLevel();
+		SimdLevel getSimdLevel();
+		void setSimdLevel(SimdLevel level);
+
+	protected:
+		SimdLevel simdLevel;
+	};
+
+}
+
+#endif // !MGL_NOISE_GENERATOR_HPP
@@ -0,0 +1,102 @@
+// Pieces shared by the batched kernels of the noise backends, only included by
+// their translation units: every helper is static, each kernel file gets its own.
+
+#ifndef MGL_NOISE_SIMD_HPP
+#define MGL_NOISE_SIMD_HPP
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MGL_NOISE_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC lets any function use any intrinsic, gcc and clang have to be told per function
+#if defined(MGL_NOISE_X86) && !defined(_MSC_VER)
+#define MGL_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define MGL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MGL_TARGET_SSE41
+#define MGL_TARGET_AVX2
+#endif
+
+namespace mgl {
+
+	// The gradient selection below is the branchless form of the switch in
+	// PerlinNoiseGenerator::grad, the SIMD kernels use the same formulation.
+
+	// Which of x, y, z the gradient takes as its first and second term
+	static const unsigned char GRAD_U[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1 };
+	static const unsigned char GRAD_V[16] = { 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 2, 0, 2 };
+
+	static inline float flipSign(float value, unsigned int sign) {
+		std::uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		bits ^= sign;
+		std::memcpy(&value, &bits, sizeof(bits));
+		return value;
+	}
+
+	// Table driven so random hashes do not cost a branch misprediction each
+	static inline float gradf(int hash, float x, float y, float z) {
+		unsigned int h = hash & 0xF;
+		const float c[3] = { x, y, z };
+		float u = flipSign(c[GRAD_U[h]], (h & 1u) << 31);
+		float v = flipSign(c[GRAD_V[h]], (h & 2u) << 30);
+		return u + v;
+	}
+
+	// The gradient of gradf, the vector of the hash: +-1 on the two axes it takes
+	static inline void gradVectorf(int hash, float& gx, float& gy, float& gz) {
+		unsigned int h = hash & 0xF;
+		float g[3] = { 0.0f, 0.0f, 0.0f };
+		g[GRAD_U[h]] = h & 1u ? -1.0f : 1.0f;
+		g[GRAD_V[h]] = h & 2u ? -1.0f : 1.0f;
+		gx = g[0];
+		gy = g[1];
+		gz = g[2];
+	}
+
+#ifdef MGL_NOISE_X86
+
+	MGL_TARGET_AVX2 static inline __m256 grad8(__m256i hash, __m256 x, __m256 y, __m256 z) {
+		__m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(0xF));
+		__m256 hLess8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+		__m256 hLess4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+		__m256 h12or14 = _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)), _mm256_cmpeq_epi32(h, _mm256_set1_epi32(14))));
+		__m256 u = _mm256_blendv_ps(y, x, hLess8);
+		__m256 v = _mm256_blendv_ps(_mm256_blendv_ps(z, x, h12or14), y, hLess4);
+		__m256 uSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(1)), 31));
+		__m256 vSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30));
+		return _mm256_add_ps(_mm256_xor_ps(u, uSign), _mm256_xor_ps(v, vSign));
+	}
+
+	// gradVectorf of each lane, with the masks of grad8
+	MGL_TARGET_AVX2 static inline void gradVector8(__m256i hash, __m256& gx, __m256& gy, __m256& gz) {
+		__m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(0xF));
+		__m256 hLess8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+		__m256 hLess4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+		__m256 h12or14 = _mm256_castsi256_ps(_mm256_or_si256(_mm256_cmpeq_epi32(h, _mm256_set1_epi32(12)), _mm256_cmpeq_epi32(h, _mm256_set1_epi32(14))));
+		__m256 one = _mm256_set1_ps(1.0f);
+		__m256 u = _mm256_xor_ps(one, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(1)), 31)));
+		__m256 v = _mm256_xor_ps(one, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(2)), 30)));
+		gx = _mm256_add_ps(_mm256_and_ps(hLess8, u), _mm256_andnot_ps(hLess4, _mm256_and_ps(h12or14, v)));
+		gy = _mm256_add_ps(_mm256_andnot_ps(hLess8, u), _mm256_and_ps(hLess4, v));
+		gz = _mm256_andnot_ps(_mm256_or_ps(hLess4, h12or14), v);
+	}
+
+	// p[i] | p[i + 1] << 8 in the low half of each lane, the high half holds p[i + 2]
+	// and p[i + 3] (the table is padded for them) and is masked or ignored by the caller
+	MGL_TARGET_AVX2 static inline __m256i gatherPairs8(const std::uint8_t* p, __m256i index) {
+		return _mm256_i32gather_epi32((const int*)p, index, 1);
+	}
+
+#endif // MGL_NOISE_X86
+
+}
+
+#endif // !MGL_NOISE_SIMD_HPP
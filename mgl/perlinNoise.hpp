@@ -3,20 +3,49 @@
 
 #include <GL/glew.h>
 
-#include <vector>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "noiseGenerator.hpp"
 
 namespace mgl {
 
 	class PerlinNoiseGenerator;
 
-	class PerlinNoiseGenerator {
+	class PerlinNoiseGenerator : public NoiseGenerator {
 	public:
+		// Largest difference between the batched float noise() and the double noise()
+		// evaluated at the same coordinates, for coordinates with magnitude below 4096.
+		static constexpr float BATCH_TOLERANCE = 1.0e-5f;
+
+		// The 256 entry permutation twice, so p[i + 1] never needs a wrap for i < 511,
+		// plus padding for the 32 bit gathers of the AVX2 kernel at the last pair.
+		static constexpr std::size_t TABLE_SIZE = 512 + 4;
+		using PermutationTable = std::array<std::uint8_t, TABLE_SIZE>;
+
+		// Ken Perlin's reference permutation
 		PerlinNoiseGenerator();
+		// Seed 0 is the reference permutation, any other seed a shuffle of it
+		explicit PerlinNoiseGenerator(std::uint32_t seed);
 		~PerlinNoiseGenerator();
-		double noise(double x, double y, double z);
+		Backend getBackend() override;
+		std::uint32_t getSeed() override;
+		double noise(double x, double y, double z) override;
+
+		void noise(const float* xs, const float* ys, const float* zs, float* out, std::size_t n) override;
+		// Coordinates must stay below 2^22 in magnitude
+		void noise(const float* xs, const float* ys, const float* zs, float* out, std::size_t n, const Period& period) override;
+		void noiseWithGradient(const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n) override;
+		void noiseWithGradient(const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n, const Period& period) override;
+		bool tiles() override;
+
+		// the table the noise hashes with, also uploaded for the GLSL noise
+		const PermutationTable& getPermutations();
 
 	private:
-		 std::vector<int> permutations;
+		 alignas(64) PermutationTable permutations;
+		 std::uint32_t seed;
 
 		 double fade(double t);
 		 double lerp(double t, double a, double b);
@@ -26,4 +55,3 @@ namespace mgl {
 }
 
 #endif // !MGL_PERLIN_NOISE_HPP
-
@@ -0,0 +1,537 @@
+#include "perlinNoise.hpp"
+
+#include <cmath>
+#include <cstdint>
+
+#include "noiseSimd.hpp"
+
+namespace mgl {
+
+	////////////////////////////////////////////////////////////////////// SCALAR
+
+	static inline float fadef(float t) {
+		return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+	}
+
+	static inline float lerpf(float a, float b, float t) {
+		return a + t * (b - a);
+	}
+
+	static void noiseScalar(const std::uint8_t* p, const float* xs, const float* ys, const float* zs, float* out, std::size_t n) {
+		for (std::size_t i = 0; i < n; ++i) {
+			float x = xs[i], y = ys[i], z = zs[i];
+			float fx = std::floor(x), fy = std::floor(y), fz = std::floor(z);
+			int X = (int)fx & 255;
+			int Y = (int)fy & 255;
+			int Z = (int)fz & 255;
+			x -= fx;
+			y -= fy;
+			z -= fz;
+
+			float u = fadef(x);
+			float v = fadef(y);
+			float w = fadef(z);
+
+			int A = p[X] + Y, B = p[X + 1] + Y;
+			int AA = p[A] + Z, AB = p[A + 1] + Z;
+			int BA = p[B] + Z, BB = p[B + 1] + Z;
+
+			float x11 = lerpf(gradf(p[AA], x, y, z), gradf(p[BA], x - 1, y, z), u);
+			float x12 = lerpf(gradf(p[AB], x, y - 1, z), gradf(p[BB], x - 1, y - 1, z), u);
+			float x21 = lerpf(gradf(p[AA + 1], x, y, z - 1), gradf(p[BA + 1], x - 1, y, z - 1), u);
+			float x22 = lerpf(gradf(p[AB + 1], x, y - 1, z - 1), gradf(p[BB + 1], x - 1, y - 1, z - 1), u);
+
+			float y1 = lerpf(x11, x12, v);
+			float y2 = lerpf(x21, x22, v);
+
+			out[i] = lerpf(y1, y2, w);
+		}
+	}
+
+	// The cell of an already floored coordinate, wrapped into [0, period). Done in
+	// float so the AVX2 kernel, which has no integer division, gets the same cells.
+	static inline int wrapCell(float floored, float period) {
+		return (int)(floored - period * std::floor(floored / period));
+	}
+
+	// Without the duplicated table trick: the neighbour of the last cell of a period
+	// is cell 0, so every corner hash is looked up on its own.
+	static void noisePeriodicScalar(const std::uint8_t* p, const PerlinNoiseGenerator::Period& period, const float* xs, const float* ys, const float* zs, float* out, std::size_t n) {
+		const float px = (float)period.x, py = (float)period.y, pz = (float)period.z;
+		for (std::size_t i = 0; i < n; ++i) {
+			float x = xs[i], y = ys[i], z = zs[i];
+			float fx = std::floor(x), fy = std::floor(y), fz = std::floor(z);
+			int X0 = wrapCell(fx, px), Y0 = wrapCell(fy, py), Z0 = wrapCell(fz, pz);
+			int X1 = X0 + 1 == period.x ? 0 : X0 + 1;
+			int Y1 = Y0 + 1 == period.y ? 0 : Y0 + 1;
+			int Z1 = Z0 + 1 == period.z ? 0 : Z0 + 1;
+			X0 &= 255; Y0 &= 255; Z0 &= 255;
+			X1 &= 255; Y1 &= 255; Z1 &= 255;
+			x -= fx;
+			y -= fy;
+			z -= fz;
+
+			float u = fadef(x);
+			float v = fadef(y);
+			float w = fadef(z);
+
+			int A = p[X0], B = p[X1];
+			int AA = p[A + Y0], AB = p[A + Y1];
+			int BA = p[B + Y0], BB = p[B + Y1];
+
+			float x11 = lerpf(gradf(p[AA + Z0], x, y, z), gradf(p[BA + Z0], x - 1, y, z), u);
+			float x12 = lerpf(gradf(p[AB + Z0], x, y - 1, z), gradf(p[BB + Z0], x - 1, y - 1, z), u);
+			float x21 = lerpf(gradf(p[AA + Z1], x, y, z - 1), gradf(p[BA + Z1], x - 1, y, z - 1), u);
+			float x22 = lerpf(gradf(p[AB + Z1], x, y - 1, z - 1), gradf(p[BB + Z1], x - 1, y - 1, z - 1), u);
+
+			float y1 = lerpf(x11, x12, v);
+			float y2 = lerpf(x21, x22, v);
+
+			out[i] = lerpf(y1, y2, w);
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////// GRADIENT
+
+	// d fade(t) / dt
+	static inline float fadeDerivativef(float t) {
+		float s = t * (t - 1.0f);
+		return 30.0f * s * s;
+	}
+
+	// Trilinear blend of values at the corners of a cell, ordered as in cellWithGradient
+	static inline float trilerpf(const float (&g)[8], float u, float v, float w) {
+		return lerpf(lerpf(lerpf(g[0], g[1], u), lerpf(g[2], g[3], u), v), lerpf(lerpf(g[4], g[5], u), lerpf(g[6], g[7], u), v), w);
+	}
+
+	// Noise of a cell with its gradient. h[c] is the hash of the corner (c & 1, c >> 1 & 1, c >> 2),
+	// x, y, z the position relative to corner 0. The value is computed as noiseScalar computes it,
+	// the gradient is the blend of the corner gradients plus the slope of the fade curves times
+	// the difference across the cell along each axis.
+	static inline float cellWithGradient(const int (&h)[8], float x, float y, float z, float& dx, float& dy, float& dz) {
+		float u = fadef(x);
+		float v = fadef(y);
+		float w = fadef(z);
+
+		float a[8], gx[8], gy[8], gz[8];
+		for (int c = 0; c < 8; ++c) {
+			a[c] = gradf(h[c], c & 1 ? x - 1 : x, c & 2 ? y - 1 : y, c & 4 ? z - 1 : z);
+			gradVectorf(h[c], gx[c], gy[c], gz[c]);
+		}
+
+		float x11 = lerpf(a[0], a[1], u);
+		float x12 = lerpf(a[2], a[3], u);
+		float x21 = lerpf(a[4], a[5], u);
+		float x22 = lerpf(a[6], a[7], u);
+
+		float y1 = lerpf(x11, x12, v);
+		float y2 = lerpf(x21, x22, v);
+
+		dx = trilerpf(gx, u, v, w) + fadeDerivativef(x) * lerpf(lerpf(a[1] - a[0], a[3] - a[2], v), lerpf(a[5] - a[4], a[7] - a[6], v), w);
+		dy = trilerpf(gy, u, v, w) + fadeDerivativef(y) * lerpf(x12 - x11, x22 - x21, w);
+		dz = trilerpf(gz, u, v, w) + fadeDerivativef(z) * (y2 - y1);
+		return lerpf(y1, y2, w);
+	}
+
+	static void noiseWithGradientScalar(const std::uint8_t* p, const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n) {
+		for (std::size_t i = 0; i < n; ++i) {
+			float x = xs[i], y = ys[i], z = zs[i];
+			float fx = std::floor(x), fy = std::floor(y), fz = std::floor(z);
+			int X = (int)fx & 255;
+			int Y = (int)fy & 255;
+			int Z = (int)fz & 255;
+
+			int A = p[X] + Y, B = p[X + 1] + Y;
+			int AA = p[A] + Z, AB = p[A + 1] + Z;
+			int BA = p[B] + Z, BB = p[B + 1] + Z;
+			const int h[8] = { p[AA], p[BA], p[AB], p[BB], p[AA + 1], p[BA + 1], p[AB + 1], p[BB + 1] };
+
+			out[i] = cellWithGradient(h, x - fx, y - fy, z - fz, dxs[i], dys[i], dzs[i]);
+		}
+	}
+
+	static void noiseWithGradientPeriodicScalar(const std::uint8_t* p, const PerlinNoiseGenerator::Period& period, const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n) {
+		const float px = (float)period.x, py = (float)period.y, pz = (float)period.z;
+		for (std::size_t i = 0; i < n; ++i) {
+			float x = xs[i], y = ys[i], z = zs[i];
+			float fx = std::floor(x), fy = std::floor(y), fz = std::floor(z);
+			int X0 = wrapCell(fx, px), Y0 = wrapCell(fy, py), Z0 = wrapCell(fz, pz);
+			int X1 = X0 + 1 == period.x ? 0 : X0 + 1;
+			int Y1 = Y0 + 1 == period.y ? 0 : Y0 + 1;
+			int Z1 = Z0 + 1 == period.z ? 0 : Z0 + 1;
+			X0 &= 255; Y0 &= 255; Z0 &= 255;
+			X1 &= 255; Y1 &= 255; Z1 &= 255;
+
+			int A = p[X0], B = p[X1];
+			int AA = p[A + Y0], AB = p[A + Y1];
+			int BA = p[B + Y0], BB = p[B + Y1];
+			const int h[8] = { p[AA + Z0], p[BA + Z0], p[AB + Z0], p[BB + Z0], p[AA + Z1], p[BA + Z1], p[AB + Z1], p[BB + Z1] };
+
+			out[i] = cellWithGradient(h, x - fx, y - fy, z - fz, dxs[i], dys[i], dzs[i]);
+		}
+	}
+
+#ifdef MGL_NOISE_X86
+
+	////////////////////////////////////////////////////////////////////// SSE4.1
+
+	MGL_TARGET_SSE41 static inline __m128 fade4(__m128 t) {
+		__m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+		return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+	}
+
+	MGL_TARGET_SSE41 static inline __m128 lerp4(__m128 a, __m128 b, __m128 t) {
+		return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+	}
+
+	MGL_TARGET_SSE41 static inline __m128 grad4(__m128i hash, __m128 x, __m128 y, __m128 z) {
+		__m128i h = _mm_and_si128(hash, _mm_set1_epi32(0xF));
+		__m128 hLess8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+		__m128 hLess4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+		__m128 h12or14 = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)), _mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+		__m128 u = _mm_blendv_ps(y, x, hLess8);
+		__m128 v = _mm_blendv_ps(_mm_blendv_ps(z, x, h12or14), y, hLess4);
+		__m128 uSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), 31));
+		__m128 vSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), 30));
+		return _mm_add_ps(_mm_xor_ps(u, uSign), _mm_xor_ps(v, vSign));
+	}
+
+	// p[i] | p[i + 1] << 8 in each lane. SSE has no gather, the lookups go through the stack.
+	MGL_TARGET_SSE41 static inline __m128i gatherPairs4(const std::uint8_t* p, __m128i index) {
+		alignas(16) int i[4];
+		_mm_store_si128((__m128i*)i, index);
+		std::uint16_t pair[4];
+		for (int k = 0; k < 4; ++k) {
+			std::memcpy(&pair[k], p + i[k], sizeof(std::uint16_t));
+		}
+		return _mm_setr_epi32(pair[0], pair[1], pair[2], pair[3]);
+	}
+
+	MGL_TARGET_SSE41 static void noiseSSE41(const std::uint8_t* p, const float* xs, const float* ys, const float* zs, float* out, std::size_t n) {
+		const __m128i mask = _mm_set1_epi32(255);
+		const __m128 fone = _mm_set1_ps(1.0f);
+
+		std::size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m128 x = _mm_loadu_ps(xs + i);
+			__m128 y = _mm_loadu_ps(ys + i);
+			__m128 z = _mm_loadu_ps(zs + i);
+			__m128 fx = _mm_floor_ps(x);
+			__m128 fy = _mm_floor_ps(y);
+			__m128 fz = _mm_floor_ps(z);
+			__m128i X = _mm_and_si128(_mm_cvttps_epi32(fx), mask);
+			__m128i Y = _mm_and_si128(_mm_cvttps_epi32(fy), mask);
+			__m128i Z = _mm_and_si128(_mm_cvttps_epi32(fz), mask);
+			x = _mm_sub_ps(x, fx);
+			y = _mm_sub_ps(y, fy);
+			z = _mm_sub_ps(z, fz);
+
+			__m128 u = fade4(x);
+			__m128 v = fade4(y);
+			__m128 w = fade4(z);
+
+			// seven pair lookups instead of fourteen single ones, grad4 only
+			// looks at the low four bits so the corner hashes need no masking
+			__m128i XP = gatherPairs4(p, X);
+			__m128i A = _mm_add_epi32(_mm_and_si128(XP, mask), Y);
+			__m128i B = _mm_add_epi32(_mm_srli_epi32(XP, 8), Y);
+			__m128i AP = gatherPairs4(p, A);
+			__m128i BP = gatherPairs4(p, B);
+			__m128i AAP = gatherPairs4(p, _mm_add_epi32(_mm_and_si128(AP, mask), Z));
+			__m128i ABP = gatherPairs4(p, _mm_add_epi32(_mm_srli_epi32(AP, 8), Z));
+			__m128i BAP = gatherPairs4(p, _mm_add_epi32(_mm_and_si128(BP, mask), Z));
+			__m128i BBP = gatherPairs4(p, _mm_add_epi32(_mm_srli_epi32(BP, 8), Z));
+
+			__m128 x1 = _mm_sub_ps(x, fone);
+			__m128 y1 = _mm_sub_ps(y, fone);
+			__m128 z1 = _mm_sub_ps(z, fone);
+
+			__m128 x11 = lerp4(grad4(AAP, x, y, z), grad4(BAP, x1, y, z), u);
+			__m128 x12 = lerp4(grad4(ABP, x, y1, z), grad4(BBP, x1, y1, z), u);
+			__m128 x21 = lerp4(grad4(_mm_srli_epi32(AAP, 8), x, y, z1), grad4(_mm_srli_epi32(BAP, 8), x1, y, z1), u);
+			__m128 x22 = lerp4(grad4(_mm_srli_epi32(ABP, 8), x, y1, z1), grad4(_mm_srli_epi32(BBP, 8), x1, y1, z1), u);
+
+			_mm_storeu_ps(out + i, lerp4(lerp4(x11, x12, v), lerp4(x21, x22, v), w));
+		}
+		noiseScalar(p, xs + i, ys + i, zs + i, out + i, n - i);
+	}
+
+	//////////////////////////////////////////////////////////////////////// AVX2
+
+	MGL_TARGET_AVX2 static inline __m256 fade8(__m256 t) {
+		__m256 inner = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+		return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), inner);
+	}
+
+	MGL_TARGET_AVX2 static inline __m256 lerp8(__m256 a, __m256 b, __m256 t) {
+		return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+	}
+
+	MGL_TARGET_AVX2 static void noiseAVX2(const std::uint8_t* p, const float* xs, const float* ys, const float* zs, float* out, std::size_t n) {
+		const __m256i mask = _mm256_set1_epi32(255);
+		const __m256 fone = _mm256_set1_ps(1.0f);
+
+		std::size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256 x = _mm256_loadu_ps(xs + i);
+			__m256 y = _mm256_loadu_ps(ys + i);
+			__m256 z = _mm256_loadu_ps(zs + i);
+			__m256 fx = _mm256_floor_ps(x);
+			__m256 fy = _mm256_floor_ps(y);
+			__m256 fz = _mm256_floor_ps(z);
+			__m256i X = _mm256_and_si256(_mm256_cvttps_epi32(fx), mask);
+			__m256i Y = _mm256_and_si256(_mm256_cvttps_epi32(fy), mask);
+			__m256i Z = _mm256_and_si256(_mm256_cvttps_epi32(fz), mask);
+			x = _mm256_sub_ps(x, fx);
+			y = _mm256_sub_ps(y, fy);
+			z = _mm256_sub_ps(z, fz);
+
+			__m256 u = fade8(x);
+			__m256 v = fade8(y);
+			__m256 w = fade8(z);
+
+			// seven pair gathers instead of fourteen single ones, grad8 only
+			// looks at the low four bits so the corner hashes need no masking
+			__m256i XP = gatherPairs8(p, X);
+			__m256i A = _mm256_add_epi32(_mm256_and_si256(XP, mask), Y);
+			__m256i B = _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(XP, 8), mask), Y);
+			__m256i AP = gatherPairs8(p, A);
+			__m256i BP = gatherPairs8(p, B);
+			__m256i AAP = gatherPairs8(p, _mm256_add_epi32(_mm256_and_si256(AP, mask), Z));
+			__m256i ABP = gatherPairs8(p, _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(AP, 8), mask), Z));
+			__m256i BAP = gatherPairs8(p, _mm256_add_epi32(_mm256_and_si256(BP, mask), Z));
+			__m256i BBP = gatherPairs8(p, _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(BP, 8), mask), Z));
+
+			__m256 x1 = _mm256_sub_ps(x, fone);
+			__m256 y1 = _mm256_sub_ps(y, fone);
+			__m256 z1 = _mm256_sub_ps(z, fone);
+
+			__m256 x11 = lerp8(grad8(AAP, x, y, z), grad8(BAP, x1, y, z), u);
+			__m256 x12 = lerp8(grad8(ABP, x, y1, z), grad8(BBP, x1, y1, z), u);
+			__m256 x21 = lerp8(grad8(_mm256_srli_epi32(AAP, 8), x, y, z1), grad8(_mm256_srli_epi32(BAP, 8), x1, y, z1), u);
+			__m256 x22 = lerp8(grad8(_mm256_srli_epi32(ABP, 8), x, y1, z1), grad8(_mm256_srli_epi32(BBP, 8), x1, y1, z1), u);
+
+			_mm256_storeu_ps(out + i, lerp8(lerp8(x11, x12, v), lerp8(x21, x22, v), w));
+		}
+		noiseScalar(p, xs + i, ys + i, zs + i, out + i, n - i);
+	}
+
+	// cell and next cell of floored, both wrapped into [0, period) and masked to the table
+	MGL_TARGET_AVX2 static inline void wrapCells8(__m256 floored, __m256 period, __m256i periodCells, __m256i& cell, __m256i& next) {
+		const __m256i mask = _mm256_set1_epi32(255);
+		cell = _mm256_cvttps_epi32(_mm256_sub_ps(floored, _mm256_mul_ps(period, _mm256_floor_ps(_mm256_div_ps(floored, period)))));
+		next = _mm256_add_epi32(cell, _mm256_set1_epi32(1));
+		next = _mm256_andnot_si256(_mm256_cmpeq_epi32(next, periodCells), next);
+		cell = _mm256_and_si256(cell, mask);
+		next = _mm256_and_si256(next, mask);
+	}
+
+	MGL_TARGET_AVX2 static inline __m256i gather8(const std::uint8_t* p, __m256i index) {
+		return _mm256_and_si256(gatherPairs8(p, index), _mm256_set1_epi32(255));
+	}
+
+	MGL_TARGET_AVX2 static void noisePeriodicAVX2(const std::uint8_t* p, const PerlinNoiseGenerator::Period& period, const float* xs, const float* ys, const float* zs, float* out, std::size_t n) {
+		const __m256 px = _mm256_set1_ps((float)period.x), py = _mm256_set1_ps((float)period.y), pz = _mm256_set1_ps((float)period.z);
+		const __m256i pxi = _mm256_set1_epi32(period.x), pyi = _mm256_set1_epi32(period.y), pzi = _mm256_set1_epi32(period.z);
+		const __m256 fone = _mm256_set1_ps(1.0f);
+
+		std::size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256 x = _mm256_loadu_ps(xs + i);
+			__m256 y = _mm256_loadu_ps(ys + i);
+			__m256 z = _mm256_loadu_ps(zs + i);
+			__m256 fx = _mm256_floor_ps(x);
+			__m256 fy = _mm256_floor_ps(y);
+			__m256 fz = _mm256_floor_ps(z);
+			__m256i X0, X1, Y0, Y1, Z0, Z1;
+			wrapCells8(fx, px, pxi, X0, X1);
+			wrapCells8(fy, py, pyi, Y0, Y1);
+			wrapCells8(fz, pz, pzi, Z0, Z1);
+			x = _mm256_sub_ps(x, fx);
+			y = _mm256_sub_ps(y, fy);
+			z = _mm256_sub_ps(z, fz);
+
+			__m256 u = fade8(x);
+			__m256 v = fade8(y);
+			__m256 w = fade8(z);
+
+			__m256i A = gather8(p, X0), B = gather8(p, X1);
+			__m256i AA = gather8(p, _mm256_add_epi32(A, Y0)), AB = gather8(p, _mm256_add_epi32(A, Y1));
+			__m256i BA = gather8(p, _mm256_add_epi32(B, Y0)), BB = gather8(p, _mm256_add_epi32(B, Y1));
+
+			__m256 x1 = _mm256_sub_ps(x, fone);
+			__m256 y1 = _mm256_sub_ps(y, fone);
+			__m256 z1 = _mm256_sub_ps(z, fone);
+
+			// grad8 only looks at the low four bits, the corner hashes need no masking
+			__m256 x11 = lerp8(grad8(gatherPairs8(p, _mm256_add_epi32(AA, Z0)), x, y, z), grad8(gatherPairs8(p, _mm256_add_epi32(BA, Z0)), x1, y, z), u);
+			__m256 x12 = lerp8(grad8(gatherPairs8(p, _mm256_add_epi32(AB, Z0)), x, y1, z), grad8(gatherPairs8(p, _mm256_add_epi32(BB, Z0)), x1, y1, z), u);
+			__m256 x21 = lerp8(grad8(gatherPairs8(p, _mm256_add_epi32(AA, Z1)), x, y, z1), grad8(gatherPairs8(p, _mm256_add_epi32(BA, Z1)), x1, y, z1), u);
+			__m256 x22 = lerp8(grad8(gatherPairs8(p, _mm256_add_epi32(AB, Z1)), x, y1, z1), grad8(gatherPairs8(p, _mm256_add_epi32(BB, Z1)), x1, y1, z1), u);
+
+			_mm256_storeu_ps(out + i, lerp8(lerp8(x11, x12, v), lerp8(x21, x22, v), w));
+		}
+		noisePeriodicScalar(p, period, xs + i, ys + i, zs + i, out + i, n - i);
+	}
+
+	MGL_TARGET_AVX2 static inline __m256 fadeDerivative8(__m256 t) {
+		__m256 s = _mm256_mul_ps(t, _mm256_sub_ps(t, _mm256_set1_ps(1.0f)));
+		return _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(30.0f), s), s);
+	}
+
+	MGL_TARGET_AVX2 static inline __m256 trilerp8(const __m256 (&g)[8], __m256 u, __m256 v, __m256 w) {
+		return lerp8(lerp8(lerp8(g[0], g[1], u), lerp8(g[2], g[3], u), v), lerp8(lerp8(g[4], g[5], u), lerp8(g[6], g[7], u), v), w);
+	}
+
+	// cellWithGradient of each lane, h[c] only needs its low four bits right
+	MGL_TARGET_AVX2 static inline __m256 cellWithGradient8(const __m256i (&h)[8], __m256 x, __m256 y, __m256 z, __m256& dx, __m256& dy, __m256& dz) {
+		const __m256 fone = _mm256_set1_ps(1.0f);
+		__m256 u = fade8(x);
+		__m256 v = fade8(y);
+		__m256 w = fade8(z);
+		__m256 x1 = _mm256_sub_ps(x, fone);
+		__m256 y1 = _mm256_sub_ps(y, fone);
+		__m256 z1 = _mm256_sub_ps(z, fone);
+
+		__m256 a[8], gx[8], gy[8], gz[8];
+		for (int c = 0; c < 8; ++c) {
+			a[c] = grad8(h[c], c & 1 ? x1 : x, c & 2 ? y1 : y, c & 4 ? z1 : z);
+			gradVector8(h[c], gx[c], gy[c], gz[c]);
+		}
+
+		__m256 x11 = lerp8(a[0], a[1], u);
+		__m256 x12 = lerp8(a[2], a[3], u);
+		__m256 x21 = lerp8(a[4], a[5], u);
+		__m256 x22 = lerp8(a[6], a[7], u);
+
+		__m256 ya = lerp8(x11, x12, v);
+		__m256 yb = lerp8(x21, x22, v);
+
+		__m256 acrossX = lerp8(lerp8(_mm256_sub_ps(a[1], a[0]), _mm256_sub_ps(a[3], a[2]), v), lerp8(_mm256_sub_ps(a[5], a[4]), _mm256_sub_ps(a[7], a[6]), v), w);
+		dx = _mm256_add_ps(trilerp8(gx, u, v, w), _mm256_mul_ps(fadeDerivative8(x), acrossX));
+		dy = _mm256_add_ps(trilerp8(gy, u, v, w), _mm256_mul_ps(fadeDerivative8(y), lerp8(_mm256_sub_ps(x12, x11), _mm256_sub_ps(x22, x21), w)));
+		dz = _mm256_add_ps(trilerp8(gz, u, v, w), _mm256_mul_ps(fadeDerivative8(z), _mm256_sub_ps(yb, ya)));
+		return lerp8(ya, yb, w);
+	}
+
+	MGL_TARGET_AVX2 static void noiseWithGradientAVX2(const std::uint8_t* p, const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n) {
+		const __m256i mask = _mm256_set1_epi32(255);
+
+		std::size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256 x = _mm256_loadu_ps(xs + i);
+			__m256 y = _mm256_loadu_ps(ys + i);
+			__m256 z = _mm256_loadu_ps(zs + i);
+			__m256 fx = _mm256_floor_ps(x);
+			__m256 fy = _mm256_floor_ps(y);
+			__m256 fz = _mm256_floor_ps(z);
+			__m256i X = _mm256_and_si256(_mm256_cvttps_epi32(fx), mask);
+			__m256i Y = _mm256_and_si256(_mm256_cvttps_epi32(fy), mask);
+			__m256i Z = _mm256_and_si256(_mm256_cvttps_epi32(fz), mask);
+
+			__m256i XP = gatherPairs8(p, X);
+			__m256i A = _mm256_add_epi32(_mm256_and_si256(XP, mask), Y);
+			__m256i B = _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(XP, 8), mask), Y);
+			__m256i AP = gatherPairs8(p, A);
+			__m256i BP = gatherPairs8(p, B);
+			__m256i AAP = gatherPairs8(p, _mm256_add_epi32(_mm256_and_si256(AP, mask), Z));
+			__m256i ABP = gatherPairs8(p, _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(AP, 8), mask), Z));
+			__m256i BAP = gatherPairs8(p, _mm256_add_epi32(_mm256_and_si256(BP, mask), Z));
+			__m256i BBP = gatherPairs8(p, _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(BP, 8), mask), Z));
+			const __m256i h[8] = { AAP, BAP, ABP, BBP, _mm256_srli_epi32(AAP, 8), _mm256_srli_epi32(BAP, 8), _mm256_srli_epi32(ABP, 8), _mm256_srli_epi32(BBP, 8) };
+
+			__m256 dx, dy, dz;
+			_mm256_storeu_ps(out + i, cellWithGradient8(h, _mm256_sub_ps(x, fx), _mm256_sub_ps(y, fy), _mm256_sub_ps(z, fz), dx, dy, dz));
+			_mm256_storeu_ps(dxs + i, dx);
+			_mm256_storeu_ps(dys + i, dy);
+			_mm256_storeu_ps(dzs + i, dz);
+		}
+		noiseWithGradientScalar(p, xs + i, ys + i, zs + i, out + i, dxs + i, dys + i, dzs + i, n - i);
+	}
+
+	MGL_TARGET_AVX2 static void noiseWithGradientPeriodicAVX2(const std::uint8_t* p, const PerlinNoiseGenerator::Period& period, const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n) {
+		const __m256 px = _mm256_set1_ps((float)period.x), py = _mm256_set1_ps((float)period.y), pz = _mm256_set1_ps((float)period.z);
+		const __m256i pxi = _mm256_set1_epi32(period.x), pyi = _mm256_set1_epi32(period.y), pzi = _mm256_set1_epi32(period.z);
+
+		std::size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256 x = _mm256_loadu_ps(xs + i);
+			__m256 y = _mm256_loadu_ps(ys + i);
+			__m256 z = _mm256_loadu_ps(zs + i);
+			__m256 fx = _mm256_floor_ps(x);
+			__m256 fy = _mm256_floor_ps(y);
+			__m256 fz = _mm256_floor_ps(z);
+			__m256i X0, X1, Y0, Y1, Z0, Z1;
+			wrapCells8(fx, px, pxi, X0, X1);
+			wrapCells8(fy, py, pyi, Y0, Y1);
+			wrapCells8(fz, pz, pzi, Z0, Z1);
+
+			__m256i A = gather8(p, X0), B = gather8(p, X1);
+			__m256i AA = gather8(p, _mm256_add_epi32(A, Y0)), AB = gather8(p, _mm256_add_epi32(A, Y1));
+			__m256i BA = gather8(p, _mm256_add_epi32(B, Y0)), BB = gather8(p, _mm256_add_epi32(B, Y1));
+			const __m256i h[8] = {
+				gatherPairs8(p, _mm256_add_epi32(AA, Z0)), gatherPairs8(p, _mm256_add_epi32(BA, Z0)),
+				gatherPairs8(p, _mm256_add_epi32(AB, Z0)), gatherPairs8(p, _mm256_add_epi32(BB, Z0)),
+				gatherPairs8(p, _mm256_add_epi32(AA, Z1)), gatherPairs8(p, _mm256_add_epi32(BA, Z1)),
+				gatherPairs8(p, _mm256_add_epi32(AB, Z1)), gatherPairs8(p, _mm256_add_epi32(BB, Z1))
+			};
+
+			__m256 dx, dy, dz;
+			_mm256_storeu_ps(out + i, cellWithGradient8(h, _mm256_sub_ps(x, fx), _mm256_sub_ps(y, fy), _mm256_sub_ps(z, fz), dx, dy, dz));
+			_mm256_storeu_ps(dxs + i, dx);
+			_mm256_storeu_ps(dys + i, dy);
+			_mm256_storeu_ps(dzs + i, dz);
+		}
+		noiseWithGradientPeriodicScalar(p, period, xs + i, ys + i, zs + i, out + i, dxs + i, dys + i, dzs + i, n - i);
+	}
+
+#endif // MGL_NOISE_X86
+
+	//////////////////////////////////////////////////////////////////// DISPATCH
+
+	void PerlinNoiseGenerator::noise(const float* xs, const float* ys, const float* zs, float* out, std::size_t n) {
+		const std::uint8_t* p = permutations.data();
+		switch (simdLevel) {
+#ifdef MGL_NOISE_X86
+			case AVX2: noiseAVX2(p, xs, ys, zs, out, n); break;
+			case SSE41: noiseSSE41(p, xs, ys, zs, out, n); break;
+#endif
+			default: noiseScalar(p, xs, ys, zs, out, n); break;
+		}
+	}
+
+	void PerlinNoiseGenerator::noise(const float* xs, const float* ys, const float* zs, float* out, std::size_t n, const Period& period) {
+		// only AVX2 has a periodic kernel, the extra lookups leave SSE4.1 little to gain
+		const std::uint8_t* p = permutations.data();
+#ifdef MGL_NOISE_X86
+		if (simdLevel == AVX2) {
+			noisePeriodicAVX2(p, period, xs, ys, zs, out, n);
+			return;
+		}
+#endif
+		noisePeriodicScalar(p, period, xs, ys, zs, out, n);
+	}
+
+	void PerlinNoiseGenerator::noiseWithGradient(const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n) {
+		const std::uint8_t* p = permutations.data();
+#ifdef MGL_NOISE_X86
+		if (simdLevel == AVX2) {
+			noiseWithGradientAVX2(p, xs, ys, zs, out, dxs, dys, dzs, n);
+			return;
+		}
+#endif
+		noiseWithGradientScalar(p, xs, ys, zs, out, dxs, dys, dzs, n);
+	}
+
+	void PerlinNoiseGenerator::noiseWithGradient(const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n, const Period& period) {
+		const std::uint8_t* p = permutations.data();
+#ifdef MGL_NOISE_X86
+		if (simdLevel == AVX2) {
+			noiseWithGradientPeriodicAVX2(p, period, xs, ys, zs, out, dxs, dys, dzs, n);
+			return;
+		}
+#endif
+		noiseWithGradientPeriodicScalar(p, period, xs, ys, zs, out, dxs, dys, dzs, n);
+	}
+
+}
@@ -0,0 +1,346 @@
+#include "simplexNoise.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "noiseSimd.hpp"
+
+namespace mgl {
+
+	// Skew of the lattice into the cube grid and back
+	static constexpr float F3 = 1.0f / 3.0f;
+	static constexpr float G3 = 1.0f / 6.0f;
+	// Squared radius of the corner falloff. At 0.5 it ends at the faces of the simplices
+	// around the corner, any larger and the noise jumps where a point changes simplex.
+	// A single corner peaks at 0.0130 and the sum never goes higher, so a scale of 76
+	// would bring it to [-1, 1]. This one gives it the standard deviation of the Perlin
+	// noise (0.27) instead so the texture recipes keep their contrast whichever backend
+	// they run on.
+	static constexpr float RADIUS = 0.5f;
+	static constexpr float SCALE = 52.8f;
+
+	// Lattice hash: each axis times its own odd constant, xored with the seed, then
+	// one multiply and shift to mix. The top four bits pick the gradient.
+	static constexpr std::uint32_t PRIME_X = 0x8DA6B343u;
+	static constexpr std::uint32_t PRIME_Y = 0xD8163841u;
+	static constexpr std::uint32_t PRIME_Z = 0xCB1AB31Fu;
+	static constexpr std::uint32_t MIX = 0x27D4EB2Du;
+
+	static inline int hashCorner(std::uint32_t hx, std::uint32_t hy, std::uint32_t hz, std::uint32_t seed) {
+		std::uint32_t h = hx ^ hy ^ hz ^ seed;
+		h *= MIX;
+		h ^= h >> 15;
+		return (int)(h >> 28);
+	}
+
+	SimplexNoiseGenerator::SimplexNoiseGenerator(std::uint32_t seed) : seed(seed), seedHash(seed * 0x9E3779B9u) {}
+
+	SimplexNoiseGenerator::~SimplexNoiseGenerator() {}
+
+	NoiseGenerator::Backend SimplexNoiseGenerator::getBackend() {
+		return SIMPLEX;
+	}
+
+	std::uint32_t SimplexNoiseGenerator::getSeed() {
+		return seed;
+	}
+
+	bool SimplexNoiseGenerator::tiles() {
+		return false;
+	}
+
+	// Contribution of one corner, x, y, z relative to it
+	static inline double corner(int hash, double x, double y, double z) {
+		double t = RADIUS - x * x - y * y - z * z;
+		if (t < 0.0) return 0.0;
+		unsigned int h = hash & 0xF;
+		const double c[3] = { x, y, z };
+		double u = h & 1 ? -c[GRAD_U[h]] : c[GRAD_U[h]];
+		double v = h & 2 ? -c[GRAD_V[h]] : c[GRAD_V[h]];
+		t *= t;
+		return t * t * (u + v);
+	}
+
+	double SimplexNoiseGenerator::noise(double x, double y, double z) {
+		// Find the cube of the skewed lattice that contains the point, its origin
+		// unskewed and the point relative to it
+		double s = (x + y + z) * (1.0 / 3.0);
+		double fi = std::floor(x + s), fj = std::floor(y + s), fk = std::floor(z + s);
+		double t = (fi + fj + fk) * (1.0 / 6.0);
+		double x0 = x - (fi - t), y0 = y - (fj - t), z0 = z - (fk - t);
+
+		// The cube splits in 6 tetrahedra, the order of x0, y0, z0 picks the one
+		// and so its second and third corner
+		int i1 = x0 >= y0 && x0 >= z0, j1 = x0 < y0 && y0 >= z0, k1 = x0 < z0 && y0 < z0;
+		int i2 = x0 >= y0 || x0 >= z0, j2 = x0 < y0 || y0 >= z0, k2 = x0 < z0 || y0 < z0;
+
+		std::uint32_t hx = (std::uint32_t)(int)fi * PRIME_X, hy = (std::uint32_t)(int)fj * PRIME_Y, hz = (std::uint32_t)(int)fk * PRIME_Z;
+		int h0 = hashCorner(hx, hy, hz, seedHash);
+		int h1 = hashCorner(hx + i1 * PRIME_X, hy + j1 * PRIME_Y, hz + k1 * PRIME_Z, seedHash);
+		int h2 = hashCorner(hx + i2 * PRIME_X, hy + j2 * PRIME_Y, hz + k2 * PRIME_Z, seedHash);
+		int h3 = hashCorner(hx + PRIME_X, hy + PRIME_Y, hz + PRIME_Z, seedHash);
+
+		double n = corner(h0, x0, y0, z0)
+			+ corner(h1, x0 - i1 + (1.0 / 6.0), y0 - j1 + (1.0 / 6.0), z0 - k1 + (1.0 / 6.0))
+			+ corner(h2, x0 - i2 + (2.0 / 6.0), y0 - j2 + (2.0 / 6.0), z0 - k2 + (2.0 / 6.0))
+			+ corner(h3, x0 - 1.0 + (3.0 / 6.0), y0 - 1.0 + (3.0 / 6.0), z0 - 1.0 + (3.0 / 6.0));
+		return SCALE * n;
+	}
+
+	////////////////////////////////////////////////////////////////////// SCALAR
+
+	static inline float cornerf(int hash, float x, float y, float z) {
+		float t = std::max(RADIUS - x * x - y * y - z * z, 0.0f);
+		t *= t;
+		return t * t * gradf(hash, x, y, z);
+	}
+
+	static void noiseScalar(std::uint32_t seed, const float* xs, const float* ys, const float* zs, float* out, std::size_t n) {
+		for (std::size_t i = 0; i < n; ++i) {
+			float x = xs[i], y = ys[i], z = zs[i];
+			float s = (x + y + z) * F3;
+			float fi = std::floor(x + s), fj = std::floor(y + s), fk = std::floor(z + s);
+			float t = (fi + fj + fk) * G3;
+			float x0 = x - (fi - t), y0 = y - (fj - t), z0 = z - (fk - t);
+
+			bool xy = x0 >= y0, xz = x0 >= z0, yz = y0 >= z0;
+			int i1 = xy && xz, j1 = !xy && yz, k1 = !xz && !yz;
+			int i2 = xy || xz, j2 = !xy || yz, k2 = !xz || !yz;
+
+			std::uint32_t hx = (std::uint32_t)(int)fi * PRIME_X, hy = (std::uint32_t)(int)fj * PRIME_Y, hz = (std::uint32_t)(int)fk * PRIME_Z;
+			int h0 = hashCorner(hx, hy, hz, seed);
+			int h1 = hashCorner(hx + i1 * PRIME_X, hy + j1 * PRIME_Y, hz + k1 * PRIME_Z, seed);
+			int h2 = hashCorner(hx + i2 * PRIME_X, hy + j2 * PRIME_Y, hz + k2 * PRIME_Z, seed);
+			int h3 = hashCorner(hx + PRIME_X, hy + PRIME_Y, hz + PRIME_Z, seed);
+
+			float n0 = cornerf(h0, x0, y0, z0);
+			float n1 = cornerf(h1, (x0 - (float)i1) + G3, (y0 - (float)j1) + G3, (z0 - (float)k1) + G3);
+			float n2 = cornerf(h2, (x0 - (float)i2) + 2.0f * G3, (y0 - (float)j2) + 2.0f * G3, (z0 - (float)k2) + 2.0f * G3);
+			float n3 = cornerf(h3, (x0 - 1.0f) + 3.0f * G3, (y0 - 1.0f) + 3.0f * G3, (z0 - 1.0f) + 3.0f * G3);
+			out[i] = SCALE * (n0 + n1 + n2 + n3);
+		}
+	}
+
+	// cornerf with its gradient added to dx, dy, dz: the falloff t^4 times the gradient of the
+	// corner plus the slope of the falloff, -8 t^3 (x, y, z), times its dot product
+	static inline float cornerWithGradientf(int hash, float x, float y, float z, float& dx, float& dy, float& dz) {
+		float t = std::max(RADIUS - x * x - y * y - z * z, 0.0f);
+		float t2 = t * t;
+		float t4 = t2 * t2;
+		float dot = gradf(hash, x, y, z);
+		float gx, gy, gz;
+		gradVectorf(hash, gx, gy, gz);
+		float slope = -8.0f * t2 * t * dot;
+		dx += t4 * gx + slope * x;
+		dy += t4 * gy + slope * y;
+		dz += t4 * gz + slope * z;
+		return t4 * dot;
+	}
+
+	static void noiseWithGradientScalar(std::uint32_t seed, const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n) {
+		for (std::size_t i = 0; i < n; ++i) {
+			float x = xs[i], y = ys[i], z = zs[i];
+			float s = (x + y + z) * F3;
+			float fi = std::floor(x + s), fj = std::floor(y + s), fk = std::floor(z + s);
+			float t = (fi + fj + fk) * G3;
+			float x0 = x - (fi - t), y0 = y - (fj - t), z0 = z - (fk - t);
+
+			bool xy = x0 >= y0, xz = x0 >= z0, yz = y0 >= z0;
+			int i1 = xy && xz, j1 = !xy && yz, k1 = !xz && !yz;
+			int i2 = xy || xz, j2 = !xy || yz, k2 = !xz || !yz;
+
+			std::uint32_t hx = (std::uint32_t)(int)fi * PRIME_X, hy = (std::uint32_t)(int)fj * PRIME_Y, hz = (std::uint32_t)(int)fk * PRIME_Z;
+			int h0 = hashCorner(hx, hy, hz, seed);
+			int h1 = hashCorner(hx + i1 * PRIME_X, hy + j1 * PRIME_Y, hz + k1 * PRIME_Z, seed);
+			int h2 = hashCorner(hx + i2 * PRIME_X, hy + j2 * PRIME_Y, hz + k2 * PRIME_Z, seed);
+			int h3 = hashCorner(hx + PRIME_X, hy + PRIME_Y, hz + PRIME_Z, seed);
+
+			// the lattice is fixed within the cell, the offsets to the corners move with the point
+			float dx = 0.0f, dy = 0.0f, dz = 0.0f;
+			float n0 = cornerWithGradientf(h0, x0, y0, z0, dx, dy, dz);
+			float n1 = cornerWithGradientf(h1, (x0 - (float)i1) + G3, (y0 - (float)j1) + G3, (z0 - (float)k1) + G3, dx, dy, dz);
+			float n2 = cornerWithGradientf(h2, (x0 - (float)i2) + 2.0f * G3, (y0 - (float)j2) + 2.0f * G3, (z0 - (float)k2) + 2.0f * G3, dx, dy, dz);
+			float n3 = cornerWithGradientf(h3, (x0 - 1.0f) + 3.0f * G3, (y0 - 1.0f) + 3.0f * G3, (z0 - 1.0f) + 3.0f * G3, dx, dy, dz);
+			out[i] = SCALE * (n0 + n1 + n2 + n3);
+			dxs[i] = SCALE * dx;
+			dys[i] = SCALE * dy;
+			dzs[i] = SCALE * dz;
+		}
+	}
+
+#ifdef MGL_NOISE_X86
+
+	//////////////////////////////////////////////////////////////////////// AVX2
+
+	MGL_TARGET_AVX2 static inline __m256 corner8(__m256i hash, __m256 x, __m256 y, __m256 z) {
+		__m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(RADIUS), _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+		t = _mm256_max_ps(t, _mm256_setzero_ps());
+		t = _mm256_mul_ps(t, t);
+		return _mm256_mul_ps(_mm256_mul_ps(t, t), grad8(hash, x, y, z));
+	}
+
+	MGL_TARGET_AVX2 static inline __m256i hashCorner8(__m256i hx, __m256i hy, __m256i hz, __m256i seed) {
+		__m256i h = _mm256_xor_si256(_mm256_xor_si256(hx, hy), _mm256_xor_si256(hz, seed));
+		h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)MIX));
+		h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+		return _mm256_srli_epi32(h, 28);
+	}
+
+	// the hash of the next lattice plane along an axis where the mask is set
+	MGL_TARGET_AVX2 static inline __m256i nextPlane8(__m256i h, __m256 mask, __m256i prime) {
+		return _mm256_add_epi32(h, _mm256_and_si256(_mm256_castps_si256(mask), prime));
+	}
+
+	// offset is 1.0f where the mask is set, 0.0f elsewhere
+	MGL_TARGET_AVX2 static inline __m256 cornerOffset8(__m256 v, __m256 mask, __m256 offset, __m256 shift) {
+		return _mm256_add_ps(_mm256_sub_ps(v, _mm256_and_ps(mask, offset)), shift);
+	}
+
+	MGL_TARGET_AVX2 static void noiseAVX2(std::uint32_t seed, const float* xs, const float* ys, const float* zs, float* out, std::size_t n) {
+		const __m256i seed8 = _mm256_set1_epi32((int)seed);
+		const __m256i px = _mm256_set1_epi32((int)PRIME_X), py = _mm256_set1_epi32((int)PRIME_Y), pz = _mm256_set1_epi32((int)PRIME_Z);
+		const __m256 fone = _mm256_set1_ps(1.0f);
+		const __m256 all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		const __m256 g1 = _mm256_set1_ps(G3), g2 = _mm256_set1_ps(2.0f * G3), g3 = _mm256_set1_ps(3.0f * G3);
+
+		std::size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256 x = _mm256_loadu_ps(xs + i);
+			__m256 y = _mm256_loadu_ps(ys + i);
+			__m256 z = _mm256_loadu_ps(zs + i);
+			__m256 s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(x, y), z), _mm256_set1_ps(F3));
+			__m256 fi = _mm256_floor_ps(_mm256_add_ps(x, s));
+			__m256 fj = _mm256_floor_ps(_mm256_add_ps(y, s));
+			__m256 fk = _mm256_floor_ps(_mm256_add_ps(z, s));
+			__m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(fi, fj), fk), g1);
+			__m256 x0 = _mm256_sub_ps(x, _mm256_sub_ps(fi, t));
+			__m256 y0 = _mm256_sub_ps(y, _mm256_sub_ps(fj, t));
+			__m256 z0 = _mm256_sub_ps(z, _mm256_sub_ps(fk, t));
+
+			__m256 xy = _mm256_cmp_ps(x0, y0, _CMP_GE_OQ);
+			__m256 xz = _mm256_cmp_ps(x0, z0, _CMP_GE_OQ);
+			__m256 yz = _mm256_cmp_ps(y0, z0, _CMP_GE_OQ);
+			__m256 i1 = _mm256_and_ps(xy, xz), j1 = _mm256_andnot_ps(xy, yz), k1 = _mm256_andnot_ps(_mm256_or_ps(xz, yz), all);
+			__m256 i2 = _mm256_or_ps(xy, xz), j2 = _mm256_or_ps(_mm256_andnot_ps(xy, all), yz), k2 = _mm256_andnot_ps(_mm256_and_ps(xz, yz), all);
+
+			__m256i hx = _mm256_mullo_epi32(_mm256_cvttps_epi32(fi), px);
+			__m256i hy = _mm256_mullo_epi32(_mm256_cvttps_epi32(fj), py);
+			__m256i hz = _mm256_mullo_epi32(_mm256_cvttps_epi32(fk), pz);
+			__m256i H0 = hashCorner8(hx, hy, hz, seed8);
+			__m256i H1 = hashCorner8(nextPlane8(hx, i1, px), nextPlane8(hy, j1, py), nextPlane8(hz, k1, pz), seed8);
+			__m256i H2 = hashCorner8(nextPlane8(hx, i2, px), nextPlane8(hy, j2, py), nextPlane8(hz, k2, pz), seed8);
+			__m256i H3 = hashCorner8(_mm256_add_epi32(hx, px), _mm256_add_epi32(hy, py), _mm256_add_epi32(hz, pz), seed8);
+
+			__m256 n0 = corner8(H0, x0, y0, z0);
+			__m256 n1 = corner8(H1, cornerOffset8(x0, i1, fone, g1), cornerOffset8(y0, j1, fone, g1), cornerOffset8(z0, k1, fone, g1));
+			__m256 n2 = corner8(H2, cornerOffset8(x0, i2, fone, g2), cornerOffset8(y0, j2, fone, g2), cornerOffset8(z0, k2, fone, g2));
+			__m256 n3 = corner8(H3, _mm256_add_ps(_mm256_sub_ps(x0, fone), g3), _mm256_add_ps(_mm256_sub_ps(y0, fone), g3), _mm256_add_ps(_mm256_sub_ps(z0, fone), g3));
+
+			__m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(n0, n1), n2), n3);
+			_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_set1_ps(SCALE), sum));
+		}
+		noiseScalar(seed, xs + i, ys + i, zs + i, out + i, n - i);
+	}
+
+	// cornerWithGradientf of each lane
+	MGL_TARGET_AVX2 static inline __m256 cornerWithGradient8(__m256i hash, __m256 x, __m256 y, __m256 z, __m256& dx, __m256& dy, __m256& dz) {
+		__m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(RADIUS), _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+		t = _mm256_max_ps(t, _mm256_setzero_ps());
+		__m256 t2 = _mm256_mul_ps(t, t);
+		__m256 t4 = _mm256_mul_ps(t2, t2);
+		__m256 dot = grad8(hash, x, y, z);
+		__m256 gx, gy, gz;
+		gradVector8(hash, gx, gy, gz);
+		__m256 slope = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(-8.0f), t2), t), dot);
+		dx = _mm256_add_ps(dx, _mm256_add_ps(_mm256_mul_ps(t4, gx), _mm256_mul_ps(slope, x)));
+		dy = _mm256_add_ps(dy, _mm256_add_ps(_mm256_mul_ps(t4, gy), _mm256_mul_ps(slope, y)));
+		dz = _mm256_add_ps(dz, _mm256_add_ps(_mm256_mul_ps(t4, gz), _mm256_mul_ps(slope, z)));
+		return _mm256_mul_ps(t4, dot);
+	}
+
+	MGL_TARGET_AVX2 static void noiseWithGradientAVX2(std::uint32_t seed, const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n) {
+		const __m256i seed8 = _mm256_set1_epi32((int)seed);
+		const __m256i px = _mm256_set1_epi32((int)PRIME_X), py = _mm256_set1_epi32((int)PRIME_Y), pz = _mm256_set1_epi32((int)PRIME_Z);
+		const __m256 fone = _mm256_set1_ps(1.0f);
+		const __m256 all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		const __m256 g1 = _mm256_set1_ps(G3), g2 = _mm256_set1_ps(2.0f * G3), g3 = _mm256_set1_ps(3.0f * G3);
+		const __m256 scale = _mm256_set1_ps(SCALE);
+
+		std::size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256 x = _mm256_loadu_ps(xs + i);
+			__m256 y = _mm256_loadu_ps(ys + i);
+			__m256 z = _mm256_loadu_ps(zs + i);
+			__m256 s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(x, y), z), _mm256_set1_ps(F3));
+			__m256 fi = _mm256_floor_ps(_mm256_add_ps(x, s));
+			__m256 fj = _mm256_floor_ps(_mm256_add_ps(y, s));
+			__m256 fk = _mm256_floor_ps(_mm256_add_ps(z, s));
+			__m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(fi, fj), fk), g1);
+			__m256 x0 = _mm256_sub_ps(x, _mm256_sub_ps(fi, t));
+			__m256 y0 = _mm256_sub_ps(y, _mm256_sub_ps(fj, t));
+			__m256 z0 = _mm256_sub_ps(z, _mm256_sub_ps(fk, t));
+
+			__m256 xy = _mm256_cmp_ps(x0, y0, _CMP_GE_OQ);
+			__m256 xz = _mm256_cmp_ps(x0, z0, _CMP_GE_OQ);
+			__m256 yz = _mm256_cmp_ps(y0, z0, _CMP_GE_OQ);
+			__m256 i1 = _mm256_and_ps(xy, xz), j1 = _mm256_andnot_ps(xy, yz), k1 = _mm256_andnot_ps(_mm256_or_ps(xz, yz), all);
+			__m256 i2 = _mm256_or_ps(xy, xz), j2 = _mm256_or_ps(_mm256_andnot_ps(xy, all), yz), k2 = _mm256_andnot_ps(_mm256_and_ps(xz, yz), all);
+
+			__m256i hx = _mm256_mullo_epi32(_mm256_cvttps_epi32(fi), px);
+			__m256i hy = _mm256_mullo_epi32(_mm256_cvttps_epi32(fj), py);
+			__m256i hz = _mm256_mullo_epi32(_mm256_cvttps_epi32(fk), pz);
+			__m256i H0 = hashCorner8(hx, hy, hz, seed8);
+			__m256i H1 = hashCorner8(nextPlane8(hx, i1, px), nextPlane8(hy, j1, py), nextPlane8(hz, k1, pz), seed8);
+			__m256i H2 = hashCorner8(nextPlane8(hx, i2, px), nextPlane8(hy, j2, py), nextPlane8(hz, k2, pz), seed8);
+			__m256i H3 = hashCorner8(_mm256_add_epi32(hx, px), _mm256_add_epi32(hy, py), _mm256_add_epi32(hz, pz), seed8);
+
+			__m256 dx = _mm256_setzero_ps(), dy = _mm256_setzero_ps(), dz = _mm256_setzero_ps();
+			__m256 n0 = cornerWithGradient8(H0, x0, y0, z0, dx, dy, dz);
+			__m256 n1 = cornerWithGradient8(H1, cornerOffset8(x0, i1, fone, g1), cornerOffset8(y0, j1, fone, g1), cornerOffset8(z0, k1, fone, g1), dx, dy, dz);
+			__m256 n2 = cornerWithGradient8(H2, cornerOffset8(x0, i2, fone, g2), cornerOffset8(y0, j2, fone, g2), cornerOffset8(z0, k2, fone, g2), dx, dy, dz);
+			__m256 n3 = cornerWithGradient8(H3, _mm256_add_ps(_mm256_sub_ps(x0, fone), g3), _mm256_add_ps(_mm256_sub_ps(y0, fone), g3), _mm256_add_ps(_mm256_sub_ps(z0, fone), g3), dx, dy, dz);
+
+			__m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(n0, n1), n2), n3);
+			_mm256_storeu_ps(out + i, _mm256_mul_ps(scale, sum));
+			_mm256_storeu_ps(dxs + i, _mm256_mul_ps(scale, dx));
+			_mm256_storeu_ps(dys + i, _mm256_mul_ps(scale, dy));
+			_mm256_storeu_ps(dzs + i, _mm256_mul_ps(scale, dz));
+		}
+		noiseWithGradientScalar(seed, xs + i, ys + i, zs + i, out + i, dxs + i, dys + i, dzs + i, n - i);
+	}
+
+#endif // MGL_NOISE_X86
+
+	//////////////////////////////////////////////////////////////////// DISPATCH
+
+	void SimplexNoiseGenerator::noise(const float* xs, const float* ys, const float* zs, float* out, std::size_t n) {
+		// only AVX2 has a kernel, SSE4.1 gets the scalar one
+#ifdef MGL_NOISE_X86
+		if (simdLevel == AVX2) {
+			noiseAVX2(seedHash, xs, ys, zs, out, n);
+			return;
+		}
+#endif
+		noiseScalar(seedHash, xs, ys, zs, out, n);
+	}
+
+	void SimplexNoiseGenerator::noise(const float* xs, const float* ys, const float* zs, float* out, std::size_t n, const Period&) {
+		noise(xs, ys, zs, out, n);
+	}
+
+	void SimplexNoiseGenerator::noiseWithGradient(const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n) {
+#ifdef MGL_NOISE_X86
+		if (simdLevel == AVX2) {
+			noiseWithGradientAVX2(seedHash, xs, ys, zs, out, dxs, dys, dzs, n);
+			return;
+		}
+#endif
+		noiseWithGradientScalar(seedHash, xs, ys, zs, out, dxs, dys, dzs, n);
+	}
+
+	void SimplexNoiseGenerator::noiseWithGradient(const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n, const Period&) {
+		noiseWithGradient(xs, ys, zs, out, dxs, dys, dzs, n);
+	}
+
+}
@@ -0,0 +1,49 @@
+#ifndef MGL_SIMPLEX_NOISE_HPP
+#define MGL_SIMPLEX_NOISE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "noiseGenerator.hpp"
+
+namespace mgl {
+
+	class SimplexNoiseGenerator;
+
+	// 3D simplex noise (Perlin 2001, in the formulation of Gustavson's "Simplex noise
+	// demystified"): the value at a point sums the radial falloff of the 4 corners of
+	// the tetrahedron around it instead of blending the 8 corners of a cube, with the
+	// same 12 edge gradients as PerlinNoiseGenerator. The corners are hashed with
+	// integer arithmetic rather than the permutation table, the chained table lookups
+	// cost the AVX2 kernel more than the rest of the noise together. The skewed
+	// lattice has no period that lines up with a tile, so it does not tile(). Values stay
+	// within [-0.69, 0.69], scaled to the same spread as the Perlin noise.
+	class SimplexNoiseGenerator : public NoiseGenerator {
+	public:
+		// Largest difference between the batched float noise() and the double noise()
+		// evaluated at the same coordinates, for coordinates with magnitude below 4096.
+		// Skewing rounds where the Perlin lattice is exact, hence the larger tolerance.
+		static constexpr float BATCH_TOLERANCE = 2.0e-3f;
+
+		explicit SimplexNoiseGenerator(std::uint32_t seed = 0);
+		~SimplexNoiseGenerator();
+		Backend getBackend() override;
+		std::uint32_t getSeed() override;
+		double noise(double x, double y, double z) override;
+
+		void noise(const float* xs, const float* ys, const float* zs, float* out, std::size_t n) override;
+		// The period is ignored, the result is the non periodic noise
+		void noise(const float* xs, const float* ys, const float* zs, float* out, std::size_t n, const Period& period) override;
+		void noiseWithGradient(const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n) override;
+		void noiseWithGradient(const float* xs, const float* ys, const float* zs, float* out, float* dxs, float* dys, float* dzs, std::size_t n, const Period& period) override;
+		bool tiles() override;
+
+	private:
+		std::uint32_t seed;
+		// the seed spread over all bits, xored into every corner hash
+		std::uint32_t seedHash;
+	};
+
+}
+
+#endif // !MGL_SIMPLEX_NOISE_HPP